@@ -8,6 +8,9 @@
  * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
  * Description : Main server S1. Handles client connections, stores .c files locally,
  *               and dispatches .pdf, .txt, and .zip files to S2, S3, and S4 respectively.
+ *               With .c routed to a backend (S5) it keeps no files and any number of
+ *               S1 instances can run side by side on the same backend pools.
+ *               Any type can also be stored in-process (route <ext> local=<dir>).
  * License     : MIT License
  *
  * (c) 2025 lord_rajkumar. All rights reserved.
@@ -23,9 +26,50 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
 
-#define BUFSIZE 1024
+#include "route.h"
+#include "bstat.h"
+#include "bfilter.h"
+#include "lanes.h"
+#include "tarcache.h"
+#include "acceptor.h"
+#include "metrics.h"
+#include "trace.h"
+#include "transfer.h"
+#include "storage.h"
+#include "fdpass.h"
+#include "crc32c.h"
+
+// routing table, reloaded from the config file on SIGHUP
+struct route_table routes;
+const char *route_conf = ROUTE_CONF;
+volatile sig_atomic_t reload_routes = 0;
+
+// replica writes still running in this worker, waited for before it exits
+pthread_mutex_t repl_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t repl_cond = PTHREAD_COND_INITIALIZER;
+int repl_active = 0;
+
+// one upload shared by the threads writing its replicas
+struct repl_job {
+    char dest[256], filename[256];
+    char *filebuf;
+    int filesize;
+    uint32_t crc;
+    int ok, failed, refs;
+    char trace_id[TRACE_ID_LEN];    // the upload's request, for the writers' spans
+};
+
+struct repl_task {
+    struct repl_job *job;
+    const struct backend *b;
+};
 
 // print error
 void error(const char *msg) {
@@ -33,104 +77,633 @@ void error(const char *msg) {
     exit(1);
 }
 
-// create directory if it does not exist
-void ensure_directory(const char *path) {
-    char cmd[512];
-    snprintf(cmd, sizeof(cmd), "mkdir -p %s", path);
-    system(cmd);
+// build the routing key for a path: "~S1" stripped, repeated slashes collapsed
+void route_key(char *key, size_t size, const char *dir, const char *name) {
+    char joined[600];
+    const char *p = strstr(dir, "~S1") ? strstr(dir, "~S1") + 3 : dir;
+    snprintf(joined, sizeof(joined), name ? "%s/%s" : "%s", p, name);
+    size_t k = 0;
+    for(const char *c = joined; *c && k + 1 < size; c++) {
+        if(*c == '/' && k > 0 && key[k-1] == '/')
+            continue;
+        key[k++] = *c;
+    }
+    key[k] = '\0';
 }
 
-// send all bytes
-ssize_t send_all(int sockfd, const void *buf, size_t len) {
-    size_t total = 0;
-    const char *p = buf;
-    while(total < len) {
-        ssize_t n = send(sockfd, p + total, len - total, 0);
-        if(n <= 0) return n;
-        total += n;
-    }
-    return total;
+// the filter hash of a file stored as dest/filename
+uint64_t stored_hash(const char *dest, const char *filename) {
+    char path[600], key[600];
+    snprintf(path, sizeof(path), "%s/%s", dest, filename);
+    bloom_key(path, key, sizeof(key));
+    return bloom_hash(key);
 }
 
-// receive all bytes
-ssize_t recv_all(int sockfd, void *buf, size_t len) {
-    size_t total = 0;
-    char *p = buf;
-    while(total < len) {
-        ssize_t n = recv(sockfd, p + total, len - total, 0);
-        if(n <= 0) return n;
-        total += n;
+void *replica_writer(void *arg) {
+    struct repl_task *t = arg;
+    struct repl_job *job = t->job;
+    trace_set_id(job->trace_id);
+    int rc = forward_file(t->b, job->dest, job->filename, job->filebuf, job->filesize, job->crc);
+    // before the quorum is counted, so the client's next download finds it
+    if(rc == 0)
+        bfilter_note(t->b, stored_hash(job->dest, job->filename));
+    pthread_mutex_lock(&repl_lock);
+    if(rc == 0) job->ok++; else job->failed++;
+    int last = --job->refs == 0;
+    repl_active--;
+    pthread_cond_broadcast(&repl_cond);
+    pthread_mutex_unlock(&repl_lock);
+    if(last) {
+        free(job->filebuf);
+        free(job);
     }
-    return total;
+    free(t);
+    return NULL;
 }
 
-// forward file to remote server if not .c file
-int forward_file(int server_port, const char *dest, const char *filename, char *filebuf, int filesize) {
-    int sockfd;
-    struct sockaddr_in serv_addr;
-    char buf[BUFSIZE];
-    
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if(sockfd < 0) {
-        perror("ERROR opening socket to forward");
-        return -1;
+// store a file on its R replicas in parallel and return 0 as soon as W of
+// them acked; the other copies finish in the background. takes filebuf
+int forward_replicated(const struct pool *pool, const char *dest, const char *filename, char *filebuf, int filesize,
+                       uint32_t crc) {
+    const struct backend *cand[ROUTE_MAX_MEMBERS];
+    char key[600];
+    route_key(key, sizeof(key), dest, filename);
+    int nc = route_walk(&routes, pool, key, cand, pool->replicas);
+    if(nc == 1 || pool->replicas == 1) {
+        int rc = forward_file(cand[0], dest, filename, filebuf, filesize, crc);
+        if(rc == 0)
+            bfilter_note(cand[0], stored_hash(dest, filename));
+        free(filebuf);
+        return rc;
     }
-    memset(&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(server_port);
-    serv_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-    
-    if(connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
-        perror("ERROR connecting to forward server");
-        close(sockfd);
+    struct repl_job *job = calloc(1, sizeof(*job));
+    if(!job) {
+        free(filebuf);
         return -1;
     }
-    // build command: "storef <destination> <filename>"
-    snprintf(buf, sizeof(buf), "storef %s %s", dest, filename);
-    if(send(sockfd, buf, strlen(buf), 0) < 0) {
-        perror("Error sending store command");
-        close(sockfd);
-        return -1;
+    snprintf(job->dest, sizeof(job->dest), "%s", dest);
+    snprintf(job->filename, sizeof(job->filename), "%s", filename);
+    job->filebuf = filebuf;
+    job->filesize = filesize;
+    job->crc = crc;
+    job->refs = 1;  // ours
+    snprintf(job->trace_id, sizeof(job->trace_id), "%s", trace_id());
+    long t = trace_now();
+    pthread_mutex_lock(&repl_lock);
+    for(int i = 0; i < nc; i++) {
+        struct repl_task *t = malloc(sizeof(*t));
+        pthread_t tid;
+        if(t) {
+            t->job = job;
+            t->b = cand[i];
+        }
+        if(t && pthread_create(&tid, NULL, replica_writer, t) == 0) {
+            pthread_detach(tid);
+            job->refs++;
+            repl_active++;
+        } else {
+            free(t);
+            job->failed++;
+        }
     }
-    // Wait for respond with "READY"
-    memset(buf, 0, sizeof(buf));
-    if(recv(sockfd, buf, sizeof(buf)-1, 0) <= 0) {
-        perror("No READY response from forwarding server");
-        close(sockfd);
-        return -1;
+    while(job->ok < pool->quorum && job->failed <= nc - pool->quorum)
+        pthread_cond_wait(&repl_cond, &repl_lock);
+    trace_span("quorum", t, NULL);
+    int rc = job->ok >= pool->quorum ? 0 : -1;
+    int last = --job->refs == 0;
+    pthread_mutex_unlock(&repl_lock);
+    if(last) {
+        free(job->filebuf);
+        free(job);
     }
-    if(strncmp(buf, "READY", 5) != 0) {
-        fprintf(stderr, "Forwarding server not ready\n");
-        close(sockfd);
+    return rc;
+}
+
+void replica_wait_all(void) {
+    pthread_mutex_lock(&repl_lock);
+    while(repl_active > 0)
+        pthread_cond_wait(&repl_cond, &repl_lock);
+    pthread_mutex_unlock(&repl_lock);
+}
+
+// connect to a backend and send one command
+int start_remote(const struct backend *b, const char *cmdline) {
+    int sock = bstat_connect(b);
+    if(sock < 0)
         return -1;
-    }
-    // Send file size (4 bytes)
-    uint32_t net_filesize = htonl(filesize);
-    if(send(sockfd, &net_filesize, sizeof(net_filesize), 0) < (ssize_t)sizeof(net_filesize)) {
-        perror("Error sending filesize to forwarding server");
-        close(sockfd);
+    if(send_all(sock, cmdline, strlen(cmdline)) != (ssize_t)strlen(cmdline)) {
+        bstat_close(sock);
         return -1;
     }
-    // Send file data
-    int sent = 0;
-    while(sent < filesize) {
-        int n = send(sockfd, filebuf + sent, filesize - sent, 0);
-        if(n <= 0)
+    return sock;
+}
+
+// the members that may hold a path, in the order a download asks them: the
+// replicas first, cheapest first by latency and load, then the ring
+// successors that held keys before a rebalance, leaving out those whose
+// filter rules it out. how many; 0 is a definite miss, no backend asked
+int remote_candidates(const struct pool *pool, const char *filepath, const struct backend **cand) {
+    char key[600];
+    route_key(key, sizeof(key), filepath, NULL);
+    int nc = route_walk(&routes, pool, key, cand, pool->replicas + ROUTE_FALLBACK - 1);
+    bloom_key(filepath, key, sizeof(key));
+    uint64_t hash = bloom_hash(key);
+    int keep = 0, nrep = 0;
+    for(int i = 0; i < nc; i++) {
+        if(!bfilter_may_have(cand[i], hash))
+            continue;
+        if(i < pool->replicas)
+            nrep++;
+        cand[keep++] = cand[i];
+    }
+    if(nc > 0 && keep == 0) {
+        trace_span("filter_miss", trace_now(), NULL);
+        bfilter_answered();
+    }
+    for(int i = 1; i < nrep; i++) {
+        for(int j = i; j > 0 && bstat_cost(cand[j]) < bstat_cost(cand[j-1]); j--) {
+            const struct backend *tmp = cand[j];
+            cand[j] = cand[j-1];
+            cand[j-1] = tmp;
+        }
+    }
+    return keep;
+}
+
+// open a download on the nc candidates in turn. if a request is slower than
+// the pool's hedge delay the next candidate is asked too and the first good
+// answer wins. returns the socket with the size header read, or -1. backends
+// on a Unix socket are asked to pass the open file instead, which comes back
+// in *file_fd
+int open_remote(const struct pool *pool, const struct backend **cand, int nc, const char *cmdline,
+                uint32_t *net_size, int *file_fd) {
+    char fdline[BUFSIZE + TRACE_ID_LEN + LANE_TAG_LEN + 8];
+    snprintf(fdline, sizeof(fdline), "%s -f", cmdline);
+    *file_fd = -1;
+    struct pollfd pfd[2];
+    const struct backend *pb[2];
+    long pt[2];
+    int npend = 0, next = 0;
+    while(1) {
+        // launch the next candidate when nothing is outstanding or the hedge fired
+        int hedge_fired = 0;
+        if(npend == 1 && next < nc && pool->hedge_ms > 0) {
+            int r = poll(pfd, 1, pool->hedge_ms);
+            if(r < 0 && errno == EINTR) continue;
+            hedge_fired = r == 0;
+        }
+        while((npend == 0 || hedge_fired) && next < nc) {
+            pt[npend] = trace_now();
+            pb[npend] = cand[next];
+            pfd[npend].fd = start_remote(cand[next], cand[next]->uaddr.sun_path[0] ? fdline : cmdline);
+            next++;
+            pfd[npend].events = POLLIN;
+            if(pfd[npend].fd >= 0) {
+                npend++;
+                hedge_fired = 0;
+            }
+        }
+        if(npend == 0)
+            return -1;
+        if(poll(pfd, npend, -1) < 0) {
+            if(errno == EINTR) continue;
             break;
-        sent += n;
+        }
+        for(int i = npend - 1; i >= 0; i--) {
+            if(!pfd[i].revents)
+                continue;
+            // a miss is answered with "ERROR" instead of a size header
+            int ok = fdpass_recv(pfd[i].fd, net_size, sizeof(*net_size), file_fd) == sizeof(*net_size) &&
+                     memcmp(net_size, "ERRO", 4) != 0;
+            bstat_latency(pb[i], trace_now() - pt[i]);
+            trace_span(ok ? "first_byte" : "miss", pt[i], pb[i]->name);
+            if(ok) {
+                for(int j = 0; j < npend; j++)
+                    if(j != i) bstat_close(pfd[j].fd);
+                return pfd[i].fd;
+            }
+            if(*file_fd >= 0) close(*file_fd);
+            *file_fd = -1;
+            bstat_close(pfd[i].fd);
+            pfd[i] = pfd[npend-1];
+            pb[i] = pb[npend-1];
+            pt[i] = pt[npend-1];
+            npend--;
+        }
     }
-    // Oread acknowledgment
-    memset(buf, 0, sizeof(buf));
-    recv(sockfd, buf, sizeof(buf)-1, 0);
-    close(sockfd);
+    for(int j = 0; j < npend; j++)
+        bstat_close(pfd[j].fd);
+    return -1;
+}
+
+// size of a tar member from its header, octal or GNU base-256
+long long tar_member_size(const unsigned char *hdr) {
+    long long size = 0;
+    if(hdr[124] & 0x80) {
+        for(int i = 125; i < 136; i++)
+            size = (size << 8) | hdr[i];
+        return size;
+    }
+    for(int i = 124; i < 136 && hdr[i]; i++)
+        if(hdr[i] >= '0' && hdr[i] <= '7')
+            size = size * 8 + (hdr[i] - '0');
+    return size;
+}
+
+// set of tar entry names, used to drop the copies of replicated files
+struct nameset {
+    char **slots;
+    size_t cap, used;
+};
+
+// where name is in the set, or the empty slot it would go in
+size_t nameset_slot(const struct nameset *set, const char *name) {
+    uint32_t h = 2166136261u;
+    for(const char *c = name; *c; c++)
+        h = (h ^ (unsigned char)*c) * 16777619u;
+    size_t i = h & (set->cap - 1);
+    while(set->slots[i] && strcmp(set->slots[i], name) != 0)
+        i = (i + 1) & (set->cap - 1);
+    return i;
+}
+
+// returns 1 if the name was already in the set
+int nameset_add(struct nameset *set, const char *name) {
+    if(set->used * 2 >= set->cap) {
+        struct nameset bigger = {calloc(set->cap ? set->cap * 2 : 256, sizeof(char *)), set->cap ? set->cap * 2 : 256, 0};
+        if(!bigger.slots) return 0;
+        for(size_t i = 0; i < set->cap; i++)
+            if(set->slots[i]) nameset_add(&bigger, set->slots[i]);
+        for(size_t i = 0; i < set->cap; i++)
+            free(set->slots[i]);
+        free(set->slots);
+        *set = bigger;
+    }
+    size_t i = nameset_slot(set, name);
+    if(set->slots[i]) return 1;
+    set->slots[i] = strdup(name);
+    set->used++;
     return 0;
 }
 
+int nameset_has(const struct nameset *set, const char *name) {
+    return set->cap && set->slots[nameset_slot(set, name)];
+}
+
+void nameset_free(struct nameset *set) {
+    for(size_t i = 0; i < set->cap; i++)
+        free(set->slots[i]);
+    free(set->slots);
+}
+
+// name of a tar entry without the store directory ("./S2/"), so the same
+// file from two replicas compares equal
+void tar_entry_key(const unsigned char *hdr, const char *longname, char *key, size_t size) {
+    char full[1024];
+    if(longname)
+        snprintf(full, sizeof(full), "%s", longname);
+    else if(memcmp(hdr + 257, "ustar", 5) == 0 && hdr[345])
+        snprintf(full, sizeof(full), "%.155s/%.100s", (const char *)hdr + 345, (const char *)hdr);
+    else
+        snprintf(full, sizeof(full), "%.100s", (const char *)hdr);
+    const char *p = strncmp(full, "./", 2) == 0 ? full + 2 : full;
+    const char *slash = strchr(p, '/');
+    snprintf(key, size, "%s", slash ? slash + 1 : p);
+}
+
+// what a member's manifest says: its token, and with a delta its removals
+// added to removed. 1 for a delta, 0 for a full archive, -1 when unreadable
+int read_manifest(char *text, struct timespec *token, struct nameset *removed) {
+    int delta = -1, got = 0;
+    for(char *line = strtok(text, "\n"); line; line = strtok(NULL, "\n")) {
+        if(strncmp(line, "token ", 6) == 0)
+            got = tarcache_since(line + 6, token) == 0;
+        else if(strcmp(line, "full") == 0)
+            delta = 0;
+        else if(strncmp(line, "delta ", 6) == 0)
+            delta = 1;
+        else if(strncmp(line, "removed ", 8) == 0)
+            nameset_add(removed, line + 8);
+    }
+    return got ? delta : -1;
+}
+
+// fetch the archive of every pool member and concatenate them into one tar:
+// each archive is copied up to its end-of-archive marker, then one marker is
+// written after the last. with replication only the first copy of each file
+// is kept. the members' manifests are put together into one: the earliest
+// token, so no member's changes are missed, or with a member missing the
+// since asked for (0 for a full archive) so the next delta asks again.
+// returns 0 when at least one member answered and every archive matched its
+// checksum, 1 when a delta was asked for and a member could only answer in full
+int merge_remote_tars(const struct pool *pool, const char *cmdline, const char *outname,
+                      const struct timespec *since) {
+    FILE *out = fopen(outname, "wb");
+    if(!out) return -1;
+    int answered = 0, intact = 1, manifests = 0, full = 0;
+    struct timespec token = {0, 0};
+    struct nameset removed = {NULL, 0, 0};
+    unsigned char block[512];
+    struct nameset seen = {NULL, 0, 0};
+    // extended headers ('L' long name, 'K' long link, 'x' pax) are held back
+    // and written or dropped together with the entry they describe
+    unsigned char *hold = NULL;
+    size_t hold_len = 0, hold_cap = 0;
+    for(int m = 0; m < pool->nmembers; m++) {
+        long t = trace_now();
+        int sock = bstat_connect(&routes.backends[pool->members[m]]);
+        if(sock < 0)
+            continue;
+        uint32_t net_size;
+        if(send_all(sock, cmdline, strlen(cmdline)) != (ssize_t)strlen(cmdline) ||
+           recv_all(sock, &net_size, sizeof(net_size)) != sizeof(net_size) ||
+           memcmp(&net_size, "ERRO", 4) == 0) {
+            bstat_close(sock);
+            continue;
+        }
+        answered++;
+        FILE *in = fdopen(dup(sock), "rb");
+        if(!in) {
+            bstat_close(sock);
+            continue;
+        }
+        long long left = ntohl(net_size) / 512, data = 0, mlen = 0;
+        int done = 0, skip = 0, holding = 0, header = 0, grab = 0;
+        uint32_t crc = 0, net_crc;
+        char *mtext = NULL;
+        size_t mcap = 0;
+        FILE *mf = open_memstream(&mtext, &mcap);
+        hold_len = 0;
+        while(left-- > 0 && fread(block, 1, 512, in) == 512) {
+            crc = crc32c(crc, block, 512);
+            if(done)
+                continue;   // drain the padding after the marker
+            if(data == 0) {
+                int zero = 1;
+                for(int i = 0; i < 512 && zero; i++)
+                    zero = block[i] == 0;
+                if(zero) {
+                    done = 1;
+                    continue;
+                }
+                data = (tar_member_size(block) + 511) / 512 + 1;
+                char type = block[156];
+                holding = type == 'L' || type == 'K' || type == 'x';
+                header = 1;
+                if(!holding) {
+                    // a real entry: decide once for it and its held headers
+                    skip = 0;
+                    // the member's manifest is kept back for the merged one
+                    grab = strncmp((const char *)block, TARCACHE_MANIFEST, 100) == 0;
+                    if(grab) {
+                        mlen = tar_member_size(block);
+                        skip = 1;
+                    }
+                    else if(pool->replicas > 1 && (type == '0' || type == '\0')) {
+                        char key[1024], longname[1024];
+                        const char *ln = NULL;
+                        if(hold_len > 512 && hold[156] == 'L') {
+                            snprintf(longname, sizeof(longname), "%.*s", (int)(hold_len - 512), (const char *)hold + 512);
+                            ln = longname;
+                        }
+                        tar_entry_key(block, ln, key, sizeof(key));
+                        skip = nameset_add(&seen, key);
+                    }
+                    if(!skip && hold_len)
+                        fwrite(hold, 1, hold_len, out);
+                    hold_len = 0;
+                }
+            }
+            data--;
+            if(grab && !header && mf && mlen > 0) {
+                fwrite(block, 1, mlen < 512 ? mlen : 512, mf);
+                mlen -= 512;
+            }
+            header = 0;
+            if(holding) {
+                if(hold_len + 512 > hold_cap) {
+                    unsigned char *bigger = realloc(hold, hold_cap ? hold_cap * 2 : 4096);
+                    if(!bigger) break;
+                    hold = bigger;
+                    hold_cap = hold_cap ? hold_cap * 2 : 4096;
+                }
+                memcpy(hold + hold_len, block, 512);
+                hold_len += 512;
+            } else if(!skip) {
+                fwrite(block, 1, 512, out);
+            }
+        }
+        // whatever is left of an archive that is not whole blocks, then its checksum
+        size_t tail = ntohl(net_size) % 512;
+        if(left >= 0 || fread(block, 1, tail, in) != tail)
+            intact = 0;
+        crc = crc32c(crc, block, tail);
+        if(ntohl(net_size) > 0 && (fread(&net_crc, 1, sizeof(net_crc), in) != sizeof(net_crc) || ntohl(net_crc) != crc))
+            intact = 0;
+        fclose(in);
+        bstat_close(sock);
+        if(mf && fclose(mf) == 0) {
+            struct timespec mt;
+            int delta = read_manifest(mtext, &mt, &removed);
+            if(delta >= 0 && (manifests++ == 0 || mt.tv_sec < token.tv_sec ||
+                              (mt.tv_sec == token.tv_sec && mt.tv_nsec < token.tv_nsec)))
+                token = mt;
+            full |= since && delta == 0;
+        }
+        free(mtext);
+        trace_span("fetch_tar", t, routes.backends[pool->members[m]].name);
+    }
+    free(hold);
+    nameset_free(&seen);
+    if(manifests < pool->nmembers || !intact) {
+        token.tv_sec = since ? since->tv_sec : 0;
+        token.tv_nsec = since ? since->tv_nsec : 0;
+    }
+    char *text = NULL;
+    size_t tlen = 0;
+    FILE *mf = open_memstream(&text, &tlen);
+    if(mf) {
+        fprintf(mf, "token %lld.%09ld\n", (long long)token.tv_sec, token.tv_nsec);
+        if(since) {
+            fprintf(mf, "delta %lld.%09ld\n", (long long)since->tv_sec, since->tv_nsec);
+            for(size_t i = 0; i < removed.cap; i++)
+                if(removed.slots[i])
+                    fprintf(mf, "removed %s\n", removed.slots[i]);
+        } else {
+            fprintf(mf, "full\n");
+        }
+    }
+    if(mf && fclose(mf) == 0) {
+        tarcache_manifest_header((char *)block, tlen);
+        fwrite(block, 1, 512, out);
+        fwrite(text, 1, tlen, out);
+        memset(block, 0, sizeof(block));
+        fwrite(block, 1, (512 - tlen % 512) % 512, out);
+    }
+    free(text);
+    nameset_free(&removed);
+    memset(block, 0, sizeof(block));
+    fwrite(block, 1, 512, out);
+    fwrite(block, 1, 512, out);
+    fclose(out);
+    if(full)
+        return 1;
+    return answered && intact ? 0 : -1;
+}
+
+// send a removem list the way forward_file sends a file: wait for READY,
+// then <size><list><crc>
+int send_list(int sock, const struct pathlist *list) {
+    char ready[5];
+    if(recv(sock, ready, sizeof(ready), MSG_WAITALL) != sizeof(ready) || memcmp(ready, "READY", 5) != 0)
+        return -1;
+    size_t size = 0, off = 0;
+    for(size_t i = 0; i < list->n; i++)
+        size += strlen(list->v[i]) + 1;
+    char *text = malloc(size ? size : 1);
+    if(!text) return -1;
+    for(size_t i = 0; i < list->n; i++)
+        off += sprintf(text + off, "%s\n", list->v[i]);
+    uint32_t net_size = htonl(size), net_crc = htonl(crc32c(0, text, size));
+    int ok = send_all(sock, &net_size, sizeof(net_size)) == sizeof(net_size) &&
+             send_all(sock, text, size) == (ssize_t)size &&
+             (size == 0 || send_all(sock, &net_crc, sizeof(net_crc)) == sizeof(net_crc));
+    free(text);
+    return ok ? 0 : -1;
+}
+
+// removem on every backend with ask[i] set: lists[i] is its share of a list,
+// or with lists NULL cmdline carries the pattern. the backends remove at the
+// same time and the paths they report go into removed, or into failed for
+// the ones marked '!'. returns how many could not be asked
+int remove_remote(const char *cmdline, const int *ask, const struct pathlist *lists,
+                   struct nameset *removed, struct nameset *failed) {
+    struct pollfd pfd[ROUTE_MAX_BACKENDS];
+    int who[ROUTE_MAX_BACKENDS], npend = 0, missed = 0;
+    long started[ROUTE_MAX_BACKENDS];
+    for(int i = 0; i < routes.nbackends; i++) {
+        if(!ask[i])
+            continue;
+        started[i] = trace_now();
+        int sock = start_remote(&routes.backends[i], cmdline);
+        if(sock < 0) {
+            missed++;
+            continue;
+        }
+        if(lists && send_list(sock, &lists[i]) < 0) {
+            bstat_close(sock);
+            missed++;
+            continue;
+        }
+        pfd[npend].fd = sock;
+        pfd[npend].events = POLLIN;
+        who[npend++] = i;
+    }
+    // a partial line from each backend, finished by its next read
+    struct { char text[1100]; size_t len; } *part = calloc(npend ? npend : 1, sizeof(*part));
+    int open_socks = npend;
+    while(part && open_socks > 0) {
+        if(poll(pfd, npend, -1) < 0) {
+            if(errno == EINTR) continue;
+            break;
+        }
+        for(int j = 0; j < npend; j++) {
+            if(pfd[j].fd < 0 || !pfd[j].revents)
+                continue;
+            char buf[BUFSIZE];
+            int r = recv(pfd[j].fd, buf, sizeof(buf), 0);
+            for(int k = 0; k < r; k++) {
+                if(buf[k] != '\n') {
+                    if(part[j].len < sizeof(part[j].text) - 1)
+                        part[j].text[part[j].len++] = buf[k];
+                    continue;
+                }
+                part[j].text[part[j].len] = '\0';
+                if(part[j].text[0] == '!')
+                    nameset_add(failed, part[j].text + 1);
+                else if(strncmp(part[j].text, "~S1/", 4) == 0)
+                    nameset_add(removed, part[j].text);
+                part[j].len = 0;
+            }
+            if(r <= 0) {
+                bstat_close(pfd[j].fd);
+                pfd[j].fd = -1;
+                open_socks--;
+                trace_span("remove", started[who[j]], routes.backends[who[j]].name);
+            }
+        }
+    }
+    for(int j = 0; j < npend; j++)
+        if(pfd[j].fd >= 0) bstat_close(pfd[j].fd);
+    free(part);
+    return missed;
+}
+
+// the same for an in-process store
+void remove_local(const char *dir, const struct pathlist *list, struct nameset *removed, struct nameset *failed) {
+    signed char *status = malloc(list->n ? list->n : 1);
+    if(!status) return;
+    long t = trace_now();
+    store_remove_batch(dir, list->v, list->n, status);
+    for(size_t i = 0; i < list->n; i++) {
+        if(status[i] == 0) {
+            nameset_add(removed, list->v[i]);
+            tarcache_removed(dir, list->v[i]);
+        }
+        else if(status[i] < 0)
+            nameset_add(failed, list->v[i]);
+    }
+    trace_span("remove_local", t, dir);
+    free(status);
+}
+
+// one list in a merged listing: a backend's reply or an in-process store
+struct list_src {
+    FILE *in;                       // from the backend on sock
+    int sock;
+    const struct backend *b;
+    long t;
+    struct store_iter *it;          // or the store
+    char line[2200];                // its next entry, as sent on
+    char path[1100];                // and that entry's path
+    int live;                       // line holds an entry
+    int more;                       // the backend stopped at the count
+    int broken;                     // it ended without its "--"
+};
+
+void list_advance(struct list_src *s, const struct store_listing *l) {
+    s->live = 0;
+    if(s->it) {
+        const struct store_file *f = store_iter_next(s->it);
+        if(f) {
+            store_listing_line(l, f, s->line, sizeof(s->line));
+            s->live = 1;
+        }
+    } else if(s->in) {
+        if(!fgets(s->line, sizeof(s->line), s->in))
+            s->broken = 1;
+        else if(strncmp(s->line, "~S1/", 4) == 0)
+            s->live = 1;
+        else if(strncmp(s->line, "--", 2) == 0)
+            s->more = strncmp(s->line, "-- more", 7) == 0;
+        else
+            s->broken = 1;     // an error instead of a listing
+    }
+    if(s->live)
+        snprintf(s->path, sizeof(s->path), "%.*s", (int)strcspn(s->line, "\t\n"), s->line);
+}
+
 // main handler for client 
 void prcclient(int client_sock) {
     char buffer[BUFSIZE];
     int n;
+    // per-client fairness goes by the peer, whatever connection it uses
+    uint64_t client = lane_client(client_sock);
+    lane_forward(client);
     while (1) {
+        metrics_end();      // the previous command has been answered
+        trace_end();
+        lane_leave();
         memset(buffer, 0, BUFSIZE);
         n = recv(client_sock, buffer, BUFSIZE-1, 0);
         if(n <= 0) break;
@@ -139,6 +712,16 @@ void prcclient(int client_sock) {
         // fstore command
         char cmd[32];
         sscanf(buffer, "%s", cmd);
+        metrics_begin(cmd);
+        trace_begin(cmd, NULL);
+        // the command as sent on to the backends, tagged with the client's
+        // account and the request ID
+        char fwd[BUFSIZE + TRACE_ID_LEN + LANE_TAG_LEN + 2];
+        trace_tag(fwd, sizeof(fwd), buffer);
+        lane_tag(fwd, sizeof(fwd));
+        // transfers wait for their lane once their size is known, the rest now
+        if(lane_of(cmd, 0) != LANE_SMALL)
+            lane_enter(lane_of(cmd, 0), client, 0);
         
         if(strcasecmp(cmd, "uploadf") == 0) {
             // expected: uploadf <filename> <destination_path>
@@ -155,6 +738,7 @@ void prcclient(int client_sock) {
             }
             // send "READY" to client
             send(client_sock, "READY", 5, 0);
+            long t = trace_now();
             // Receive filesize header.
             uint32_t net_filesize;
             n = recv(client_sock, &net_filesize, sizeof(net_filesize), 0);
@@ -163,60 +747,64 @@ void prcclient(int client_sock) {
                 continue;
             }
             int filesize = ntohl(net_filesize);
+            lane_enter(lane_of(cmd, filesize), client, filesize);
+            const struct pool *pool = route_lookup(&routes, ext);
+            // types stored in-process go straight from the client to disk
+            if(pool && pool->local) {
+                char filepath[600];
+                store_path(pool->dir, dest, filepath, sizeof(filepath));
+                snprintf(filepath + strlen(filepath), sizeof(filepath) - strlen(filepath), "/%s", filename);
+                // a file stored again is not appended to the cached archive
+                int replaced = access(filepath, F_OK) == 0;
+                int rc = store_recv(pool->dir, dest, filename, client_sock, filesize, 0, filepath, sizeof(filepath));
+                trace_span("store", t, filepath);
+                metrics_bytes(filesize, 0);
+                if(rc == 0)
+                    tarcache_add(pool->dir, filepath, NULL, 0, replaced);
+                if(rc == 0)
+                    send(client_sock, "File uploaded successfully\n", 29, 0);
+                else if(rc == 2)
+                    send(client_sock, "Checksum mismatch\n", 18, 0);
+                else
+                    send(client_sock, "Error writing file\n", 19, 0);
+                continue;
+            }
             char *filebuf = malloc(filesize);
             if(!filebuf) {
                 send(client_sock, "Memory allocation error\n", 24, 0);
                 continue;
             }
             int received = 0;
+            uint32_t crc = 0, net_crc = 0;
             while(received < filesize) {
                 n = recv(client_sock, filebuf+received, filesize-received, 0);
                 if(n <= 0) break;
+                crc = crc32c(crc, filebuf + received, n);
                 received += n;
             }
-            // if file is .c file, store it locally.
-            if(strcasecmp(ext, ".c") == 0) {
-                char base[256] = "./S1";
-                char fullpath[512];
-                // remove "~S1" if present.
-                char *subpath = strstr(dest, "~S1");
-                if(subpath)
-                    subpath += 3;
-                else
-                    subpath = dest;
-                snprintf(fullpath, sizeof(fullpath), "%s%s", base, subpath);
-                ensure_directory(fullpath);
-                char filepath[600];
-                snprintf(filepath, sizeof(filepath), "%s/%s", fullpath, filename);
-                FILE *fp = fopen(filepath, "wb");
-                if(fp) {
-                    fwrite(filebuf, 1, filesize, fp);
-                    fclose(fp);
-                    send(client_sock, "File uploaded successfully\n", 29, 0);
-                } else {
-                    send(client_sock, "Error writing file\n", 19, 0);
-                }
+            // then the client's checksum of it
+            int whole = received == filesize &&
+                        (filesize == 0 || recv_all(client_sock, &net_crc, sizeof(net_crc)) == sizeof(net_crc));
+            trace_span("recv_client", t, NULL);
+            metrics_bytes(received, 0);
+            // everything else is forwarded to its backends.
+            if(!pool) {
+                send(client_sock, "Unsupported file type\n", 23, 0);
+                free(filebuf);
+                continue;
             }
-            else {
-                // non-.c files are forwarded to respective servers.
-                int target_port = 0;
-                if(strcasecmp(ext, ".pdf") == 0)
-                    target_port = 9002;
-                else if(strcasecmp(ext, ".txt") == 0)
-                    target_port = 9003;
-                else if(strcasecmp(ext, ".zip") == 0)
-                    target_port = 9004;
-                else {
-                    send(client_sock, "Unsupported file type\n", 23, 0);
-                    free(filebuf);
-                    continue;
-                }
-                if(forward_file(target_port, dest, filename, filebuf, filesize) == 0)
-                    send(client_sock, "File forwarded successfully\n", 30, 0);
-                else
-                    send(client_sock, "Error forwarding file\n", 23, 0);
+            // a short or damaged upload is never passed on
+            if(!whole || (filesize > 0 && ntohl(net_crc) != crc)) {
+                if(whole)
+                    send(client_sock, "Checksum mismatch\n", 18, 0);
+                free(filebuf);
+                continue;
             }
-            free(filebuf);
+            int rc = forward_replicated(pool, dest, filename, filebuf, filesize, crc);
+            if(rc == 0)
+                send(client_sock, "File forwarded successfully\n", 30, 0);
+            else
+                send(client_sock, "Error forwarding file\n", 23, 0);
         }
         else if(strcasecmp(cmd, "downlf") == 0) {
             // expected: downlf <filepath>
@@ -230,78 +818,93 @@ void prcclient(int client_sock) {
                 send(client_sock, "Invalid file extension\n", 23, 0);
                 continue;
             }
-            if(strcasecmp(ext, ".c") == 0) {
-                // local download from ./S1.
+            const struct pool *pool = route_lookup(&routes, ext);
+            if(pool && pool->local) {
+                // served by the in-process store
+                long t = trace_now();
                 char localpath[600];
-                snprintf(localpath, sizeof(localpath), "./S1%s", (strstr(filepath, "~S1") ? filepath+3 : filepath));
-                FILE *fp = fopen(localpath, "rb");
+                struct stat st;
+                int fd = store_open(pool->dir, filepath, &st, localpath, sizeof(localpath));
+                uint32_t crc;
+                FILE *fp = fd >= 0 && store_crc(fd, st.st_size, &crc) == 0 ? fdopen(fd, "rb") : NULL;
                 if(!fp) {
-                    send(client_sock, "ERROR", 5, 0);
+                    // zero size, same as a miss on the remote servers
+                    if(fd >= 0) close(fd);
+                    uint32_t none = 0;
+                    send(client_sock, &none, sizeof(none), 0);
                     continue;
                 }
-                fseek(fp, 0, SEEK_END);
-                int filesize = ftell(fp);
-                rewind(fp);
-                uint32_t net_filesize = htonl(filesize);
+                int filesize = st.st_size;
+                lane_enter(lane_of(cmd, filesize), client, filesize);
+                uint32_t net_filesize = htonl(filesize), net_crc = htonl(crc);
                 send(client_sock, &net_filesize, sizeof(net_filesize), 0);
-                char filebuf[BUFSIZE];
-                int bytes;
-                while((bytes = fread(filebuf, 1, BUFSIZE, fp)) > 0)
-                    send(client_sock, filebuf, bytes, 0);
+                send_file(fp, client_sock, NULL);
                 fclose(fp);
+                // the checksum kept since the upload, so damage on disk shows too
+                if(filesize > 0)
+                    send_all(client_sock, &net_crc, sizeof(net_crc));
+                trace_span("read_send", t, localpath);
+                metrics_bytes(0, filesize);
             }
             else {
                 // forward download request to respective servers.
-                int target_port = 0;
-                if(strcasecmp(ext, ".pdf") == 0)
-                    target_port = 9002;
-                else if(strcasecmp(ext, ".txt") == 0)
-                    target_port = 9003;
-                else if(strcasecmp(ext, ".zip") == 0)
-                    target_port = 9004;
-                else {
+                if(!pool) {
                     send(client_sock, "Unsupported file type\n", 23, 0);
                     continue;
                 }
-                int sock_remote = socket(AF_INET, SOCK_STREAM, 0);
-                if(sock_remote < 0) {
-                    perror("ERROR opening socket to remote server");
-                    continue;
-                }
-                struct sockaddr_in remote_addr;
-                memset(&remote_addr, 0, sizeof(remote_addr));
-                remote_addr.sin_family = AF_INET;
-                remote_addr.sin_port = htons(target_port);
-                remote_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-                if(connect(sock_remote, (struct sockaddr *)&remote_addr, sizeof(remote_addr)) < 0) {
-                    perror("ERROR connecting to remote server");
-                    close(sock_remote);
-                    continue;
+                // a miss the filters answer needs no slot
+                const struct backend *cand[ROUTE_MAX_MEMBERS];
+                int nc = remote_candidates(pool, filepath, cand);
+                // the lane is taken before a backend is asked: once one holds a
+                // slot for this request and sends, waiting here would hold it up
+                long t = trace_now();
+                if(nc > 0) {
+                    lane_enter(lane_of(cmd, 0), client, 0);
+                    trace_span("lane", t, NULL);
                 }
-                // Send downlf command.
-                if(send_all(sock_remote, buffer, strlen(buffer)) < (ssize_t)strlen(buffer)) {
-                    perror("Error sending remote downlf command");
-                    close(sock_remote);
-                    continue;
-                }
-                // receive filesize header.
+                // send downlf command and receive filesize header.
                 uint32_t net_filesize_remote;
-                if(recv_all(sock_remote, &net_filesize_remote, sizeof(net_filesize_remote)) != sizeof(net_filesize_remote)) {
-                    send(client_sock, "Error receiving filesize from remote server\n", 45, 0);
-                    close(sock_remote);
+                int file_fd;
+                int sock_remote = nc > 0 ? open_remote(pool, cand, nc, fwd, &net_filesize_remote, &file_fd) : -1;
+                if(sock_remote < 0) {
+                    // no member has it, a zero size tells the client
+                    net_filesize_remote = 0;
+                    send(client_sock, &net_filesize_remote, sizeof(net_filesize_remote), 0);
                     continue;
                 }
-                send(client_sock, &net_filesize_remote, sizeof(net_filesize_remote), 0);
                 int remote_filesize = ntohl(net_filesize_remote);
-                char tempbuf[BUFSIZE];
-                int total_received = 0;
-                while(total_received < remote_filesize) {
-                    int rec = recv(sock_remote, tempbuf, BUFSIZE, 0);
-                    if(rec <= 0) break;
-                    send(client_sock, tempbuf, rec, 0);
-                    total_received += rec;
+                // a backend that passed the file is done with its slot, so this
+                // one can wait for the lane of the size; a relay moves to it
+                // only when a slot is free, else runs outside the lanes
+                t = trace_now();
+                if(file_fd >= 0 && lane_of(cmd, remote_filesize) != lane_of(cmd, 0))
+                    lane_enter(lane_of(cmd, remote_filesize), client, remote_filesize);
+                else
+                    lane_resize(lane_of(cmd, remote_filesize), client, remote_filesize);
+                trace_span("lane", t, NULL);
+                send(client_sock, &net_filesize_remote, sizeof(net_filesize_remote), 0);
+                t = trace_now();
+                if(file_fd >= 0) {
+                    // the backend passed the file itself, send it straight from the page cache
+                    if(fdpass_sendfile(client_sock, file_fd, remote_filesize) == 0)
+                        metrics_bytes(0, remote_filesize);
+                    close(file_fd);
+                    trace_span("sendfile", t, NULL);
+                } else {
+                    long total_received = relay(sock_remote, client_sock, remote_filesize);
+                    trace_span("relay", t, NULL);
+                    metrics_bytes(0, total_received);
                 }
-                close(sock_remote);
+                // the backend's checksum goes through untouched, the client checks it;
+                // without one the client could not tell a damaged file, so hang up
+                uint32_t net_crc;
+                int whole = remote_filesize == 0 ||
+                            recv_all(sock_remote, &net_crc, sizeof(net_crc)) == sizeof(net_crc);
+                bstat_close(sock_remote);
+                if(!whole)
+                    break;
+                if(remote_filesize > 0)
+                    send_all(client_sock, &net_crc, sizeof(net_crc));
             }
         }
         else if(strcasecmp(cmd, "removef") == 0) {
@@ -316,249 +919,520 @@ void prcclient(int client_sock) {
                 send(client_sock, "Invalid file extension\n", 23, 0);
                 continue;
             }
-            // remove local file if .c
-            if(strcasecmp(ext, ".c") == 0) {
+            const struct pool *pool = route_lookup(&routes, ext);
+            // remove from the in-process store
+            if(pool && pool->local) {
                 char localpath[600];
-                snprintf(localpath, sizeof(localpath), "./S1%s", (strstr(filepath, "~S1") ? filepath+3 : filepath));
-                if(remove(localpath) == 0)
+                if(store_remove(pool->dir, filepath, localpath, sizeof(localpath)) == 0) {
+                    tarcache_removed(pool->dir, filepath);
                     send(client_sock, "File removed successfully\n", 28, 0);
+                }
                 else
                     send(client_sock, "Error removing file\n", 21, 0);
             }
             // forward remove request to respective servers.
             else {
-                int target_port = 0;
-                if(strcasecmp(ext, ".pdf") == 0)
-                    target_port = 9002;
-                else if(strcasecmp(ext, ".txt") == 0)
-                    target_port = 9003;
-                else if(strcasecmp(ext, ".zip") == 0)
-                    target_port = 9004;
-                else {
+                if(!pool) {
                     send(client_sock, "Unsupported file type\n", 23, 0);
                     continue;
                 }
-                int sock_remote = socket(AF_INET, SOCK_STREAM, 0);
-                if(sock_remote < 0) { perror("ERROR opening remote socket"); continue; }
-                struct sockaddr_in remote_addr;
-                memset(&remote_addr, 0, sizeof(remote_addr));
-                remote_addr.sin_family = AF_INET;
-                remote_addr.sin_port = htons(target_port);
-                remote_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-                if(connect(sock_remote, (struct sockaddr *)&remote_addr, sizeof(remote_addr)) < 0) {
-                    perror("ERROR connecting to remote server");
-                    close(sock_remote);
-                    continue;
+                // remove from every candidate so a rebalance cannot bring back
+                // a copy that has not been moved yet
+                const struct backend *cand[ROUTE_MAX_MEMBERS];
+                char key[600], reply[BUFSIZE] = "Error removing file\n";
+                route_key(key, sizeof(key), filepath, NULL);
+                int nc = route_walk(&routes, pool, key, cand, pool->replicas + ROUTE_FALLBACK - 1);
+                for(int i = 0; i < nc; i++) {
+                    long t = trace_now();
+                    int sock_remote = bstat_connect(cand[i]);
+                    if(sock_remote < 0)
+                        continue;
+                    if(send_all(sock_remote, fwd, strlen(fwd)) < (ssize_t)strlen(fwd)) {
+                        perror("Error sending remote removef command");
+                        bstat_close(sock_remote);
+                        continue;
+                    }
+                    char rbuf[BUFSIZE];
+                    memset(rbuf, 0, BUFSIZE);
+                    n = recv(sock_remote, rbuf, BUFSIZE-1, 0);
+                    if(n > 0 && strncmp(rbuf, "File removed", 12) == 0)
+                        strcpy(reply, rbuf);
+                    bstat_close(sock_remote);
+                    trace_span("remove", t, cand[i]->name);
                 }
-                if(send_all(sock_remote, buffer, strlen(buffer)) < (ssize_t)strlen(buffer)) {
-                    perror("Error sending remote removef command");
-                    close(sock_remote);
+                send(client_sock, reply, strlen(reply), 0);
+            }
+        }
+        else if(strcasecmp(cmd, "removem") == 0) {
+            // expected: removem <pattern>, a ~S1 directory ending in '/' or a
+            // glob, or removem alone followed after READY by <size><list><crc>,
+            // one path per line. each backend is sent its share in one request
+            // and they all remove at once; the answer is a count
+            char pattern[512] = "";
+            sscanf(buffer, "%*s %511s", pattern);
+            if(pattern[0] && strncmp(pattern, "~S1/", 4) != 0) {
+                send(client_sock, "Invalid command syntax\n", 23, 0);
+                continue;
+            }
+            struct pathlist list = {NULL, 0, 0};
+            if(!pattern[0]) {
+                send(client_sock, "READY", 5, 0);
+                uint32_t net_size, net_crc;
+                if(recv_all(client_sock, &net_size, sizeof(net_size)) != sizeof(net_size))
+                    break;
+                size_t size = ntohl(net_size);
+                char *text = malloc(size ? size : 1);
+                if(!text)
+                    break;  // the list cannot be skipped, the connection is lost anyway
+                int whole = recv_all(client_sock, text, size) == (ssize_t)size &&
+                            (size == 0 || recv_all(client_sock, &net_crc, sizeof(net_crc)) == sizeof(net_crc));
+                if(!whole) {
+                    free(text);
+                    break;
+                }
+                metrics_bytes(size, 0);
+                if(size > 0 && ntohl(net_crc) != crc32c(0, text, size)) {
+                    free(text);
+                    send(client_sock, "Checksum mismatch\n", 18, 0);
                     continue;
                 }
-                memset(buffer, 0, BUFSIZE);
-                n = recv(sock_remote, buffer, BUFSIZE-1, 0);
-                if(n > 0)
-                    send(client_sock, buffer, n, 0);
-                close(sock_remote);
+                pathlist_split(&list, text, size);
+                free(text);
+            }
+            struct nameset asked = {NULL, 0, 0}, removed = {NULL, 0, 0}, failed = {NULL, 0, 0};
+            int ask[ROUTE_MAX_BACKENDS] = {0}, missed = 0;
+            if(pattern[0]) {
+                // a pattern ending in an extension only reaches that type's stores
+                const char *ext = strrchr(strrchr(pattern, '/'), '.');
+                const struct pool *only = ext && !ext[strcspn(ext, "*?[")] ? route_lookup(&routes, ext) : NULL;
+                for(int i = 0; i < routes.npools; i++) {
+                    const struct pool *lp = &routes.pools[i];
+                    int seen = !lp->local || (only && lp != only);
+                    for(int j = 0; j < i && !seen; j++)
+                        seen = routes.pools[j].local && strcmp(routes.pools[j].dir, lp->dir) == 0;
+                    if(seen)
+                        continue;
+                    struct pathlist found = {NULL, 0, 0};
+                    store_find(lp->dir, pattern, &found);
+                    remove_local(lp->dir, &found, &removed, &failed);
+                    pathlist_free(&found);
+                }
+                for(int i = 0; i < routes.nbackends; i++)
+                    ask[i] = !only;
+                for(int m = 0; only && m < only->nmembers; m++)
+                    ask[only->members[m]] = 1;
+                missed = remove_remote(fwd, ask, NULL, &removed, &failed);
+            } else {
+                // split the list by where each path can be: every candidate a
+                // removef would try, so a rebalance cannot bring one back
+                struct pathlist *shares = calloc(routes.nbackends + routes.npools, sizeof(*shares));
+                for(size_t p = 0; shares && p < list.n; p++) {
+                    if(nameset_add(&asked, list.v[p]))
+                        continue;
+                    char *ext = strrchr(list.v[p], '.');
+                    const struct pool *pool = ext ? route_lookup(&routes, ext) : NULL;
+                    if(!pool)
+                        continue;   // no such type, no such file
+                    if(pool->local) {
+                        pathlist_add(&shares[routes.nbackends + (pool - routes.pools)], list.v[p]);
+                        continue;
+                    }
+                    const struct backend *cand[ROUTE_MAX_MEMBERS];
+                    char key[600];
+                    route_key(key, sizeof(key), list.v[p], NULL);
+                    int nc = route_walk(&routes, pool, key, cand, pool->replicas + ROUTE_FALLBACK - 1);
+                    for(int i = 0; i < nc; i++) {
+                        pathlist_add(&shares[cand[i] - routes.backends], list.v[p]);
+                        ask[cand[i] - routes.backends] = 1;
+                    }
+                }
+                for(int i = 0; shares && i < routes.npools; i++)
+                    if(shares[routes.nbackends + i].n)
+                        remove_local(routes.pools[i].dir, &shares[routes.nbackends + i], &removed, &failed);
+                if(shares)
+                    missed = remove_remote(fwd, ask, shares, &removed, &failed);
+                for(int i = 0; shares && i < routes.nbackends + routes.npools; i++)
+                    pathlist_free(&shares[i]);
+                free(shares);
             }
+            // a copy that failed on one replica but went on another is gone
+            size_t nfailed = 0;
+            for(size_t i = 0; i < failed.cap; i++)
+                nfailed += failed.slots[i] && !nameset_has(&removed, failed.slots[i]);
+            char reply[128];
+            int len = snprintf(reply, sizeof(reply), "Removed %zu files", removed.used);
+            if(!pattern[0] && asked.used > removed.used + nfailed)
+                len += snprintf(reply + len, sizeof(reply) - len, ", %zu not found", asked.used - removed.used - nfailed);
+            if(nfailed)
+                len += snprintf(reply + len, sizeof(reply) - len, ", %zu failed", nfailed);
+            // copies there are still there
+            if(missed)
+                len += snprintf(reply + len, sizeof(reply) - len, ", %d server%s unreachable", missed, missed == 1 ? "" : "s");
+            len += snprintf(reply + len, sizeof(reply) - len, "\n");
+            send(client_sock, reply, len, 0);
+            nameset_free(&asked);
+            nameset_free(&removed);
+            nameset_free(&failed);
+            pathlist_free(&list);
         }
         else if(strcasecmp(cmd, "downltar") == 0) {
-            // expected: downltar <filetype>
-            char filetype[10];
-            if(sscanf(buffer, "%*s %s", filetype) != 1) {
+            // expected: downltar <filetype> [since], since a snapshot token
+            // or a time for only what changed from then on
+            char filetype[10], arg[64] = "";
+            struct timespec since;
+            if(sscanf(buffer, "%*s %9s %63s", filetype, arg) < 1) {
                 send(client_sock, "Invalid command syntax\n", 23, 0);
                 continue;
             }
-            if(strcasecmp(filetype, ".c") == 0) {
-                // create tar of all .c files in ./S1
-                char tarname[20];
-                strcpy(tarname, "cfiles.tar");
-                char cmdline[600];
-                snprintf(cmdline, sizeof(cmdline), "tar -cf %s ./S1 >/dev/null 2>&1", tarname);
-                system(cmdline);
-                FILE *fp = fopen(tarname, "rb");
-                if(!fp) {
+            if(arg[0] && tarcache_since(arg, &since) < 0) {
+                send(client_sock, "Invalid snapshot token\n", 23, 0);
+                continue;
+            }
+            const struct pool *pool = route_lookup(&routes, filetype);
+            if(pool && pool->local) {
+                // the in-process store's cached archive, as the backends keep theirs
+                char name[32];
+                snprintf(name, sizeof(name), "%sfiles", pool->ext + 1);
+                long t = trace_now();
+                off_t body;
+                uint32_t crc;
+                char *manifest;
+                int fd = tarcache_open(pool->dir, name, arg[0] ? &since : NULL, &body, &crc, &manifest);
+                trace_span("tar", t, NULL);
+                if(fd < 0) {
                     send(client_sock, "ERROR creating tar\n", 21, 0);
                     continue;
                 }
-                fseek(fp, 0, SEEK_END);
-                int filesize = ftell(fp);
-                rewind(fp);
-                uint32_t net_filesize = htonl(filesize);
-                send(client_sock, &net_filesize, sizeof(net_filesize), 0);
-                char filebuf[BUFSIZE];
-                while((n = fread(filebuf, 1, BUFSIZE, fp)) > 0)
-                    send(client_sock, filebuf, n, 0);
-                fclose(fp);
-                remove(tarname);
+                t = trace_now();
+                if(tarcache_send(client_sock, fd, body, crc, manifest) == 0)
+                    metrics_bytes(0, body + TARCACHE_END);
+                close(fd);
+                free(manifest);
+                trace_span("send_client", t, NULL);
             }
             // forward request to respective server
             else {
-                int target_port = 0;
-                if(strcasecmp(filetype, ".pdf") == 0)
-                    target_port = 9002;
-                else if(strcasecmp(filetype, ".txt") == 0)
-                    target_port = 9003;
-                else if(strcasecmp(filetype, ".zip") == 0)
-                    target_port = 9004;
-                else {
+                if(!pool || pool->nmembers == 0) {
                     send(client_sock, "Unsupported file type for tar\n", 31, 0);
                     continue;
                 }
-                int sock_remote = socket(AF_INET, SOCK_STREAM, 0);
-                if(sock_remote < 0) { perror("ERROR opening remote socket"); continue; }
-                struct sockaddr_in remote_addr;
-                memset(&remote_addr, 0, sizeof(remote_addr));
-                remote_addr.sin_family = AF_INET;
-                remote_addr.sin_port = htons(target_port);
-                remote_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-                if(connect(sock_remote, (struct sockaddr *)&remote_addr, sizeof(remote_addr)) < 0) {
-                    perror("ERROR connecting to remote server");
-                    close(sock_remote);
-                    continue;
+                // the type is sharded, so merge the archives of all members
+                char tarname[64];
+                snprintf(tarname, sizeof(tarname), "%sfiles.%d.tar", pool->ext + 1, (int)getpid());
+                long t = trace_now();
+                int merged = merge_remote_tars(pool, fwd, tarname, arg[0] ? &since : NULL);
+                if(merged == 1) {
+                    // a member's log does not go back that far: all of them in full
+                    char cmdline[64];
+                    snprintf(cmdline, sizeof(cmdline), "downltar %s", filetype);
+                    trace_tag(fwd, sizeof(fwd), cmdline);
+                    lane_tag(fwd, sizeof(fwd));
+                    merged = merge_remote_tars(pool, fwd, tarname, NULL);
                 }
-                if(send_all(sock_remote, buffer, strlen(buffer)) < (ssize_t)strlen(buffer)) {
-                    perror("Error sending remote downltar command");
-                    close(sock_remote);
+                trace_span("merge", t, NULL);
+                if(merged < 0) {
+                    remove(tarname);
+                    send(client_sock, "Error receiving tar filesize from remote server\n", 50, 0);
                     continue;
                 }
-                uint32_t net_filesize_remote;
-                if(recv_all(sock_remote, &net_filesize_remote, sizeof(net_filesize_remote)) != sizeof(net_filesize_remote)) {
-                    send(client_sock, "Error receiving tar filesize from remote server\n", 50, 0);
-                    close(sock_remote);
+                FILE *fp = fopen(tarname, "rb");
+                if(!fp) {
+                    send(client_sock, "ERROR creating tar\n", 21, 0);
                     continue;
                 }
-                send(client_sock, &net_filesize_remote, sizeof(net_filesize_remote), 0);
-                int remote_filesize = ntohl(net_filesize_remote);
-                char tempbuf[BUFSIZE];
-                int total_received = 0;
-                while(total_received < remote_filesize) {
-                    int rec = recv(sock_remote, tempbuf, BUFSIZE, 0);
-                    if(rec <= 0)
-                        break;
-                    send(client_sock, tempbuf, rec, 0);
-                    total_received += rec;
+                fseek(fp, 0, SEEK_END);
+                int filesize = ftell(fp);
+                rewind(fp);
+                uint32_t net_filesize = htonl(filesize), crc = 0;
+                send(client_sock, &net_filesize, sizeof(net_filesize), 0);
+                metrics_bytes(0, filesize);
+                t = trace_now();
+                send_file(fp, client_sock, &crc);
+                fclose(fp);
+                if(filesize > 0) {
+                    uint32_t net_crc = htonl(crc);
+                    send_all(client_sock, &net_crc, sizeof(net_crc));
                 }
-                close(sock_remote);
+                trace_span("send_client", t, NULL);
+                remove(tarname);
             }
         }
         else if (strcasecmp(cmd, "dispfnames") == 0) {
-            char pathname[512];
-            if (sscanf(buffer, "%*s %s", pathname) != 1) {
+            // expected: dispfnames <pathname> [-r] [-l] [-g glob] [-n count] [-c cursor]
+            // the in-process stores and the backends list at the same time and
+            // their lists, all in listing order, are merged and passed on as
+            // they come, a replicated file once. the last line counts them and,
+            // when the count ran out first, gives the cursor of the next page
+            struct store_listing l;
+            if (store_listing_parse(buffer, &l) < 0) {
                 send(client_sock, "Invalid command syntax\n", 23, 0);
                 continue;
             }
-            // build path
-            char subpath[512] = "";
-            char *p = strstr(pathname, "~S1");
-            if (p != NULL) {
-                p += 3; // skip "~S1"
-                if (strcmp(p, "/") != 0 && strlen(p) > 0)
-                    strncpy(subpath, p, sizeof(subpath) - 1);
-            } else {
-                strncpy(subpath, pathname, sizeof(subpath) - 1);
-            }
-            char local_path[600];
-            snprintf(local_path, sizeof(local_path), "./S1%s", subpath);
-            
-            // execute file command
-            char find_cmd[700];
-            snprintf(find_cmd, sizeof(find_cmd), "find %s -maxdepth 1 -type f | sort", local_path);
-            FILE *fp = popen(find_cmd, "r");
-            char combined[4096];
-            combined[0] = '\0';
-            if (fp != NULL) {
-                char temp[256];
-                while (fgets(temp, sizeof(temp), fp)) {
-                    strncat(combined, temp, sizeof(combined) - strlen(combined) - 1);
-                }
-                pclose(fp);
-            } else {
-                strncat(combined, "Error listing local files\n", sizeof(combined)-strlen(combined)-1);
-            }
-            
-            // get file names from remote servers
-            int remote_ports[3] = {9002, 9003, 9004};
-            for (int i = 0; i < 3; i++) {
-                int sock_remote = socket(AF_INET, SOCK_STREAM, 0);
-                if (sock_remote < 0)
+            // a glob ending in an extension only needs that type's stores
+            const char *ext = strrchr(l.glob, '.');
+            const struct pool *only = ext && !ext[strcspn(ext, "*?[")] ? route_lookup(&routes, ext) : NULL;
+            struct list_src *src = calloc(routes.npools + routes.nbackends, sizeof(*src));
+            if (!src) {
+                send(client_sock, "Memory allocation error\n", 24, 0);
+                continue;
+            }
+            int nsrc = 0, missed = 0;
+            // in-process stores, each directory once; a stateless S1 has none
+            for (int i = 0; i < routes.npools; i++) {
+                const struct pool *lp = &routes.pools[i];
+                int seen = !lp->local || (only && lp != only);
+                for (int j = 0; j < i && !seen; j++)
+                    seen = routes.pools[j].local && strcmp(routes.pools[j].dir, lp->dir) == 0;
+                if (!seen && (src[nsrc].it = store_iter_open(lp->dir, &l)) != NULL)
+                    nsrc++;
+            }
+            for (int i = 0; i < routes.nbackends; i++) {
+                int asked = !only;
+                for (int m = 0; only && m < only->nmembers; m++)
+                    asked |= only->members[m] == i;
+                if (!asked)
                     continue;
-                struct sockaddr_in remote_addr;
-                memset(&remote_addr, 0, sizeof(remote_addr));
-                remote_addr.sin_family = AF_INET;
-                remote_addr.sin_port = htons(remote_ports[i]);
-                remote_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-                if (connect(sock_remote, (struct sockaddr *)&remote_addr, sizeof(remote_addr)) < 0) {
-                    close(sock_remote);
+                struct list_src *ls = &src[nsrc];
+                ls->t = trace_now();
+                ls->b = &routes.backends[i];
+                ls->sock = start_remote(ls->b, fwd);
+                ls->in = ls->sock >= 0 ? fdopen(dup(ls->sock), "r") : NULL;
+                if (ls->in) {
+                    nsrc++;
                     continue;
                 }
-                // forward command to remote server
-                if (send_all(sock_remote, buffer, strlen(buffer)) < (ssize_t)strlen(buffer)) {
-                    close(sock_remote);
-                    continue;
+                bstat_close(ls->sock);
+                missed++;
+            }
+            for (int i = 0; i < nsrc; i++)
+                list_advance(&src[i], &l);
+            char out[16384], last[1100] = "";
+            size_t olen = 0, total = 0;
+            long count = 0;
+            int more = 0;
+            while (1) {
+                int m = -1;
+                for (int i = 0; i < nsrc; i++)
+                    if (src[i].live && (m < 0 || store_pathcmp(src[i].path, src[m].path) < 0))
+                        m = i;
+                if (m < 0) {
+                    for (int i = 0; i < nsrc; i++)
+                        more |= src[i].more;
+                    break;
+                }
+                if (l.limit && count == l.limit) {
+                    more = 1;
+                    break;
                 }
-                char remote_buf[1024];
-                int r;
-                while ((r = recv(sock_remote, remote_buf, sizeof(remote_buf) - 1, 0)) > 0) {
-                    remote_buf[r] = '\0';
-                    strncat(combined, remote_buf, sizeof(combined)-strlen(combined)-1);
+                size_t len = strlen(src[m].line);
+                if (olen + len > sizeof(out)) {
+                    if (send_all(client_sock, out, olen) < (ssize_t)olen)
+                        break;
+                    total += olen;
+                    olen = 0;
                 }
-                close(sock_remote);
+                memcpy(out + olen, src[m].line, len);
+                olen += len;
+                count++;
+                snprintf(last, sizeof(last), "%s", src[m].path);
+                // the copies on other replicas go with it
+                for (int i = 0; i < nsrc; i++)
+                    while (src[i].live && strcmp(src[i].path, last) == 0)
+                        list_advance(&src[i], &l);
             }
-            
-            if (strlen(combined) == 0)
-                send(client_sock, "No files found\n", 15, 0);
-            else
-                send(client_sock, combined, strlen(combined), 0);
+            for (int i = 0; i < nsrc; i++) {
+                store_iter_close(src[i].it);
+                if (!src[i].in)
+                    continue;
+                missed += src[i].broken;
+                fclose(src[i].in);
+                bstat_close(src[i].sock);
+                trace_span("list", src[i].t, src[i].b->name);
+            }
+            free(src);
+            // copies of anything there are missing from the list
+            char tail[1300];
+            int tlen = snprintf(tail, sizeof(tail), "-- %ld files", count);
+            if (missed)
+                tlen += snprintf(tail + tlen, sizeof(tail) - tlen, ", %d server%s unreachable", missed, missed == 1 ? "" : "s");
+            if (more)
+                tlen += snprintf(tail + tlen, sizeof(tail) - tlen, ", next -c %s", last);
+            tlen += snprintf(tail + tlen, sizeof(tail) - tlen, "\n");
+            send_all(client_sock, out, olen);
+            send_all(client_sock, tail, tlen);
+            metrics_bytes(0, total + olen + tlen);
         }
         else {
             send(client_sock, "Invalid command\n", 16, 0);
         }
     }
+    metrics_end();
+    trace_end();
+    replica_wait_all();
+    lane_leave();
     close(client_sock);
 }
 
+// reload routing table; poll() returns EINTR so it happens right away
+void on_sighup(int sig) {
+    (void)sig;
+    reload_routes = 1;
+}
+
+void stop_helper(pid_t pid) {
+    if(pid > 0) {
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+}
+
+// a helper process for the current routing table (health prober, filter
+// sync), restarted after each reload
+pid_t start_helper(pid_t old, void (*loop)(const struct route_table *), const char *what) {
+    stop_helper(old);
+    pid_t pid = fork();
+    if(pid == 0) {
+        loop(&routes);
+        exit(0);
+    }
+    if(pid < 0)
+        fprintf(stderr, "ERROR starting %s: %s\n", what, strerror(errno));
+    return pid;
+}
+
+// everything the metrics endpoint shows besides the request counters
+void export_backends(FILE *out) {
+    bstat_export(out);
+    bfilter_export(out);
+    lanes_export(out);
+    tarcache_export(out);
+}
+
 // main function
 int main(int argc, char *argv[]){
-    int sockfd, newsockfd, portno;
-    pid_t pid;
-    struct sockaddr_in serv_addr, cli_addr;
+    int sockfd, newsockfd, portno, acceptor;
+    pid_t pid, acceptors[ACCEPT_MAX];
+    struct sockaddr_in cli_addr;
     socklen_t clilen;
+    struct acceptor_opts opts;
     
     // get port number from command line
-    if(argc < 2) {
-       fprintf(stderr, "Usage: %s port\n", argv[0]);
+    int arg = acceptor_options(argc, argv, &opts);
+    if(arg < 0 || argc <= arg) {
+       fprintf(stderr, "Usage: %s [-a acceptors] [-b backlog] [-m admin_port] [-t tracefile] [-l meta,small,bulk] [-H handoffpath] port [routes.conf]\n", argv[0]);
        exit(1);
     }
 
-    // add port and ip address
-    portno = atoi(argv[1]);
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if(opts.unix_path) {
+        fprintf(stderr, "-u is for the storage servers; give S1 their sockets as unix:<path> in %s\n", ROUTE_CONF);
+        exit(1);
+    }
+    if(opts.pack_max) {
+        fprintf(stderr, "-p is for the storage servers\n");
+        exit(1);
+    }
+
+    // load routing table, falling back to the built-in one when no config exists
+    if(argc > arg + 1)
+        route_conf = argv[arg + 1];
+    route_defaults(&routes);
+    if(access(route_conf, F_OK) == 0 && route_load(&routes, route_conf) < 0) {
+        fprintf(stderr, "ERROR loading %s\n", route_conf);
+        exit(1);
+    }
+    if(bstat_init() < 0)
+        error("ERROR mapping backend statistics");
+    if(bfilter_init() < 0)
+        error("ERROR mapping backend filters");
+    // workers serve a client's commands one after another, so bulk ones are not reniced
+    if(lanes_init(opts.lanes, 0) < 0) {
+        fprintf(stderr, "Bad lane slots %s, want meta,small,bulk\n", opts.lanes);
+        exit(1);
+    }
+    if(tarcache_init(store_tar) < 0)
+        error("ERROR mapping archive cache");
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sighup;
+    sigaction(SIGHUP, &sa, NULL);
+
+    // bind and listen, forking the extra acceptors when asked to
+    portno = atoi(argv[arg]);
+    if(metrics_init("S1") < 0)
+        error("ERROR mapping metrics");
+    if(trace_open(opts.trace_path, "S1") < 0)
+        error("ERROR opening trace file");
+    // on a restart with -H, serve on the running instance's sockets; until
+    // it has drained its workers may change the local stores, so no cached
+    // archive of them is served
+    int predecessor = acceptor_takeover(&opts);
+    if(predecessor >= 0)
+        tarcache_hold(1);
+    sockfd = acceptor_start(portno, &opts, acceptors, &acceptor);
     if(sockfd < 0)
-         error("ERROR opening socket");
-    memset((char *)&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_addr.s_addr = INADDR_ANY;
-    serv_addr.sin_port = htons(portno);
-    
-    // bind socket to port
-    if(bind(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
          error("ERROR on binding");
-    
-    // listen for incoming connections
-    listen(sockfd, 5);
+    pid_t admin = acceptor == 0 ? metrics_serve(opts.admin_port, export_backends) : 0;
+    int ctlfd = acceptor == 0 ? acceptor_control(&opts) : -1;
+    if(opts.handoff_path && acceptor == 0 && ctlfd < 0)
+        error("ERROR binding handoff socket");
     clilen = sizeof(cli_addr);
 
-    // accept connections
+    // one prober and one filter sync are enough, both share their results
+    // with all acceptors
+    pid_t prober = acceptor == 0 ? start_helper(0, bstat_probe_loop, "health prober") : 0;
+    pid_t syncer = acceptor == 0 ? start_helper(0, bfilter_sync_loop, "filter sync") : 0;
+
+    // accept connections; a negative fd is skipped by poll
+    struct pollfd pfd[3] = {{sockfd, POLLIN, 0}, {ctlfd, POLLIN, 0}, {predecessor, POLLIN, 0}};
     while(1) {
-       newsockfd = accept(sockfd, (struct sockaddr *)&cli_addr, &clilen);
-       if(newsockfd < 0)
+       int ready = poll(pfd, 3, -1), err = 0;
+       if(ready < 0 && errno != EINTR)
+           error("ERROR on poll");
+       // a new instance taking the sockets over, or SIGUSR2
+       int peer = ready > 0 && pfd[1].revents & POLLIN ? acceptor_handoff(ctlfd) : -1;
+       if(peer >= 0 || acceptor_draining()) {
+           stop_helper(admin);
+           stop_helper(prober);
+           stop_helper(syncer);
+           acceptor_drain(peer, acceptors, acceptor == 0 ? opts.count - 1 : 0);
+       }
+       if(ready > 0 && pfd[2].revents & (POLLIN | POLLHUP)) {
+           // the old instance has drained
+           close(predecessor);
+           pfd[2].fd = -1;
+           if(acceptor == 0)
+               tarcache_hold(0);
+       }
+       newsockfd = -1;
+       if(ready > 0 && pfd[0].revents & POLLIN) {
+           newsockfd = accept(sockfd, (struct sockaddr *)&cli_addr, &clilen);
+           err = newsockfd < 0 ? errno : 0;
+       }
+       if(reload_routes) {
+           reload_routes = 0;
+           // SIGHUP goes to the first acceptor, which passes it on
+           for(int i = 0; acceptor == 0 && i < opts.count - 1; i++)
+               if(acceptors[i] > 0)
+                   kill(acceptors[i], SIGHUP);
+           if(route_load(&routes, route_conf) < 0)
+               fprintf(stderr, "ERROR reloading %s, keeping old routes\n", route_conf);
+           else if(acceptor == 0) {
+               prober = start_helper(prober, bstat_probe_loop, "health prober");
+               syncer = start_helper(syncer, bfilter_sync_loop, "filter sync");
+           }
+       }
+       while(waitpid(-1, NULL, WNOHANG) > 0)
+           ;   // reap finished workers
+       if(newsockfd < 0) {
+           if(err == 0 || err == EINTR) continue;
+           errno = err;
            error("ERROR on accept");
+       }
        pid = fork(); // fork process for each connection
        if(pid < 0)
            error("ERROR on fork");
        if(pid == 0) { 
-          close(sockfd);
+          acceptor_child();
           prcclient(newsockfd);
           exit(0);
        }
@@ -0,0 +1,315 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : acceptor.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Listening socket setup shared by all servers, with an optional
+ *               multi-acceptor mode: N processes pinned to cores, each with its
+ *               own SO_REUSEPORT socket so the kernel spreads accepts over them,
+ *               and the handoff of the sockets to a new instance on restart.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/prctl.h>
+#endif
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "acceptor.h"
+#include "fdpass.h"
+
+// the first acceptor keeps every listener open, so it can hand them all over
+static int listeners[ACCEPT_MAX];
+static int nlisteners;
+static int unix_listener = -1;
+static int control = -1;
+static int taken;                       // the listeners came from the old instance
+static volatile sig_atomic_t draining;
+
+int acceptor_options(int argc, char *argv[], struct acceptor_opts *o) {
+    o->count = 1;
+    o->backlog = ACCEPT_BACKLOG;
+    o->admin_port = 0;
+    o->trace_path = NULL;
+    o->unix_path = NULL;
+    o->pack_max = 0;
+    o->lanes = NULL;
+    o->handoff_path = NULL;
+    int c;
+    while((c = getopt(argc, argv, "a:b:m:t:u:p:l:H:")) != -1) {
+        if(c == 'a')
+            o->count = atoi(optarg);
+        else if(c == 'b')
+            o->backlog = atoi(optarg);
+        else if(c == 'm')
+            o->admin_port = atoi(optarg);
+        else if(c == 't')
+            o->trace_path = optarg;
+        else if(c == 'u')
+            o->unix_path = optarg;
+        else if(c == 'p')
+            o->pack_max = atol(optarg);
+        else if(c == 'l')
+            o->lanes = optarg;
+        else if(c == 'H')
+            o->handoff_path = optarg;
+        else
+            return -1;
+    }
+    if(o->count < 1 || o->count > ACCEPT_MAX || o->backlog < 1 || o->pack_max < 0)
+        return -1;
+    return optind;
+}
+
+static int open_listener(int port, const struct acceptor_opts *o) {
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if(sockfd < 0)
+        return -1;
+    int one = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    // accepted connections inherit it: sizes and checksums are small sends
+    // next to the data, which Nagle would hold back for a delayed ACK
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    // every acceptor binds its own socket, the kernel hashes connections over them
+    if(o->count > 1 && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        close(sockfd);
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if(bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sockfd, o->backlog) < 0) {
+        int saved = errno;
+        close(sockfd);
+        errno = saved;
+        return -1;
+    }
+    return sockfd;
+}
+
+// pin to one core; workers forked from this acceptor inherit it
+static void pin(int index) {
+#ifdef __linux__
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if(ncpu < 1) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % ncpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)index;
+#endif
+}
+
+static void on_drain(int sig) {
+    (void)sig;
+    draining = 1;
+}
+
+int acceptor_start(int port, const struct acceptor_opts *o, pid_t *pids, int *index) {
+    *index = 0;
+    // bind them all in the original process first so a busy port fails before any fork
+    for(; !taken && nlisteners < o->count; nlisteners++) {
+        if((listeners[nlisteners] = open_listener(port, o)) < 0) {
+            int saved = errno;
+            while(nlisteners > 0)
+                close(listeners[--nlisteners]);
+            errno = saved;
+            return -1;
+        }
+    }
+    // no SA_RESTART, so accept and poll return to look at the flag
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_drain;
+    sigaction(SIGUSR2, &sa, NULL);
+    if(nlisteners == 1)
+        return listeners[0];
+    for(int i = 1; i < nlisteners; i++) {
+        pid_t pid = fork();
+        if(pid == 0) {
+#ifdef __linux__
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+            for(int k = 0; k < nlisteners; k++)
+                if(k != i) close(listeners[k]);
+            listeners[0] = listeners[i];
+            nlisteners = 1;
+            pin(i);
+            *index = i;
+            return listeners[0];
+        }
+        pids[i - 1] = pid;
+        if(pid < 0)
+            perror("ERROR starting acceptor");
+    }
+    pin(0);
+    return listeners[0];
+}
+
+// a listening Unix socket at path, replacing whatever file is there
+static int unix_listen(const char *path, int backlog) {
+    struct sockaddr_un addr;
+    errno = EINVAL;
+    if(!path || strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(sockfd < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    // a socket file left by an earlier run would fail the bind
+    unlink(path);
+    if(bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sockfd, backlog) < 0) {
+        int saved = errno;
+        close(sockfd);
+        errno = saved;
+        return -1;
+    }
+    return sockfd;
+}
+
+int acceptor_unix(const struct acceptor_opts *o) {
+    // the old instance's is already bound to the path
+    if(taken && unix_listener >= 0)
+        return unix_listener;
+    int sockfd = unix_listen(o->unix_path, o->backlog);
+    if(sockfd < 0)
+        return -1;
+    // all acceptors poll the one socket; whoever loses the race gets EAGAIN
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+    unix_listener = sockfd;
+    return sockfd;
+}
+
+void acceptor_child(void) {
+    for(int i = 0; i < nlisteners; i++)
+        close(listeners[i]);
+    if(unix_listener >= 0)
+        close(unix_listener);
+    if(control >= 0)
+        close(control);
+}
+
+/*
+ * The old instance sends each listener with one byte saying what it is, 'L'
+ * for TCP and 'U' for Unix, then 'E'. The new one answers 'A' once it holds
+ * them all, and only then does the old one stop accepting; it sends 'R' when
+ * its admin port is free and closes the connection when it has drained.
+ */
+int acceptor_takeover(struct acceptor_opts *o) {
+    struct sockaddr_un addr;
+    if(!o->handoff_path || strlen(o->handoff_path) >= sizeof(addr.sun_path))
+        return -1;
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(sock < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, o->handoff_path);
+    // nobody there: the first start, or the old instance is gone
+    if(connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    struct timeval tv = {ACCEPT_HANDOFF_MS / 1000, ACCEPT_HANDOFF_MS % 1000 * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char kind = 0;
+    int fd;
+    while(fdpass_recv(sock, &kind, 1, &fd) == 1 && kind != 'E') {
+        if(kind == 'L' && fd >= 0 && nlisteners < ACCEPT_MAX)
+            listeners[nlisteners++] = fd;
+        else if(kind == 'U' && fd >= 0 && unix_listener < 0)
+            unix_listener = fd;
+        else if(fd >= 0)
+            close(fd);
+    }
+    if(kind != 'E' || nlisteners == 0 || send(sock, "A", 1, 0) != 1) {
+        // the old instance keeps serving, and binding fails on its ports
+        while(nlisteners > 0)
+            close(listeners[--nlisteners]);
+        if(unix_listener >= 0)
+            close(unix_listener);
+        unix_listener = -1;
+        close(sock);
+        return -1;
+    }
+    taken = 1;
+    o->count = nlisteners;
+    // the admin port is ours once it says so; after the timeout, try anyway
+    recv(sock, &kind, 1, 0);
+    return sock;
+}
+
+int acceptor_control(const struct acceptor_opts *o) {
+    if(!o->handoff_path)
+        return -1;
+    control = unix_listen(o->handoff_path, 1);
+    return control;
+}
+
+int acceptor_handoff(int ctl) {
+    int sock = accept(ctl, NULL, NULL);
+    if(sock < 0)
+        return -1;
+    struct timeval tv = {ACCEPT_HANDOFF_MS / 1000, ACCEPT_HANDOFF_MS % 1000 * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    int ok = 1;
+    for(int i = 0; ok && i < nlisteners; i++)
+        ok = fdpass_send(sock, "L", 1, listeners[i]) == 0;
+    if(ok && unix_listener >= 0)
+        ok = fdpass_send(sock, "U", 1, unix_listener) == 0;
+    char ack;
+    if(!ok || send(sock, "E", 1, 0) != 1 || recv(sock, &ack, 1, 0) != 1 || ack != 'A') {
+        fprintf(stderr, "Handoff to the new instance failed, still serving\n");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int acceptor_draining(void) {
+    return draining;
+}
+
+void acceptor_drain(int peer, const pid_t *pids, int npids) {
+    for(int i = 0; i < nlisteners; i++)
+        close(listeners[i]);
+    if(unix_listener >= 0)
+        close(unix_listener);
+    if(control >= 0)
+        close(control);
+    for(int i = 0; i < npids; i++)
+        if(pids[i] > 0)
+            kill(pids[i], SIGUSR2);
+    if(peer >= 0)
+        send(peer, "R", 1, 0);
+    // the acceptors are children too, and exit once their workers have
+    for(int ms = 0; ms < ACCEPT_DRAIN_MS; ms += 50) {
+        pid_t pid;
+        while((pid = waitpid(-1, NULL, WNOHANG)) > 0)
+            ;
+        if(pid < 0)
+            break;      // none left
+        usleep(50 * 1000);
+    }
+    exit(0);
+}
@@ -0,0 +1,90 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : acceptor.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Listening socket setup shared by all servers, with an optional
+ *               multi-acceptor mode: N processes pinned to cores, each with its
+ *               own SO_REUSEPORT socket so the kernel spreads accepts over them,
+ *               and the handoff of the sockets to a new instance on restart.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef ACCEPTOR_H
+#define ACCEPTOR_H
+
+#include <sys/types.h>
+
+#define ACCEPT_BACKLOG  128     // default listen() backlog
+#define ACCEPT_MAX      64      // max acceptor processes
+#define ACCEPT_HANDOFF_MS 5000  // how long either side of a handoff waits on the other
+#define ACCEPT_DRAIN_MS 30000   // a replaced instance waits this long for its workers
+
+struct acceptor_opts {
+    int count;                  // acceptor processes, 1 = classic single socket
+    int backlog;
+    int admin_port;             // metrics endpoint on 127.0.0.1, 0 = off
+    const char *trace_path;     // trace span file, NULL = off
+    const char *unix_path;      // also listen on this Unix socket, NULL = off
+    long pack_max;              // pack files up to this size, 0 = off
+    const char *lanes;          // "meta,small,bulk" lane slots, NULL = defaults
+    const char *handoff_path;   // Unix socket the next instance takes the listeners over from, NULL = off
+};
+
+// parse the options every server takes, "-a acceptors", "-b backlog",
+// "-m admin_port", "-t tracefile", "-u socketpath", "-p packsize",
+// "-l meta,small,bulk" and "-H handoffpath";
+// returns the index of the first positional argument, or -1 on a bad option
+int acceptor_options(int argc, char *argv[], struct acceptor_opts *o);
+
+/*
+ * Bind the listening socket and fork the other count-1 acceptors. Returns the
+ * socket this process accepts on (-1 with errno set when bind fails) and
+ * stores its index in *index; index 0 is the original process, which gets
+ * the pids of the others for forwarding signals. Acceptors die with it.
+ */
+int acceptor_start(int port, const struct acceptor_opts *o, pid_t *pids, int *index);
+
+// the Unix socket listener, bound before acceptor_start so every acceptor
+// shares it; -1 when there is none or bind failed (errno set)
+int acceptor_unix(const struct acceptor_opts *o);
+
+/*
+ * Zero-downtime restarts. An instance started with -H path first asks the
+ * one already running with the same -H for its listening sockets (SCM_RIGHTS
+ * over the Unix socket at path) and serves on those instead of binding, with
+ * as many acceptors as the old one had whatever -a says. Connections arriving
+ * meanwhile wait in the shared accept queues, none is refused. The old
+ * instance stops accepting, frees its admin port and waits up to
+ * ACCEPT_DRAIN_MS for the requests in flight; its workers finish them either
+ * way. SIGUSR2 drains an instance the same way without a successor.
+ */
+
+// in a worker just forked: close the listeners it inherited, so a port is
+// free again once the server itself is gone
+void acceptor_child(void);
+
+// before acceptor_unix: take over the sockets of the instance on
+// o->handoff_path. Returns the connection to it, which reads end of file once
+// it has drained, or -1 when none handed over (bind as usual)
+int acceptor_takeover(struct acceptor_opts *o);
+
+// first acceptor, after acceptor_start: listen on o->handoff_path for the
+// next instance; -1 when off or bind failed
+int acceptor_control(const struct acceptor_opts *o);
+
+// hand the listeners to the instance connecting on the control socket;
+// returns the connection to pass to acceptor_drain, -1 to keep serving
+int acceptor_handoff(int ctl);
+
+// set once SIGUSR2 asked this acceptor to drain
+int acceptor_draining(void);
+
+// stop accepting, drain the acceptors in pids too and tell peer (when >= 0)
+// the sockets are its own, then wait for the workers and exit; helpers
+// holding ports must be stopped first
+void acceptor_drain(int peer, const pid_t *pids, int npids);
+
+#endif
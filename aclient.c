@@ -0,0 +1,696 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : aclient.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Non-blocking client for S1. Operations are queued and run over
+ *               a pool of connections from one thread, with a callback when
+ *               each completes; the caller drives it with aclient_run() or
+ *               from its own poll/epoll loop through aclient_fd().
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include "aclient.h"
+#include "client.h"
+#include "crc32c.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+enum { OP_UPLOAD, OP_FETCH, OP_TEXT, OP_LIST };
+
+// where a connection is in its current operation
+enum {
+    PH_IDLE,
+    PH_CMD,                     // sending the command line
+    PH_READY,                   // upload: waiting for READY
+    PH_BODY,                    // upload: sending <size><data><crc>
+    PH_HEAD,                    // fetch: reading the size
+    PH_DATA,                    // fetch: reading the file
+    PH_TRAIL,                   // fetch: reading its checksum
+    PH_TEXT,                    // reading a text reply up to its newline
+    PH_LIST,                    // list: reading entries up to the status line
+};
+
+// where a listing is within its current line
+enum { L_START, L_ENTRY, L_STATUS };
+
+struct aop {
+    int kind;
+    char cmd[CLIENT_BUFSIZE];
+    const char *data;           // upload from memory
+    int fd;                     // upload from / fetch to a descriptor, else -1
+    uint32_t size;
+    aclient_cb cb;
+    void *arg;
+    struct aop *next;
+};
+
+struct aconn {
+    int fd;
+    int phase;
+    struct aop *op;
+    int status;                 // result once the text reply is in
+    size_t off;                 // progress through cmd, or the READY/size bytes
+    unsigned char head[8];
+    uint32_t size, done;        // file size and bytes moved
+    uint32_t crc;               // of the data so far
+    unsigned char trail[4];     // the checksum on the wire
+    size_t toff;
+    char *buf;                  // ACLIENT_CHUNK for streaming
+    size_t blen, boff;
+    char *data;                 // fetch into memory
+    size_t dcap;                // list into memory: allocated
+    int lstate;                 // list: L_START/L_ENTRY/L_STATUS
+    char *text;
+    size_t tlen, tcap;
+    int tend;                   // a NUL closed the text
+};
+
+struct aclient {
+    char host[256];
+    int port;
+    int nconns;
+    struct aconn conns[ACLIENT_MAX_CONNS];
+    struct aop *head, *tail;    // waiting for a connection
+    int outstanding;
+    int running;                // inside run/pump: submissions only queue
+    int epfd;
+};
+
+static void conn_watch(struct aclient *c, struct aconn *k) {
+#ifdef __linux__
+    // edge-triggered: every step runs its socket until EAGAIN
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    ev.data.ptr = k;
+    epoll_ctl(c->epfd, EPOLL_CTL_ADD, k->fd, &ev);
+#else
+    (void)c;
+    (void)k;
+#endif
+}
+
+static int conn_open(struct aclient *c, struct aconn *k) {
+    k->fd = client_connect(c->host, c->port);
+    if(k->fd < 0)
+        return -1;
+    fcntl(k->fd, F_SETFL, fcntl(k->fd, F_GETFL) | O_NONBLOCK);
+    conn_watch(c, k);
+    return 0;
+}
+
+struct aclient *aclient_new(const char *host, int port, int nconns) {
+    struct aclient *c = calloc(1, sizeof(*c));
+    if(!c) return NULL;
+    snprintf(c->host, sizeof(c->host), "%s", host);
+    c->port = port;
+    c->nconns = nconns < 1 ? 1 : nconns > ACLIENT_MAX_CONNS ? ACLIENT_MAX_CONNS : nconns;
+    c->epfd = -1;
+#ifdef __linux__
+    c->epfd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+    int live = 0;
+    for(int i = 0; i < c->nconns; i++) {
+        c->conns[i].fd = -1;
+        c->conns[i].buf = malloc(ACLIENT_CHUNK);
+        if(c->conns[i].buf && conn_open(c, &c->conns[i]) == 0)
+            live++;
+    }
+    if(!live) {
+        aclient_free(c);
+        return NULL;
+    }
+    return c;
+}
+
+void aclient_free(struct aclient *c) {
+    if(!c) return;
+    for(int i = 0; i < c->nconns; i++) {
+        struct aconn *k = &c->conns[i];
+        if(k->fd >= 0) close(k->fd);
+        free(k->buf);
+        free(k->data);
+        free(k->text);
+        free(k->op);
+    }
+    while(c->head) {
+        struct aop *op = c->head;
+        c->head = op->next;
+        free(op);
+    }
+    if(c->epfd >= 0) close(c->epfd);
+    free(c);
+}
+
+int aclient_fd(struct aclient *c) {
+    return c->epfd;
+}
+
+/* finishing an operation */
+
+static void conn_finish(struct aclient *c, struct aconn *k, int status) {
+    struct aop *op = k->op;
+    struct aclient_result res;
+    res.status = status;
+    res.text = k->text ? k->text : "";
+    res.data = k->data;
+    res.size = k->done;
+    k->data = NULL;
+    k->op = NULL;
+    k->phase = PH_IDLE;
+    c->outstanding--;
+    if(op->cb)
+        op->cb(op->arg, &res);
+    if(k->text) k->text[0] = '\0';
+    k->tlen = 0;
+    free(op);
+}
+
+// the connection is out of step with S1: fail the operation and drop it
+static void conn_fail(struct aclient *c, struct aconn *k) {
+    close(k->fd);
+    k->fd = -1;
+    free(k->data);
+    k->data = NULL;
+    if(k->op)
+        conn_finish(c, k, -1);
+}
+
+static int text_add(struct aconn *k, const char *p, size_t n) {
+    if(k->tlen + n + 1 > k->tcap) {
+        size_t cap = k->tcap ? k->tcap : 1024;
+        while(cap < k->tlen + n + 1) cap *= 2;
+        char *t = realloc(k->text, cap);
+        if(!t) return -1;
+        k->text = t;
+        k->tcap = cap;
+    }
+    // some replies are sent with a longer length than their text, so a NUL
+    // after the text ends it and what follows is junk; NULs before it are
+    // left over from the previous reply
+    for(size_t i = 0; i < n && !k->tend; i++) {
+        if(p[i]) k->text[k->tlen++] = p[i];
+        else if(k->tlen) k->tend = 1;
+    }
+    k->text[k->tlen] = '\0';
+    return 0;
+}
+
+// entries of a listing, to the descriptor or to memory
+static int list_out(struct aconn *k, const char *p, size_t n) {
+    if(k->op->fd >= 0) {
+        for(size_t w = 0; w < n; ) {
+            ssize_t r = write(k->op->fd, p + w, n - w);
+            if(r <= 0) return -1;
+            w += r;
+        }
+    } else {
+        // kept NUL-terminated for the caller
+        if(k->done + n + 1 > k->dcap) {
+            size_t cap = k->dcap ? k->dcap : 4096;
+            while(cap < k->done + n + 1) cap *= 2;
+            char *d = realloc(k->data, cap);
+            if(!d) return -1;
+            k->data = d;
+            k->dcap = cap;
+        }
+        memcpy(k->data + k->done, p, n);
+        k->data[k->done + n] = '\0';
+    }
+    k->done += n;
+    return 0;
+}
+
+// take in what arrived of a listing: every line starting "~S1/" is an entry
+// and the first that does not is the status line ending it. 1 once that is
+// in, -1 when an entry could not be kept
+static int list_add(struct aconn *k, const char *p, size_t n) {
+    size_t i = 0;
+    while(i < n) {
+        if(k->lstate == L_ENTRY) {
+            const char *nl = memchr(p + i, '\n', n - i);
+            size_t take = nl ? (size_t)(nl - (p + i)) + 1 : n - i;
+            if(list_out(k, p + i, take) < 0) return -1;
+            i += take;
+            if(nl) k->lstate = L_START;
+        } else if(k->lstate == L_START) {
+            // trailing NULs of the previous reply
+            if(k->off == 0 && p[i] == '\0') {
+                i++;
+                continue;
+            }
+            k->head[k->off++] = p[i++];
+            if(k->off < 4 && k->head[k->off - 1] != '\n')
+                continue;
+            if(k->off == 4 && memcmp(k->head, "~S1/", 4) == 0) {
+                if(list_out(k, (char *)k->head, 4) < 0) return -1;
+                k->lstate = L_ENTRY;
+            } else {
+                if(text_add(k, (char *)k->head, k->off) < 0) return -1;
+                k->lstate = L_STATUS;
+            }
+            k->off = 0;
+        } else {
+            if(text_add(k, p + i, n - i) < 0) return -1;
+            i = n;
+        }
+        if(k->lstate == L_STATUS && memchr(k->text, '\n', k->tlen))
+            return 1;
+    }
+    return 0;
+}
+
+static void conn_start(struct aconn *k, struct aop *op) {
+    k->op = op;
+    k->phase = PH_CMD;
+    k->off = 0;
+    k->done = 0;
+    k->size = op->size;
+    k->blen = k->boff = 0;
+    k->crc = 0;
+    k->toff = 0;
+    k->dcap = 0;
+    k->lstate = L_START;
+    k->status = 0;
+    k->tlen = 0;
+    k->tend = 0;
+    if(k->text) k->text[0] = '\0';
+}
+
+/*
+ * Move the connection's operation along until the socket would block or the
+ * operation is done. Returns 1 when the connection became free.
+ */
+static int conn_step(struct aclient *c, struct aconn *k) {
+    char tmp[CLIENT_BUFSIZE];
+    for(;;) {
+        struct aop *op = k->op;
+        ssize_t n;
+        switch(k->phase) {
+        case PH_IDLE:
+            // anything arriving between operations is a reply's trailing NULs
+            while((n = recv(k->fd, tmp, sizeof(tmp), 0)) > 0)
+                ;
+            if(n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                close(k->fd);
+                k->fd = -1;
+            }
+            return 0;
+
+        case PH_CMD: {
+            size_t len = strlen(op->cmd);
+            n = send(k->fd, op->cmd + k->off, len - k->off, MSG_NOSIGNAL);
+            if(n < 0) break;
+            k->off += n;
+            if(k->off < len) continue;
+            k->off = 0;
+            k->phase = op->kind == OP_UPLOAD ? PH_READY : op->kind == OP_FETCH ? PH_HEAD :
+                       op->kind == OP_LIST ? PH_LIST : PH_TEXT;
+            continue;
+        }
+
+        case PH_READY:
+            n = recv(k->fd, k->head + k->off, 5 - k->off, 0);
+            if(n <= 0) break;
+            // trailing NULs of the previous reply
+            while(k->off == 0 && n > 0 && k->head[0] == '\0')
+                memmove(k->head, k->head + 1, --n);
+            k->off += n;
+            if(k->off < 5) continue;
+            if(memcmp(k->head, "READY", 5) != 0) {
+                // refused before READY (bad extension), the reason is the reply
+                if(text_add(k, (char *)k->head, 5) < 0) { conn_fail(c, k); return 1; }
+                k->status = 1;
+                k->phase = PH_TEXT;
+                continue;
+            }
+            {
+                uint32_t net_size = htonl(op->size);
+                memcpy(k->head, &net_size, 4);
+            }
+            // from memory the checksum is known up front; from a descriptor it
+            // is worked out chunk by chunk as the file is read
+            if(op->fd < 0)
+                k->crc = crc32c(0, op->data, op->size);
+            k->off = 0;
+            k->phase = PH_BODY;
+            continue;
+
+        case PH_BODY: {
+            // the size, the data and the checksum leave in the same sends
+            struct iovec iov[3];
+            int iovcnt = 0;
+            size_t dlen = 0;
+            if(k->off < 4) {
+                iov[iovcnt].iov_base = k->head + k->off;
+                iov[iovcnt++].iov_len = 4 - k->off;
+            }
+            if(op->fd >= 0 && k->boff == k->blen && k->done < k->size) {
+                size_t want = k->size - k->done - (k->blen - k->boff);
+                ssize_t r = read(op->fd, k->buf, want < ACLIENT_CHUNK ? want : ACLIENT_CHUNK);
+                if(r <= 0) {
+                    // the file got shorter than announced; S1 is still waiting for it
+                    conn_fail(c, k);
+                    return 1;
+                }
+                k->crc = crc32c(k->crc, k->buf, r);
+                k->blen = r;
+                k->boff = 0;
+            }
+            if(op->fd >= 0 && k->boff < k->blen) {
+                iov[iovcnt].iov_base = k->buf + k->boff;
+                dlen = iov[iovcnt++].iov_len = k->blen - k->boff;
+            } else if(op->fd < 0 && k->done < k->size) {
+                iov[iovcnt].iov_base = (char *)op->data + k->done;
+                dlen = iov[iovcnt++].iov_len = k->size - k->done;
+            }
+            // the checksum is complete once the last of the data has been read
+            if(k->size > 0 && k->toff < 4 && k->done + dlen == k->size) {
+                if(k->toff == 0) {
+                    uint32_t net_crc = htonl(k->crc);
+                    memcpy(k->trail, &net_crc, 4);
+                }
+                iov[iovcnt].iov_base = k->trail + k->toff;
+                iov[iovcnt++].iov_len = 4 - k->toff;
+            }
+            if(iovcnt == 0) {
+                k->phase = PH_TEXT;
+                continue;
+            }
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovcnt;
+            n = sendmsg(k->fd, &msg, MSG_NOSIGNAL);
+            if(n < 0) break;
+            if(k->off < 4) {
+                size_t h = 4 - k->off < (size_t)n ? 4 - k->off : (size_t)n;
+                k->off += h;
+                n -= h;
+            }
+            size_t d = (size_t)n < dlen ? (size_t)n : dlen;
+            k->done += d;
+            if(op->fd >= 0) k->boff += d;
+            k->toff += n - d;
+            continue;
+        }
+
+        case PH_HEAD:
+            n = recv(k->fd, k->head + k->off, 4 - k->off, 0);
+            if(n <= 0) break;
+            k->off += n;
+            if(k->off < 4) continue;
+            // S1 answers a bad request with a text message instead of a size;
+            // four letters as a size would be a file of over 1GB
+            if(isalpha(k->head[0]) && isalpha(k->head[1]) && isalpha(k->head[2]) && isalpha(k->head[3])) {
+                if(text_add(k, (char *)k->head, 4) < 0) { conn_fail(c, k); return 1; }
+                k->status = 1;
+                k->phase = PH_TEXT;
+                continue;
+            }
+            {
+                uint32_t net_size;
+                memcpy(&net_size, k->head, 4);
+                k->size = ntohl(net_size);
+            }
+            if(k->size == 0) {
+                conn_finish(c, k, 1);
+                return 1;
+            }
+            if(op->fd < 0 && !(k->data = malloc(k->size))) {
+                conn_fail(c, k);
+                return 1;
+            }
+            k->phase = PH_DATA;
+            continue;
+
+        case PH_DATA:
+            if(op->fd < 0) {
+                n = recv(k->fd, k->data + k->done, k->size - k->done, 0);
+                if(n > 0) k->crc = crc32c(k->crc, k->data + k->done, n);
+            } else {
+                size_t want = k->size - k->done;
+                n = recv(k->fd, k->buf, want < ACLIENT_CHUNK ? want : ACLIENT_CHUNK, 0);
+                if(n > 0) k->crc = crc32c(k->crc, k->buf, n);
+                for(ssize_t w = 0; n > 0 && w < n; ) {
+                    ssize_t r = write(op->fd, k->buf + w, n - w);
+                    if(r <= 0) { k->status = -1; break; }
+                    w += r;
+                }
+            }
+            if(n <= 0) break;
+            k->done += n;
+            if(k->done < k->size) continue;
+            k->phase = PH_TRAIL;
+            continue;
+
+        case PH_TRAIL:
+            n = recv(k->fd, k->trail + k->toff, 4 - k->toff, 0);
+            if(n <= 0) break;
+            k->toff += n;
+            if(k->toff < 4) continue;
+            {
+                uint32_t net_crc;
+                memcpy(&net_crc, k->trail, 4);
+                if(ntohl(net_crc) != k->crc && k->status == 0)
+                    k->status = 2;
+            }
+            // a local write error still read the whole file, so the
+            // connection is fine but the operation is not
+            conn_finish(c, k, k->status);
+            return 1;
+
+        case PH_LIST: {
+            n = recv(k->fd, k->buf, ACLIENT_CHUNK, 0);
+            if(n <= 0) break;
+            int r = list_add(k, k->buf, n);
+            if(r < 0) k->status = -1;
+            if(r == 0) continue;
+            // a status that is not "-- N files" is S1 turning the command down
+            if(k->status == 0 && strncmp(k->text, "-- ", 3) != 0)
+                k->status = 1;
+            conn_finish(c, k, k->status < 0 ? -1 : k->status);
+            if(r < 0) conn_fail(c, k);
+            return 1;
+        }
+
+        case PH_TEXT:
+            n = recv(k->fd, tmp, sizeof(tmp), 0);
+            if(n > 0) {
+                if(k->tlen < ACLIENT_TEXT_MAX && text_add(k, tmp, n) < 0) { conn_fail(c, k); return 1; }
+                continue;
+            }
+            // replies end in a newline and go out in one piece, so once one
+            // is in and nothing more is waiting the reply is complete
+            if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && k->tlen && memchr(k->text, '\n', k->tlen)) {
+                conn_finish(c, k, k->status);
+                return 1;
+            }
+            if(n == 0 && k->tlen) {
+                conn_finish(c, k, k->status);
+                close(k->fd);
+                k->fd = -1;
+                return 1;
+            }
+            break;
+        }
+        // n <= 0 from the socket call that broke out of the switch
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        conn_fail(c, k);
+        return 1;
+    }
+}
+
+/* hand queued operations to free connections */
+static void pump(struct aclient *c) {
+    int was = c->running;
+    c->running = 1;
+    while(c->head) {
+        struct aconn *k = NULL;
+        for(int i = 0; i < c->nconns && !k; i++)
+            if(c->conns[i].fd >= 0 && c->conns[i].phase == PH_IDLE)
+                k = &c->conns[i];
+        // connections that failed are only reopened when there is work
+        for(int i = 0; i < c->nconns && !k; i++)
+            if(c->conns[i].fd < 0 && c->conns[i].buf && conn_open(c, &c->conns[i]) == 0)
+                k = &c->conns[i];
+        if(!k) {
+            int busy = 0;
+            for(int i = 0; i < c->nconns; i++)
+                busy |= c->conns[i].fd >= 0;
+            if(busy) break;
+            // nothing left to run it on
+            struct aop *op = c->head;
+            c->head = op->next;
+            if(!c->head) c->tail = NULL;
+            struct aconn dead;
+            memset(&dead, 0, sizeof(dead));
+            dead.op = op;
+            conn_finish(c, &dead, -1);
+            continue;
+        }
+        struct aop *op = c->head;
+        c->head = op->next;
+        if(!c->head) c->tail = NULL;
+        op->next = NULL;
+        conn_start(k, op);
+        conn_step(c, k);
+    }
+    c->running = was;
+}
+
+static int submit(struct aclient *c, struct aop *op) {
+    op->next = NULL;
+    if(c->tail) c->tail->next = op;
+    else c->head = op;
+    c->tail = op;
+    c->outstanding++;
+    if(!c->running)
+        pump(c);
+    return 0;
+}
+
+static struct aop *op_new(int kind, int fd, aclient_cb cb, void *arg) {
+    struct aop *op = calloc(1, sizeof(*op));
+    if(!op) return NULL;
+    op->kind = kind;
+    op->fd = fd;
+    op->cb = cb;
+    op->arg = arg;
+    return op;
+}
+
+// any command that is answered with READY and then takes <size><data><crc>
+static int send_body(struct aclient *c, const char *cmdline, const void *data, int fd, uint32_t size,
+                     aclient_cb cb, void *arg) {
+    if(strlen(cmdline) >= CLIENT_BUFSIZE || (fd < 0 && !data && size))
+        return -1;
+    struct aop *op = op_new(OP_UPLOAD, fd, cb, arg);
+    if(!op) return -1;
+    strcpy(op->cmd, cmdline);
+    op->data = data;
+    op->size = size;
+    return submit(c, op);
+}
+
+static int upload(struct aclient *c, const char *name, const char *dest, const void *data, int fd,
+                  uint32_t size, aclient_cb cb, void *arg) {
+    char cmdline[CLIENT_BUFSIZE];
+    if(!name || !dest || strchr(name, ' ') || strchr(dest, ' ') ||
+       snprintf(cmdline, sizeof(cmdline), "uploadf %s %s", name, dest) >= (int)sizeof(cmdline))
+        return -1;
+    return send_body(c, cmdline, data, fd, size, cb, arg);
+}
+
+int aclient_upload(struct aclient *c, const char *name, const char *dest, const void *data, uint32_t size,
+                   aclient_cb cb, void *arg) {
+    return upload(c, name, dest, data, -1, size, cb, arg);
+}
+
+int aclient_upload_fd(struct aclient *c, const char *name, const char *dest, int fd, uint32_t size,
+                      aclient_cb cb, void *arg) {
+    return fd < 0 ? -1 : upload(c, name, dest, NULL, fd, size, cb, arg);
+}
+
+int aclient_send(struct aclient *c, const char *cmdline, const void *data, uint32_t size,
+                 aclient_cb cb, void *arg) {
+    return !cmdline || !*cmdline ? -1 : send_body(c, cmdline, data, -1, size, cb, arg);
+}
+
+static int command(struct aclient *c, int kind, const char *cmdline, int fd, aclient_cb cb, void *arg) {
+    if(!cmdline || !*cmdline || strlen(cmdline) >= CLIENT_BUFSIZE)
+        return -1;
+    struct aop *op = op_new(kind, fd, cb, arg);
+    if(!op) return -1;
+    strcpy(op->cmd, cmdline);
+    return submit(c, op);
+}
+
+int aclient_list(struct aclient *c, const char *cmdline, int fd, aclient_cb cb, void *arg) {
+    return command(c, OP_LIST, cmdline, fd, cb, arg);
+}
+
+int aclient_fetch(struct aclient *c, const char *cmdline, aclient_cb cb, void *arg) {
+    return command(c, OP_FETCH, cmdline, -1, cb, arg);
+}
+
+int aclient_fetch_fd(struct aclient *c, const char *cmdline, int fd, aclient_cb cb, void *arg) {
+    return fd < 0 ? -1 : command(c, OP_FETCH, cmdline, fd, cb, arg);
+}
+
+int aclient_text(struct aclient *c, const char *cmdline, aclient_cb cb, void *arg) {
+    return command(c, OP_TEXT, cmdline, -1, cb, arg);
+}
+
+/* driving it */
+
+#ifdef __linux__
+
+static void wait_ready(struct aclient *c, int timeout_ms) {
+    struct epoll_event evs[ACLIENT_MAX_CONNS];
+    int n = epoll_wait(c->epfd, evs, ACLIENT_MAX_CONNS, timeout_ms);
+    for(int i = 0; i < n; i++) {
+        struct aconn *k = evs[i].data.ptr;
+        if(k->fd >= 0)
+            conn_step(c, k);
+    }
+}
+
+#else
+
+static void wait_ready(struct aclient *c, int timeout_ms) {
+    struct pollfd pfd[ACLIENT_MAX_CONNS];
+    struct aconn *who[ACLIENT_MAX_CONNS];
+    int n = 0;
+    for(int i = 0; i < c->nconns; i++) {
+        struct aconn *k = &c->conns[i];
+        if(k->fd < 0) continue;
+        pfd[n].fd = k->fd;
+        pfd[n].events = POLLIN | (k->phase == PH_CMD || k->phase == PH_BODY ? POLLOUT : 0);
+        who[n++] = k;
+    }
+    if(poll(pfd, n, timeout_ms) <= 0)
+        return;
+    for(int i = 0; i < n; i++)
+        if(pfd[i].revents && who[i]->fd >= 0)
+            conn_step(c, who[i]);
+}
+
+#endif
+
+int aclient_run(struct aclient *c, int timeout_ms) {
+    c->running = 1;
+    wait_ready(c, c->outstanding ? timeout_ms : 0);
+    c->running = 0;
+    // callbacks may have queued more
+    pump(c);
+    return c->outstanding;
+}
+
+void aclient_wait(struct aclient *c) {
+    while(aclient_run(c, -1) > 0)
+        ;
+}
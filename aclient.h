@@ -0,0 +1,103 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : aclient.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Non-blocking client for S1. Operations are queued and run over
+ *               a pool of connections from one thread, with a callback when
+ *               each completes; the caller drives it with aclient_run() or
+ *               from its own poll/epoll loop through aclient_fd().
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef ACLIENT_H
+#define ACLIENT_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define ACLIENT_MAX_CONNS 64
+#define ACLIENT_CHUNK     (64 * 1024)   // streaming buffer, one per connection
+#define ACLIENT_TEXT_MAX  (1024 * 1024) // longest text reply kept
+
+/*
+ * S1 reads one command at a time from a connection and its replies are not
+ * framed, so a connection carries one operation at a time and concurrency
+ * comes from the pool: operations wait in submission order for a free
+ * connection. A connection that fails is reconnected for the next operation.
+ */
+
+struct aclient;
+
+struct aclient_result {
+    int status;                 // 0 done, 1 refused or no such file, -1 connection failed,
+                                // 2 fetched but the data did not match its checksum
+    const char *text;           // text reply, ack or reason for a refusal ("" if none)
+    char *data;                 // fetched into memory: malloc'd, now the callback's
+    uint32_t size;              // file bytes moved
+};
+
+// called from aclient_run(); may submit further operations
+typedef void (*aclient_cb)(void *arg, const struct aclient_result *res);
+
+// connect nconns connections to S1; NULL if none could be made
+struct aclient *aclient_new(const char *host, int port, int nconns);
+
+// close the connections; operations still queued are dropped without callbacks
+void aclient_free(struct aclient *c);
+
+/*
+ * Submit an operation; 0 when queued, -1 on bad arguments or no memory.
+ * Data and descriptors passed in must stay valid until the callback.
+ */
+
+// uploadf <name> <dest> with the file in memory
+int aclient_upload(struct aclient *c, const char *name, const char *dest, const void *data, uint32_t size,
+                   aclient_cb cb, void *arg);
+
+// the same, reading size bytes from fd as the connection takes them
+int aclient_upload_fd(struct aclient *c, const char *name, const char *dest, int fd, uint32_t size,
+                      aclient_cb cb, void *arg);
+
+// a command that takes a body the way uploadf does (removem with its list):
+// wait for READY, send <size><data><crc>, read the text reply
+int aclient_send(struct aclient *c, const char *cmdline, const void *data, uint32_t size,
+                 aclient_cb cb, void *arg);
+
+// downlf/downltar into memory (res->data)
+int aclient_fetch(struct aclient *c, const char *cmdline, aclient_cb cb, void *arg);
+
+// the same, written to fd as it arrives
+int aclient_fetch_fd(struct aclient *c, const char *cmdline, int fd, aclient_cb cb, void *arg);
+
+/*
+ * dispfnames: the entries are written to fd as they arrive, or with fd -1
+ * collected in res->data (NUL-terminated, res->size bytes); res->text is the
+ * status line that ends the listing ("-- 12 files[, next -c <cursor>]").
+ */
+int aclient_list(struct aclient *c, const char *cmdline, int fd, aclient_cb cb, void *arg);
+
+// removef/removem <pattern>
+int aclient_text(struct aclient *c, const char *cmdline, aclient_cb cb, void *arg);
+
+/*
+ * Wait up to timeout_ms (0 polls, -1 waits) for connections to make
+ * progress and run the callbacks of what completed. Returns the number of
+ * operations still outstanding.
+ */
+int aclient_run(struct aclient *c, int timeout_ms);
+
+// run until nothing is outstanding
+void aclient_wait(struct aclient *c);
+
+/*
+ * A descriptor to add to an outside poll/epoll loop for readability; call
+ * aclient_run(c, 0) when it is ready. On Linux it is an epoll descriptor
+ * covering every connection. -1 where that is not available, and then
+ * aclient_run() has to be called with a timeout.
+ */
+int aclient_fd(struct aclient *c);
+
+#endif
@@ -0,0 +1,704 @@
+/*
+ * Name - 1    : Rajkumar Patel - 110184076
+ * Name - 2    : Vansh Patel    - 110176043
+ * 
+ * Project     : W25_Project - Distributed File System
+ * File        : backend.c
+ * Author      : lord_rajkumar
+ * Co-Author   : vansh7388
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Storage servers S2-S5. Each receives and stores the files of one type
+ *               that are transferred from S1; make builds one binary per server
+ *               from this file with -DBACKEND=<n>.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+
+#include "fcache.h"
+#include "acceptor.h"
+#include "metrics.h"
+#include "trace.h"
+#include "storage.h"
+#include "fdpass.h"
+#include "shmring.h"
+#include "pack.h"
+#include "crc32c.h"
+#include "bloom.h"
+#include "lanes.h"
+#include "tarcache.h"
+
+#define BUFSIZE 1024
+
+// which server this build is: S2 .pdf, S3 .txt, S4 .zip, S5 .c (the .c
+// backend for a stateless S1)
+#ifndef BACKEND
+#define BACKEND 2
+#endif
+#if BACKEND == 2
+#define STORE_NAME  "S2"
+#define STORE_EXT   ".pdf"
+#define STORE_TAR   "pdffiles"
+#elif BACKEND == 3
+#define STORE_NAME  "S3"
+#define STORE_EXT   ".txt"
+#define STORE_TAR   "txtfiles"
+#elif BACKEND == 4
+#define STORE_NAME  "S4"
+#define STORE_EXT   ".zip"
+#define STORE_TAR   "zipfiles"
+#elif BACKEND == 5
+#define STORE_NAME  "S5"
+#define STORE_EXT   ".c"
+#define STORE_TAR   "cfiles"
+#else
+#error "BACKEND must be 2, 3, 4 or 5"
+#endif
+#define STORE_PORT  (9000 + BACKEND)
+
+// root of the store, "./S<n>" unless given on the command line
+char base_dir[256] = "./" STORE_NAME;
+
+// print error
+void error(const char *msg) {
+    perror(msg);
+    exit(1);
+}
+
+// send all bytes, returns how many went
+size_t send_all(int sock, const void *buf, size_t len) {
+    size_t total = 0;
+    const char *p = buf;
+    while(total < len) {
+        ssize_t n = send(sock, p+total, len-total, 0);
+        if(n <= 0) break;
+        total += n;
+    }
+    return total;
+}
+
+// receive all bytes
+ssize_t recv_all(int sock, void *buf, size_t len) {
+    size_t total = 0;
+    char *p = buf;
+    while(total < len) {
+        ssize_t n = recv(sock, p+total, len-total, 0);
+        if(n <= 0) return n;
+        total += n;
+    }
+    return total;
+}
+
+// one lsall line
+static void send_line(void *arg, const char *rel) {
+    char line[1100];
+    int n = snprintf(line, sizeof(line), "%s\n", rel);
+    send_all(*(int *)arg, line, n);
+}
+
+// the lane of a download of size bytes. a bulk one sends its size before it
+// waits, so S1 learns it and gives up its own slot rather than hold it while
+// this one queues; a passed file is sent by S1, which waits for bulk itself.
+// 1 when the size went out
+static int download_lane(int sock, const char *cmd, uint64_t client, off_t size, int pass) {
+    if(lane_of(cmd, size) != LANE_BULK) {
+        lane_enter(lane_of(cmd, size), client, size);
+        return 0;
+    }
+    if(pass)
+        return 0;
+    uint32_t net_filesize = htonl(size);
+    int sized = send_all(sock, &net_filesize, sizeof(net_filesize)) == sizeof(net_filesize);
+    lane_enter(LANE_BULK, client, size);
+    return sized;
+}
+
+// put a stored file in the filter S1 pulls
+static void add_packed(void *arg, const char *rel) {
+    (void)arg;
+    bloom_add(rel);
+}
+
+// put every file stored before this start in the filter
+static void fill_filter(void) {
+    struct store_listing l;
+    memset(&l, 0, sizeof(l));
+    strcpy(l.dir, "~S1");
+    l.recursive = 1;
+    struct store_iter *it = store_iter_open(base_dir, &l);
+    const struct store_file *f;
+    while(it && (f = store_iter_next(it)) != NULL)
+        bloom_add(f->path);
+    store_iter_close(it);
+    pack_each(add_packed, NULL);
+}
+
+// after a handoff, what the old instance's workers stored while it drained:
+// the walk runs in a worker so accepting goes on, then S1 gets the filter
+static void refill_filter(void) {
+    pid_t pid = fork();
+    if(pid > 0) return;
+    if(pid == 0) acceptor_child();
+    fill_filter();
+    bloom_hold(0);
+    if(pid == 0) exit(0);
+}
+
+// the archive downltar sends: the loose files, then the packed ones
+int build_tar(const char *base, const struct timespec *since, const char *tarname) {
+    if(store_tar(base, since, tarname) != 0)
+        return -1;
+    return pack_tar(tarname, since);
+}
+
+// everything the metrics endpoint shows besides the request counters
+void export_server(FILE *out) {
+    lanes_export(out);
+    tarcache_export(out);
+}
+
+// main handler for client
+void prcclient(int sock) {
+    char buffer[BUFSIZE];
+    memset(buffer, 0, BUFSIZE);
+    int n = recv(sock, buffer, BUFSIZE-1, 0);
+    if(n <= 0) { close(sock); return; }
+    buffer[n] = '\0';
+    // S1 puts its client's account, then the request ID in front of the command
+    uint64_t client = lane_accept(buffer, sock);
+    char rid[TRACE_ID_LEN];
+    trace_accept(buffer, rid);
+    
+    char cmd[32];
+    sscanf(buffer, "%s", cmd);
+    metrics_begin(cmd);
+    // health probes and filter pulls would flood the trace
+    if(strcasecmp(cmd, "ping") != 0 && strcasecmp(cmd, "bloom") != 0)
+        trace_begin(cmd, rid);
+    // transfers wait for their lane once their size is known; probes and
+    // filter pulls never wait, the rest waits now
+    if(lane_of(cmd, 0) != LANE_SMALL && strcasecmp(cmd, "ping") != 0 && strcasecmp(cmd, "bloom") != 0)
+        lane_enter(lane_of(cmd, 0), client, 0);
+    
+    // check command
+    char base[256];
+    snprintf(base, sizeof(base), "%s", base_dir);
+    
+    if (strcasecmp(cmd, "storef") == 0) {
+        // expected: storef <destination> <filename> [-n|-s]
+        // -n leaves an existing file alone (used when rebalancing)
+        // -s (S1 over a Unix socket) sends the shared ring with the size and
+        // the data and its checksum through it instead of the socket
+        char dest[256], filename[256], flag[4] = "";
+        if (sscanf(buffer, "%*s %s %s %3s", dest, filename, flag) < 2) {
+            send(sock, "Invalid command syntax\n", 23, 0);
+            close(sock);
+            return;
+        }
+        // send READY to S1
+        send(sock, "READY", 5, 0);
+        long t = trace_now();
+        uint32_t net_filesize;
+        int ring_fds[3] = {-1, -1, -1};
+        int shm = strcmp(flag, "-s") == 0;
+        if ((shm ? fdpass_recvn(sock, &net_filesize, sizeof(net_filesize), ring_fds, 3)
+                 : recv(sock, &net_filesize, sizeof(net_filesize), 0)) != sizeof(net_filesize)) {
+            close(sock);
+            return;
+        }
+        int filesize = ntohl(net_filesize);
+        lane_enter(lane_of(cmd, filesize), client, filesize);
+        // streamed into a temp file and renamed, so cached descriptors keep the old copy intact
+        char filepath[600];
+        int rc;
+        int keep = strcmp(flag, "-n") == 0;
+        uint32_t crc = 0, net_crc = 0;
+        store_path(base, dest, filepath, sizeof(filepath));
+        snprintf(filepath + strlen(filepath), sizeof(filepath) - strlen(filepath), "/%s", filename);
+        // a file stored again is not appended to the cached archive
+        int replaced = pack_exists(filepath) || access(filepath, F_OK) == 0;
+        if (pack_fits(filesize)) {
+            // small files are appended to a segment instead of getting their own inode
+            struct shmring ring;
+            char *data = malloc(filesize ? filesize : 1);
+            int ok = data != NULL;
+            if (shm) {
+                ok = shmring_attach(&ring, ring_fds) == 0 && ok;
+                ring.peer = sock;
+                ok = ring.hdr && shmring_read(&ring, data, filesize) == 0 && ok;
+                ok = ok && (filesize == 0 || shmring_read(&ring, &net_crc, sizeof(net_crc)) == 0);
+                shmring_close(&ring);
+            } else {
+                ok = data && recv_all(sock, data, filesize) == filesize &&
+                     (filesize == 0 || recv_all(sock, &net_crc, sizeof(net_crc)) == sizeof(net_crc));
+            }
+            if (ok)
+                crc = crc32c(0, data, filesize);
+            if (ok && filesize > 0 && ntohl(net_crc) != crc)
+                rc = 2;
+            else if (ok && keep && replaced)
+                rc = 1;
+            else
+                rc = ok && pack_put(filepath, data, filesize, crc) == 0 ? 0 : -1;
+            free(data);
+        } else if (shm) {
+            // written from the shared pages, so the data is copied once on this side
+            struct shmring ring;
+            char tmppath[620];
+            if (shmring_attach(&ring, ring_fds) < 0) {
+                send(sock, "Error writing file\n", 19, 0);
+                close(sock);
+                return;
+            }
+            ring.peer = sock;
+            int fd = store_create(base, dest, filename, 0, filepath, sizeof(filepath), tmppath, sizeof(tmppath));
+            int ok = shmring_read_fd(&ring, fd, filesize, &crc) == 0 &&
+                     (filesize == 0 || shmring_read(&ring, &net_crc, sizeof(net_crc)) == 0);
+            shmring_close(&ring);
+            int bad = ok && filesize > 0 && ntohl(net_crc) != crc;
+            rc = fd < 0 ? -1 : store_commit(fd, tmppath, filepath, ok && !bad, crc);
+            if (bad) rc = 2;
+        } else {
+            rc = store_recv(base, dest, filename, sock, filesize, keep, filepath, sizeof(filepath));
+        }
+        // a larger file replacing a packed one
+        if (rc == 0 && !pack_fits(filesize))
+            pack_remove(filepath);
+        metrics_bytes(filesize, 0);
+        trace_span("store", t, filepath);
+        if(rc == 0) {
+            fcache_invalidate(filepath);
+            // in S1's next pull, before it can hear of the file any other way
+            bloom_add(filepath + strlen(base));
+            // one more member for the cached archive; a packed file has no path to read
+            char *packed;
+            size_t plen;
+            uint32_t pcrc;
+            if(pack_fits(filesize) && pack_read(filepath, &packed, &plen, &pcrc) == 0) {
+                tarcache_add(base, filepath, packed, plen, replaced);
+                free(packed);
+            } else {
+                tarcache_add(base, filepath, NULL, 0, replaced);
+            }
+            send(sock, "File stored successfully\n", 27, 0);
+        } else if(rc == 1) {
+            send(sock, "File exists\n", 12, 0);
+        } else if(rc == 2) {
+            send(sock, "Checksum mismatch\n", 18, 0);
+        } else {
+            send(sock, "Error writing file\n", 19, 0);
+        }
+    }
+    else if (strcasecmp(cmd, "downlf") == 0) {
+        // expected: downlf <filepath> [-f]
+        // -f (S1 over a Unix socket) passes the open file along with the size
+        // instead of sending the data; S1 sends it to the client itself. the
+        // checksum kept with the file follows either way
+        char filepath_rel[512], flag[4] = "";
+        if(sscanf(buffer, "%*s %s %3s", filepath_rel, flag) < 1) {
+            send(sock, "Invalid command syntax\n", 23, 0);
+            close(sock);
+            return;
+        }
+        char fullpath[600];
+        store_path(base, filepath_rel, fullpath, sizeof(fullpath));
+        long t = trace_now();
+        // packed files are small: the size, the data and the checksum go out in one send
+        char *packed;
+        size_t plen;
+        uint32_t crc;
+        if(pack_read(fullpath, &packed, &plen, &crc) == 0) {
+            lane_enter(lane_of(cmd, plen), client, plen);
+            char *reply = malloc(plen + 8);
+            uint32_t net_filesize = htonl(plen), net_crc = htonl(crc);
+            if(reply) {
+                memcpy(reply, &net_filesize, 4);
+                memcpy(reply + 4, packed, plen);
+                memcpy(reply + 4 + plen, &net_crc, 4);
+                send_all(sock, reply, plen + (plen ? 8 : 4));
+                metrics_bytes(0, plen);
+            }
+            free(reply);
+            free(packed);
+            trace_span("send_packed", t, fullpath);
+            close(sock);
+            return;
+        }
+        // hot files are served straight from the inherited cache entry
+        const struct fcache_entry *ce = fcache_lookup(fullpath);
+        int pass = strcmp(flag, "-f") == 0;
+        if(ce && store_crc(ce->fd, ce->size, &crc) == 0) {
+            int sized = download_lane(sock, cmd, client, ce->size, pass);
+            uint32_t net_filesize = htonl(ce->size), net_crc = htonl(crc);
+            if(pass && fdpass_send(sock, &net_filesize, sizeof(net_filesize), ce->fd) == 0) {
+                if(ce->size > 0) send_all(sock, &net_crc, sizeof(net_crc));
+                trace_span("pass_fd", t, fullpath);
+            }
+            else if(fcache_send(sock, ce->fd, ce->map, ce->size, crc, sized) == 0)
+                metrics_bytes(0, ce->size);
+            trace_span("send_cached", t, fullpath);
+            close(sock);
+            return;
+        }
+        struct stat st;
+        int fd = store_open(base, filepath_rel, &st, fullpath, sizeof(fullpath));
+        trace_span("open", t, fullpath);
+        if(fd < 0 || store_crc(fd, st.st_size, &crc) < 0) {
+            if(fd >= 0) close(fd);
+            send(sock, "ERROR", 5, 0);
+            close(sock);
+            return;
+        }
+        int sized = download_lane(sock, cmd, client, st.st_size, pass);
+        t = trace_now();
+        uint32_t net_filesize = htonl(st.st_size), net_crc = htonl(crc);
+        if(pass && fdpass_send(sock, &net_filesize, sizeof(net_filesize), fd) == 0) {
+            if(st.st_size > 0) send_all(sock, &net_crc, sizeof(net_crc));
+            trace_span("pass_fd", t, fullpath);
+        }
+        else if(fcache_send(sock, fd, NULL, st.st_size, crc, sized) == 0)
+            metrics_bytes(0, st.st_size);
+        trace_span("send", t, fullpath);
+        close(fd);
+        fcache_miss(fullpath);
+    }
+    else if (strcasecmp(cmd, "removef") == 0) {
+        // expected: removef <filepath>
+        char filepath_rel[512];
+        if(sscanf(buffer, "%*s %s", filepath_rel) != 1) {
+            send(sock, "Invalid command syntax\n", 23, 0);
+            close(sock);
+            return;
+        }
+        char fullpath[600];
+        store_path(base, filepath_rel, fullpath, sizeof(fullpath));
+        int packed = pack_remove(fullpath) == 0;
+        if(store_remove(base, filepath_rel, fullpath, sizeof(fullpath)) == 0 || packed) {
+            fcache_invalidate(fullpath);
+            tarcache_removed(base, filepath_rel);
+            send(sock, "File removed successfully\n", 28, 0);
+        }
+        else
+            send(sock, "Error removing file\n", 21, 0);
+    }
+    else if (strcasecmp(cmd, "removem") == 0) {
+        // expected: removem <pattern>, or removem alone followed like storef by
+        // READY and <size><list><crc>, the list one client path per line.
+        // answers with the paths it removed, one per line, and the ones it
+        // could not with a '!' in front
+        char pattern[512] = "";
+        struct pathlist list = {NULL, 0, 0};
+        sscanf(buffer, "%*s %511s", pattern);
+        long t = trace_now();
+        if (pattern[0]) {
+            store_find(base, pattern, &list);
+            pack_find(pattern, &list);
+        } else {
+            send(sock, "READY", 5, 0);
+            uint32_t net_size, net_crc;
+            if (recv_all(sock, &net_size, sizeof(net_size)) != sizeof(net_size)) {
+                close(sock);
+                return;
+            }
+            size_t size = ntohl(net_size);
+            char *text = malloc(size ? size : 1);
+            if (!text || recv_all(sock, text, size) != (ssize_t)size ||
+                (size > 0 && recv_all(sock, &net_crc, sizeof(net_crc)) != sizeof(net_crc))) {
+                free(text);
+                close(sock);
+                return;
+            }
+            if (size > 0 && ntohl(net_crc) != crc32c(0, text, size)) {
+                free(text);
+                send(sock, "Checksum mismatch\n", 18, 0);
+                close(sock);
+                return;
+            }
+            pathlist_split(&list, text, size);
+            free(text);
+        }
+        trace_span("find", t, pattern[0] ? pattern : NULL);
+        t = trace_now();
+        signed char *packed = malloc(list.n ? list.n : 1), *loose = malloc(list.n ? list.n : 1);
+        size_t count = packed && loose ? list.n : 0;
+        if (!packed || !loose)
+            send(sock, "Memory allocation error\n", 24, 0);
+        pack_remove_batch(base, list.v, count, packed);
+        store_remove_batch(base, list.v, count, loose);
+        char out[16384];
+        size_t olen = 0;
+        for (size_t i = 0; i < count; i++) {
+            int gone = packed[i] == 0 || loose[i] == 0;
+            if (!gone && packed[i] != -1 && loose[i] != -1)
+                continue;
+            if (gone) {
+                char fullpath[600];
+                store_path(base, list.v[i], fullpath, sizeof(fullpath));
+                fcache_invalidate(fullpath);
+                tarcache_removed(base, list.v[i]);
+            }
+            if (olen + strlen(list.v[i]) + 2 > sizeof(out)) {
+                send_all(sock, out, olen);
+                olen = 0;
+            }
+            olen += snprintf(out + olen, sizeof(out) - olen, "%s%s\n", gone ? "" : "!", list.v[i]);
+        }
+        send_all(sock, out, olen);
+        trace_span("remove", t, NULL);
+        free(packed);
+        free(loose);
+        pathlist_free(&list);
+    }
+    else if (strcasecmp(cmd, "downltar") == 0) {
+        // expected: downltar <filetype> [since] (STORE_EXT),
+        // since a snapshot token or a time for only what changed from then on
+        char filetype[10], arg[64] = "";
+        struct timespec since;
+        if(sscanf(buffer, "%*s %9s %63s", filetype, arg) < 1) {
+            send(sock, "Invalid command syntax\n", 23, 0);
+            close(sock);
+            return;
+        }
+        if(arg[0] && tarcache_since(arg, &since) < 0) {
+            send(sock, "Invalid snapshot token\n", 23, 0);
+            close(sock);
+            return;
+        }
+        if(strcasecmp(filetype, STORE_EXT) != 0) {
+            send(sock, "Invalid filetype for tar\n", 26, 0);
+            close(sock);
+            return;
+        }
+        // the cached archive when the store has not lost a file since it was built
+        long t = trace_now();
+        off_t body;
+        uint32_t crc;
+        char *manifest;
+        int fd = tarcache_open(base, STORE_TAR, arg[0] ? &since : NULL, &body, &crc, &manifest);
+        trace_span("tar", t, NULL);
+        if(fd < 0) {
+            send(sock, "ERROR creating tar\n", 21, 0);
+            close(sock);
+            return;
+        }
+        t = trace_now();
+        if(tarcache_send(sock, fd, body, crc, manifest) == 0)
+            metrics_bytes(0, body + TARCACHE_END);
+        close(fd);
+        free(manifest);
+        trace_span("send", t, NULL);
+    }
+    else if (strcasecmp(cmd, "dispfnames") == 0) {
+        // expected: dispfnames <pathname> [-r] [-l] [-g glob] [-n count] [-c cursor]
+        // the files in listing order, sent as they are found with the packed
+        // ones merged in, then "--", or "-- more" when the count ran out first
+        struct store_listing l;
+        if (store_listing_parse(buffer, &l) < 0) {
+            send(sock, "Invalid command syntax\n", 23, 0);
+            close(sock);
+            return;
+        }
+        // S1 hangs up once it has its page, which only ends the walk
+        signal(SIGPIPE, SIG_IGN);
+        long t = trace_now();
+        struct store_file *packed;
+        size_t npacked = pack_files(&l, &packed), p = 0;
+        struct store_iter *it = store_iter_open(base, &l);
+        const struct store_file *f = it ? store_iter_next(it) : NULL;
+        char out[16384];
+        size_t olen = 0, sent = 0;
+        long count = 0;
+        int more = 0;
+        while (f || p < npacked) {
+            if (l.limit && count == l.limit) {
+                more = 1;
+                break;
+            }
+            // both are in listing order, take the earlier
+            const struct store_file *next = !f || (p < npacked && store_pathcmp(packed[p].path, f->path) < 0)
+                                            ? &packed[p++] : f;
+            if (olen + 1200 > sizeof(out)) {
+                if (send_all(sock, out, olen) < olen)
+                    break;
+                sent += olen;
+                olen = 0;
+            }
+            olen += store_listing_line(&l, next, out + olen, sizeof(out) - olen);
+            count++;
+            if (next == f)
+                f = store_iter_next(it);
+        }
+        olen += snprintf(out + olen, sizeof(out) - olen, more ? "-- more\n" : "--\n");
+        send_all(sock, out, olen);
+        store_iter_close(it);
+        pack_files_free(packed, npacked);
+        trace_span("list", t, l.dir);
+        metrics_bytes(0, sent + olen);
+    }
+    else if (strcasecmp(cmd, "lsall") == 0) {
+        // expected: lsall
+        // every stored file relative to the base, one per line, used by rebalance
+        FILE *fp = store_lsall(base);
+        if (fp != NULL) {
+            char temp[BUFSIZE];
+            while ((n = fread(temp, 1, sizeof(temp), fp)) > 0)
+                send_all(sock, temp, n);
+            pclose(fp);
+        }
+        pack_each(send_line, &sock);
+    }
+    else if (strcasecmp(cmd, "bloom") == 0) {
+        // expected: bloom <epoch> <seq>, S1 catching up on the filter of
+        // stored paths; the reply is in bloom.h
+        bloom_serve(sock, buffer);
+    }
+    else if (strcasecmp(cmd, "ping") == 0) {
+        // expected: ping, health check from S1
+        send(sock, "PONG\n", 5, 0);
+    }
+    else {
+        send(sock, "Invalid command\n", 16, 0);
+    }
+    close(sock);
+}
+
+int main(int argc, char *argv[]) {
+    int sockfd, newsockfd, portno, acceptor;
+    pid_t pid, acceptors[ACCEPT_MAX];
+    struct sockaddr_in cli_addr;
+    socklen_t clilen;
+    struct acceptor_opts opts;
+    // port and base directory can be overridden: S<n> [-a acceptors] [-b backlog] [-m admin_port] [-t tracefile] [-u socket] [-p packsize] [-l meta,small,bulk] [-H handoffpath] [port [base]]
+    int arg = acceptor_options(argc, argv, &opts);
+    if(arg < 0) {
+        fprintf(stderr, "Usage: %s [-a acceptors] [-b backlog] [-m admin_port] [-t tracefile] [-u socket] [-p packsize] [-l meta,small,bulk] [-H handoffpath] [port [base]]\n", argv[0]);
+        exit(1);
+    }
+    portno = argc > arg ? atoi(argv[arg]) : STORE_PORT;
+    if(argc > arg + 1)
+        snprintf(base_dir, sizeof(base_dir), "%s", argv[arg + 1]);
+    if(metrics_init(STORE_NAME) < 0)
+        error("ERROR mapping metrics");
+    if(trace_open(opts.trace_path, STORE_NAME) < 0)
+        error("ERROR opening trace file");
+    // small files go to segment files under <base>/.pack; ones packed before
+    // are served even when this start has no -p
+    if(pack_open(base_dir, opts.pack_max) < 0)
+        error("ERROR opening pack");
+    // paths stored here, for S1 to answer misses without asking
+    if(bloom_init() < 0)
+        error("ERROR mapping filter");
+    fill_filter();
+    // a child serves one request and exits, so bulk ones can be reniced
+    if(lanes_init(opts.lanes, 1) < 0) {
+        fprintf(stderr, "Bad lane slots %s, want meta,small,bulk\n", opts.lanes);
+        exit(1);
+    }
+    if(tarcache_init(build_tar) < 0)
+        error("ERROR mapping archive cache");
+    // on a restart with -H, serve on the running instance's sockets
+    int predecessor = acceptor_takeover(&opts);
+    // its workers keep storing into its own filter and behind our archive
+    // cache; S1 is asked to wait for this filter until those files are in
+    // it too, and no cached archive is served meanwhile
+    if(predecessor >= 0) {
+        bloom_hold(1);
+        tarcache_hold(1);
+    }
+    // S1 on the same host can connect over a Unix socket instead of TCP
+    int unixfd = opts.unix_path ? acceptor_unix(&opts) : -1;
+    if(opts.unix_path && unixfd < 0)
+        error("ERROR binding Unix socket");
+    sockfd = acceptor_start(portno, &opts, acceptors, &acceptor);
+    if(sockfd < 0)
+         error("ERROR on binding");
+    pid_t admin = acceptor == 0 ? metrics_serve(opts.admin_port, export_server) : 0;
+    int ctlfd = acceptor == 0 ? acceptor_control(&opts) : -1;
+    if(opts.handoff_path && acceptor == 0 && ctlfd < 0)
+        error("ERROR binding handoff socket");
+    // one cache per acceptor; hits are checked against the file when there are
+    // several, or while the old instance's children may still replace files
+    if(fcache_init(FCACHE_SLOTS) < 0)
+        error("ERROR initialising file cache");
+    fcache_validate(opts.count > 1 || predecessor >= 0);
+    // a negative fd is skipped by poll
+    struct pollfd pfd[5] = {{sockfd, POLLIN, 0}, {fcache_fd(), POLLIN, 0}, {unixfd, POLLIN, 0},
+                            {ctlfd, POLLIN, 0}, {predecessor, POLLIN, 0}};
+    while(1) {
+        // with a pack, wake up now and then to see whether it needs compacting
+        int ready = poll(pfd, 5, pack_opened() ? PACK_TICK_MS : -1);
+        if(ready < 0 && errno != EINTR)
+            error("ERROR on poll");
+        // a new instance taking the sockets over, or SIGUSR2
+        int peer = ready > 0 && pfd[3].revents & POLLIN ? acceptor_handoff(ctlfd) : -1;
+        if(peer >= 0 || acceptor_draining()) {
+            if(admin > 0) {
+                kill(admin, SIGTERM);
+                waitpid(admin, NULL, 0);
+            }
+            acceptor_drain(peer, acceptors, acceptor == 0 ? opts.count - 1 : 0);
+        }
+        if(ready > 0 && pfd[4].revents & (POLLIN | POLLHUP)) {
+            // the old instance has drained
+            close(predecessor);
+            pfd[4].fd = -1;
+            fcache_validate(opts.count > 1);
+            if(acceptor == 0) {
+                tarcache_hold(0);
+                refill_filter();
+            }
+        }
+        if(ready < 0)
+            continue;
+        // apply cache updates before forking so children never see a stale entry
+        fcache_pump();
+        pack_refresh();
+        pack_tick();
+        while(waitpid(-1, NULL, WNOHANG) > 0)
+            ;   // reap finished children
+        int lfd = pfd[0].revents & POLLIN ? sockfd : pfd[2].revents & POLLIN ? unixfd : -1;
+        if(lfd < 0)
+            continue;
+        clilen = sizeof(cli_addr);
+        newsockfd = accept(lfd, (struct sockaddr *)&cli_addr, &clilen);
+        if(newsockfd < 0) {
+            // another acceptor sharing the Unix socket took it
+            if(errno == EAGAIN || errno == EINTR) continue;
+            error("ERROR on accept");
+        }
+        pid = fork();
+        if(pid < 0)
+            error("ERROR on fork");
+        if(pid == 0) {
+            acceptor_child();
+            fcache_child();
+            prcclient(newsockfd);
+            lane_leave();
+            metrics_end();
+            trace_end();
+            exit(0);
+        }
+        else {
+            close(newsockfd);
+        }
+    }
+    close(sockfd);
+    return 0;
+}
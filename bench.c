@@ -0,0 +1,398 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : bench.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Microbenchmarks for the transfer primitives in transfer.c over
+ *               loopback TCP and Unix sockets: send_all/recv_all, the BUFSIZE
+ *               copy loops (send_file, relay) and forward_file, plus the shared
+ *               memory ring and the CRC32C every transfer carries. Reports
+ *               GB/s and syscalls per MB moved. Run through "make bench",
+ *               which builds it once per BUFSIZE.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "transfer.h"
+#include "shmring.h"
+#include "crc32c.h"
+
+#define MB (1024L * 1024)
+
+static long total_bytes = 256 * MB;     // moved per case, -s to change
+
+/*
+ * Socket calls are counted by taking over send() and recv() for the whole
+ * program, transfer.c included. File reads done inside stdio are not seen
+ * that way, they come from the read/write syscall counts in /proc/self/io.
+ */
+
+static long sock_calls;
+
+ssize_t send(int fd, const void *buf, size_t len, int flags) {
+    __atomic_add_fetch(&sock_calls, 1, __ATOMIC_RELAXED);
+    return sendto(fd, buf, len, flags, NULL, 0);
+}
+
+ssize_t recv(int fd, void *buf, size_t len, int flags) {
+    __atomic_add_fetch(&sock_calls, 1, __ATOMIC_RELAXED);
+    return recvfrom(fd, buf, len, flags, NULL, NULL);
+}
+
+static long io_calls(void) {
+    FILE *fp = fopen("/proc/self/io", "r");
+    if(!fp) return 0;
+    char line[128];
+    long v, total = 0;
+    while(fgets(line, sizeof(line), fp))
+        if(sscanf(line, "syscr: %ld", &v) == 1 || sscanf(line, "syscw: %ld", &v) == 1)
+            total += v;
+    fclose(fp);
+    return total;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct sample {
+    double t;
+    long calls;
+};
+
+static void start(struct sample *s) {
+    s->calls = sock_calls + io_calls();
+    s->t = now_s();
+}
+
+static void report(const char *name, const char *transport, const char *param, struct sample *s,
+                   long bytes, long ops) {
+    double secs = now_s() - s->t;
+    // reading /proc/self/io is itself a read
+    long calls = sock_calls + io_calls() - s->calls - 1;
+    printf("%-12s %-5s %-14s %8.3f GB/s %10.1f syscalls/MB", name, transport, param,
+           bytes / secs / (1024.0 * MB), calls / ((double)bytes / MB));
+    if(ops)
+        printf(" %10.0f ops/s", ops / secs);
+    printf("\n");
+    fflush(stdout);
+}
+
+/* connected socket pairs */
+
+static int tcp_listener(int *port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if(fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        perror("bench: listen");
+        exit(1);
+    }
+    getsockname(fd, (struct sockaddr *)&addr, &len);
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static int make_pair(const char *transport, int sv[2]) {
+    if(strcmp(transport, "unix") == 0)
+        return socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    int port, lfd = tcp_listener(&port);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    sv[0] = socket(AF_INET, SOCK_STREAM, 0);
+    if(connect(sv[0], (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        return -1;
+    sv[1] = accept(lfd, NULL, NULL);
+    close(lfd);
+    return sv[1] < 0 ? -1 : 0;
+}
+
+/* peers, run on their own thread */
+
+struct peer {
+    int fd;
+    long bytes;
+    size_t chunk;
+    char *buf;
+};
+
+static void *sink(void *arg) {
+    struct peer *p = arg;
+    for(long got = 0; got < p->bytes; ) {
+        size_t want = p->bytes - got < (long)p->chunk ? p->bytes - got : p->chunk;
+        if(recv_all(p->fd, p->buf, want) <= 0) break;
+        got += want;
+    }
+    return NULL;
+}
+
+static void *source(void *arg) {
+    struct peer *p = arg;
+    for(long sent = 0; sent < p->bytes; ) {
+        size_t want = p->bytes - sent < (long)p->chunk ? p->bytes - sent : p->chunk;
+        if(send_all(p->fd, p->buf, want) <= 0) break;
+        sent += want;
+    }
+    return NULL;
+}
+
+/* send_all/recv_all with the caller's chunk size */
+static void bench_stream(const char *transport, size_t chunk) {
+    int sv[2];
+    if(make_pair(transport, sv) < 0) { perror("bench: pair"); return; }
+    char *buf = malloc(chunk), *rbuf = malloc(chunk);
+    memset(buf, 'x', chunk);
+    struct peer rx = { sv[1], total_bytes, chunk, rbuf };
+    struct peer tx = { sv[0], total_bytes, chunk, buf };
+    pthread_t th;
+    struct sample s;
+    char param[32];
+    start(&s);
+    pthread_create(&th, NULL, sink, &rx);
+    source(&tx);
+    pthread_join(th, NULL);
+    snprintf(param, sizeof(param), "chunk=%zuk", chunk / 1024);
+    report("send_all", transport, param, &s, total_bytes, 0);
+    close(sv[0]);
+    close(sv[1]);
+    free(buf);
+    free(rbuf);
+}
+
+/* the same through a shmring, the way uploads reach a shm backend */
+
+struct ring_peer {
+    struct shmring *ring;
+    size_t chunk;
+    char *buf;
+};
+
+static void *ring_sink(void *arg) {
+    struct ring_peer *p = arg;
+    for(long got = 0; got < total_bytes; ) {
+        size_t want = total_bytes - got < (long)p->chunk ? total_bytes - got : p->chunk;
+        if(shmring_read(p->ring, p->buf, want) < 0) break;
+        got += want;
+    }
+    return NULL;
+}
+
+static void bench_ring(size_t chunk) {
+    struct shmring ring;
+    if(shmring_create(&ring, SHMRING_SIZE) < 0) { perror("bench: shmring"); return; }
+    char *buf = malloc(chunk), *rbuf = malloc(chunk);
+    memset(buf, 'x', chunk);
+    struct ring_peer rx = { &ring, chunk, rbuf };
+    pthread_t th;
+    struct sample s;
+    char param[32];
+    start(&s);
+    pthread_create(&th, NULL, ring_sink, &rx);
+    for(long sent = 0; sent < total_bytes; ) {
+        size_t want = total_bytes - sent < (long)chunk ? total_bytes - sent : chunk;
+        if(shmring_write(&ring, buf, want) < 0) break;
+        sent += want;
+    }
+    pthread_join(th, NULL);
+    snprintf(param, sizeof(param), "chunk=%zuk", chunk / 1024);
+    report("shmring", "shm", param, &s, total_bytes, 0);
+    shmring_close(&ring);
+    free(buf);
+    free(rbuf);
+}
+
+/* relay(): S1 passing a backend's reply on to the client */
+static void bench_relay(const char *transport) {
+    int in[2], out[2];
+    if(make_pair(transport, in) < 0 || make_pair(transport, out) < 0) { perror("bench: pair"); return; }
+    size_t chunk = 64 * 1024;
+    char *buf = malloc(chunk), *rbuf = malloc(chunk);
+    memset(buf, 'x', chunk);
+    struct peer tx = { in[0], total_bytes, chunk, buf };
+    struct peer rx = { out[1], total_bytes, chunk, rbuf };
+    pthread_t t1, t2;
+    struct sample s;
+    start(&s);
+    pthread_create(&t1, NULL, source, &tx);
+    pthread_create(&t2, NULL, sink, &rx);
+    long moved = relay(in[1], out[0], total_bytes);
+    pthread_join(t1, NULL);
+    pthread_join(t2, NULL);
+    report("relay", transport, "", &s, moved, 0);
+    close(in[0]); close(in[1]); close(out[0]); close(out[1]);
+    free(buf);
+    free(rbuf);
+}
+
+/* send_file(): S1 serving a local file or a tar */
+static void bench_send_file(const char *transport, long filesize) {
+    char path[] = "/tmp/w25bench.XXXXXX";
+    int fd = mkstemp(path);
+    char block[64 * 1024];
+    memset(block, 'x', sizeof(block));
+    for(long w = 0; w < filesize; w += sizeof(block))
+        (void)!write(fd, block, filesize - w < (long)sizeof(block) ? filesize - w : (long)sizeof(block));
+    close(fd);
+
+    int sv[2];
+    if(make_pair(transport, sv) < 0) { perror("bench: pair"); unlink(path); return; }
+    long rounds = total_bytes / filesize > 0 ? total_bytes / filesize : 1;
+    char *rbuf = malloc(64 * 1024);
+    struct peer rx = { sv[1], rounds * filesize, 64 * 1024, rbuf };
+    pthread_t th;
+    struct sample s;
+    char param[32];
+    start(&s);
+    pthread_create(&th, NULL, sink, &rx);
+    // with the checksum, as S1 sends tars
+    uint32_t crc = 0;
+    for(long r = 0; r < rounds; r++) {
+        FILE *fp = fopen(path, "rb");
+        send_file(fp, sv[0], &crc);
+        fclose(fp);
+    }
+    pthread_join(th, NULL);
+    snprintf(param, sizeof(param), "file=%ldk", filesize / 1024);
+    report("send_file", transport, param, &s, rounds * filesize, rounds);
+    close(sv[0]);
+    close(sv[1]);
+    free(rbuf);
+    unlink(path);
+}
+
+/* forward_file(): one storef round trip per upload, against a stub backend
+ * that answers like S2 but throws the data away */
+
+struct stub {
+    int lfd;
+};
+
+static void *stub_backend(void *arg) {
+    struct stub *st = arg;
+    char cmd[BUFSIZE + 64], *data = malloc(64 * 1024);
+    for(;;) {
+        int fd = accept(st->lfd, NULL, NULL);
+        if(fd < 0) break;
+        uint32_t net_size;
+        if(recv(fd, cmd, sizeof(cmd), 0) <= 0) { close(fd); continue; }
+        send(fd, "READY", 5, 0);
+        if(recv_all(fd, &net_size, sizeof(net_size)) == sizeof(net_size)) {
+            long size = ntohl(net_size);
+            uint32_t crc = 0, net_crc;
+            for(long got = 0; got < size; ) {
+                ssize_t n = recv(fd, data, size - got < 64 * 1024 ? size - got : 64 * 1024, 0);
+                if(n <= 0) break;
+                crc = crc32c(crc, data, n);
+                got += n;
+            }
+            if(size == 0 || (recv_all(fd, &net_crc, sizeof(net_crc)) == sizeof(net_crc) && ntohl(net_crc) == crc))
+                send(fd, "File stored successfully\n", 25, 0);
+            else
+                send(fd, "Checksum mismatch\n", 18, 0);
+        }
+        close(fd);
+    }
+    free(data);
+    return NULL;
+}
+
+static void bench_forward(long filesize) {
+    struct backend b;
+    memset(&b, 0, sizeof(b));
+    strcpy(b.name, "stub");
+    strcpy(b.host, "127.0.0.1");
+    struct stub st;
+    st.lfd = tcp_listener(&b.port);
+    b.addr.sin_family = AF_INET;
+    b.addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    b.addr.sin_port = htons(b.port);
+    long rounds = total_bytes / filesize > 0 ? total_bytes / filesize : 1;
+    char *filebuf = malloc(filesize);
+    memset(filebuf, 'x', filesize);
+    pthread_t th;
+    struct sample s;
+    char param[32];
+    start(&s);
+    pthread_create(&th, NULL, stub_backend, &st);
+    // one connection per upload, so small files are slow: stop after 2s
+    long ok = 0;
+    for(long r = 0; r < rounds && now_s() - s.t < 2; r++)
+        ok += forward_file(&b, "~S1/bench", "f.pdf", filebuf, filesize, crc32c(0, filebuf, filesize)) == 0;
+    snprintf(param, sizeof(param), "file=%ldk", filesize / 1024);
+    report("forward_file", "tcp", param, &s, ok * filesize, ok);
+    shutdown(st.lfd, SHUT_RDWR);    // wakes the stub out of accept()
+    pthread_join(th, NULL);
+    close(st.lfd);
+    free(filebuf);
+}
+
+/* crc32c() on its own, over buffers of each chunk size */
+static void bench_crc(size_t chunk) {
+    size_t span = 64 * MB;              // bigger than the caches, as on a real transfer
+    char *buf = malloc(span);
+    memset(buf, 'x', span);
+    struct sample s;
+    char param[32];
+    uint32_t crc = 0;
+    start(&s);
+    for(long done = 0; done < total_bytes; )
+        for(size_t off = 0; off + chunk <= span && done < total_bytes; off += chunk, done += chunk)
+            crc = crc32c(crc, buf + off, chunk);
+    snprintf(param, sizeof(param), "chunk=%zuk", chunk / 1024);
+    report("crc32c", "cpu", param, &s, total_bytes, 0);
+    free(buf);
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    while((opt = getopt(argc, argv, "s:")) != -1) {
+        if(opt == 's') total_bytes = atol(optarg) * MB;
+        else {
+            fprintf(stderr, "usage %s [-s MB per case]\n", argv[0]);
+            return 1;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+    static const char *transports[] = { "tcp", "unix" };
+    static const size_t chunks[] = { 1024, 4096, 16384, 65536, 262144 };
+    static const long files[] = { 4 * 1024, 64 * 1024, MB, 16 * MB };
+
+    printf("BUFSIZE %d, %ld MB per case, crc32c by %s\n", BUFSIZE, total_bytes / MB, crc32c_impl());
+    for(int t = 0; t < 2; t++)
+        for(size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++)
+            bench_stream(transports[t], chunks[c]);
+    for(size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++)
+        bench_ring(chunks[c]);
+    for(size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++)
+        bench_crc(chunks[c]);
+    for(int t = 0; t < 2; t++)
+        bench_relay(transports[t]);
+    for(int t = 0; t < 2; t++)
+        for(size_t f = 0; f < sizeof(files) / sizeof(files[0]); f++)
+            bench_send_file(transports[t], files[f]);
+    for(size_t f = 0; f < sizeof(files) / sizeof(files[0]); f++)
+        bench_forward(files[f]);
+    return 0;
+}
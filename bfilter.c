@@ -0,0 +1,215 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : bfilter.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : S1's copies of the backends' Bloom filters, kept in shared
+ *               memory so every forked worker can tell a download of a file
+ *               no backend holds from one worth asking about.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "bfilter.h"
+#include "bstat.h"
+
+// slots are claimed by backend name, so they survive a routing table reload
+struct bfilter {
+    char name[32];
+    int used;
+    int valid;                  // the bits cover everything the backend holds
+    uint64_t epoch, seq;        // where the last pull left off
+    int64_t pulled;             // CLOCK_MONOTONIC ms the last good pull started at
+    uint64_t bits[BLOOM_WORDS];
+};
+
+struct bfilters {
+    unsigned long answered;     // downloads answered from the filters
+    struct bfilter slots[BFILTER_SLOTS];
+};
+
+static struct bfilters *shared;
+
+int bfilter_init(void) {
+    // only the slots of configured backends are ever touched
+    shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(shared == MAP_FAILED) {
+        shared = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static struct bfilter *slot(const struct backend *b) {
+    if(!shared || !b) return NULL;
+    for(int i = 0; i < BFILTER_SLOTS; i++) {
+        struct bfilter *f = &shared->slots[i];
+        int used = __atomic_load_n(&f->used, __ATOMIC_ACQUIRE);
+        if(used == 2 && strcmp(f->name, b->name) == 0)
+            return f;
+        // claim a free slot: 0 -> 1 while the name is written, then 2
+        if(used == 0) {
+            int expected = 0;
+            if(__atomic_compare_exchange_n(&f->used, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                snprintf(f->name, sizeof(f->name), "%s", b->name);
+                __atomic_store_n(&f->used, 2, __ATOMIC_RELEASE);
+                return f;
+            }
+            i--;    // lost the race, look at this slot again
+        }
+    }
+    return NULL;
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+int bfilter_may_have(const struct backend *b, uint64_t hash) {
+    struct bfilter *f = slot(b);
+    if(!f || !__atomic_load_n(&f->valid, __ATOMIC_ACQUIRE) || bloom_test(f->bits, hash))
+        return 1;
+    // another S1 may have stored it since: a copy that is not keeping up is asked past
+    return now_ms() - __atomic_load_n(&f->pulled, __ATOMIC_ACQUIRE) > BFILTER_TRUST_MS;
+}
+
+void bfilter_note(const struct backend *b, uint64_t hash) {
+    struct bfilter *f = slot(b);
+    if(f)
+        bloom_set(f->bits, hash);
+}
+
+void bfilter_answered(void) {
+    if(shared)
+        __atomic_add_fetch(&shared->answered, 1, __ATOMIC_RELAXED);
+}
+
+void bfilter_export(FILE *out) {
+    if(!shared) return;
+    fprintf(out, "# HELP w25_filter_answered_total Downloads answered as missing from the backends' filters.\n"
+                 "# TYPE w25_filter_answered_total counter\n"
+                 "w25_filter_answered_total %lu\n",
+            __atomic_load_n(&shared->answered, __ATOMIC_RELAXED));
+    fprintf(out, "# HELP w25_backend_filter_synced 1 while S1's copy of the backend's filter is trusted.\n"
+                 "# TYPE w25_backend_filter_synced gauge\n");
+    for(int i = 0; i < BFILTER_SLOTS; i++) {
+        struct bfilter *f = &shared->slots[i];
+        if(__atomic_load_n(&f->used, __ATOMIC_ACQUIRE) != 2) continue;
+        fprintf(out, "w25_backend_filter_synced{backend=\"%s\"} %d\n", f->name,
+                __atomic_load_n(&f->valid, __ATOMIC_RELAXED));
+    }
+}
+
+static int recv_all(int sock, void *buf, size_t len) {
+    for(size_t got = 0; got < len; ) {
+        ssize_t n = recv(sock, (char *)buf + got, len - got, 0);
+        if(n <= 0) return -1;
+        got += n;
+    }
+    return 0;
+}
+
+static int recv_line(int sock, char *line, size_t size) {
+    for(size_t k = 0; k + 1 < size; k++) {
+        if(recv(sock, line + k, 1, 0) != 1) return -1;
+        if(line[k] == '\n') {
+            line[k] = '\0';
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * One pull: the additions since the last one, or the whole filter. A whole
+ * filter from the same run of the backend is merged in; from a new run it
+ * replaces the copy, which can lose a note a worker made meanwhile, so the
+ * copy is not trusted again until the pull after, which covers that file.
+ * Returns 0 when caught up, 1 when another pull is needed, -1 on failure.
+ */
+static int pull(const struct backend *b, struct bfilter *f) {
+    int sock = backend_dial(b);
+    if(sock < 0) return -1;
+    struct timeval tv = {BFILTER_TIMEOUT / 1000, BFILTER_TIMEOUT % 1000 * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char line[128], kind[8];
+    unsigned long long epoch, seq;
+    unsigned long n;
+    int len = snprintf(line, sizeof(line), "bloom %llu %llu", (unsigned long long)f->epoch,
+                       (unsigned long long)f->seq);
+    int rc = -1;
+    if(send(sock, line, len, 0) != len || recv_line(sock, line, sizeof(line)) < 0 ||
+       sscanf(line, "BLOOM %llu %llu %7s %lu", &epoch, &seq, kind, &n) != 4) {
+        close(sock);
+        return -1;
+    }
+    uint64_t chunk[4096];
+    if(strcmp(kind, "full") == 0 && n == sizeof(f->bits)) {
+        int fresh = epoch != f->epoch;
+        if(fresh)
+            __atomic_store_n(&f->valid, 0, __ATOMIC_RELEASE);
+        rc = 0;
+        for(size_t w = 0; rc == 0 && w < BLOOM_WORDS; w += 4096) {
+            rc = recv_all(sock, chunk, sizeof(chunk));
+            for(size_t i = 0; rc == 0 && i < 4096; i++) {
+                uint64_t v = le64toh(chunk[i]);
+                if(fresh)
+                    __atomic_store_n(&f->bits[w + i], v, __ATOMIC_RELAXED);
+                else
+                    __atomic_fetch_or(&f->bits[w + i], v, __ATOMIC_RELAXED);
+            }
+        }
+        if(rc == 0 && fresh)
+            rc = 1;
+    } else if(strcmp(kind, "add") == 0 && epoch == f->epoch) {
+        rc = 0;
+        for(unsigned long done = 0; rc == 0 && done < n; ) {
+            size_t take = n - done < 4096 ? n - done : 4096;
+            rc = recv_all(sock, chunk, take * sizeof(*chunk));
+            for(size_t i = 0; rc == 0 && i < take; i++)
+                bloom_set(f->bits, be64toh(chunk[i]));
+            done += take;
+        }
+    }
+    close(sock);
+    if(rc < 0) return -1;
+    f->epoch = epoch;
+    f->seq = seq;
+    return rc;
+}
+
+void bfilter_sync_loop(const struct route_table *rt) {
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    while(1) {
+        for(int i = 0; i < rt->nbackends; i++) {
+            const struct backend *b = &rt->backends[i];
+            struct bfilter *f = slot(b);
+            if(!f) continue;
+            // a backend behind an open circuit is not waited on
+            int64_t started = now_ms();
+            int rc = bstat_cost(b) == (unsigned long)-1 ? -1 : pull(b, f);
+            if(rc == 1)
+                rc = pull(b, f);
+            if(rc == 0)
+                __atomic_store_n(&f->pulled, started, __ATOMIC_RELEASE);
+            __atomic_store_n(&f->valid, rc == 0, __ATOMIC_RELEASE);
+        }
+        usleep(BFILTER_SYNC_MS * 1000);
+    }
+}
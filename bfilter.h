@@ -0,0 +1,60 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : bfilter.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : S1's copies of the backends' Bloom filters, kept in shared
+ *               memory so every forked worker can tell a download of a file
+ *               no backend holds from one worth asking about.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef BFILTER_H
+#define BFILTER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "route.h"
+#include "bloom.h"
+
+#define BFILTER_SLOTS    ROUTE_MAX_BACKENDS
+#define BFILTER_SYNC_MS  100        // how often each backend is asked for what it added
+#define BFILTER_TRUST_MS 500        // a miss is answered from a copy whose pull started this recently
+#define BFILTER_TIMEOUT  1000       // a pull slower than this is given up
+
+/*
+ * A copy is only trusted once it has been pulled whole and caught up, and
+ * not after a pull fails, so a backend that restarted or cannot be reached
+ * is asked as before. Uploads through this S1 are noted in the copy before
+ * the client hears they are stored, so they are never reported missing.
+ *
+ * Files stored any other way (another S1 sharing the backends, rebalance)
+ * only show up with the next pull: until then this S1 can answer a
+ * download of one as missing. That staleness is the price of not asking,
+ * and it is bounded: a miss is only answered from a copy whose last good
+ * pull started within BFILTER_TRUST_MS, past that the backend is asked. The
+ * window is longer than BFILTER_SYNC_MS so a copy stays trusted while the
+ * next round of pulls is in flight.
+ */
+
+// map the copies before the first fork; 0 or -1
+int bfilter_init(void);
+
+// 0 when b's filter says it holds nothing under the key hash, else 1
+int bfilter_may_have(const struct backend *b, uint64_t hash);
+
+// b has just stored a file
+void bfilter_note(const struct backend *b, uint64_t hash);
+
+// count a download answered from the filters alone
+void bfilter_answered(void);
+
+// series for the metrics endpoint
+void bfilter_export(FILE *out);
+
+// pull every backend's filter, runs in its own process until the parent exits
+void bfilter_sync_loop(const struct route_table *rt);
+
+#endif
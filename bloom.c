@@ -0,0 +1,192 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : bloom.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Bloom filter of the paths a storage server holds. The server
+ *               keeps it in shared memory with a log of recent additions, and
+ *               S1 pulls it, then only what was added since, so a download
+ *               of a file no server has is answered without asking them.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include "bloom.h"
+
+/*
+ * Every forked child adds what it stores, so the log is a ring written
+ * without a lock: an addition sets its bits, claims the next seq, then
+ * publishes its hash in that seq's slot seqlock fashion (slot seq cleared,
+ * hash, slot seq set). A pull that finds a slot not yet published stops
+ * there and picks the rest up next time.
+ */
+struct logent {
+    uint64_t seq;                       // seq + 1 once published, 0 while being written
+    uint64_t hash;
+};
+
+struct filter {
+    uint64_t epoch;                     // new for every start of the server
+    uint64_t seq;                       // additions so far
+    int held;                           // not served, see bloom_hold
+    struct logent log[BLOOM_LOG];
+    uint64_t bits[BLOOM_WORDS];
+};
+
+static struct filter *F;
+
+void bloom_key(const char *path, char *key, size_t size) {
+    const char *p = strstr(path, "~S1") ? strstr(path, "~S1") + 3 : path;
+    size_t k = 0;
+    while(*p) {
+        while(*p == '/') p++;
+        size_t len = strcspn(p, "/");
+        if(len == 2 && p[0] == '.' && p[1] == '.') {
+            while(k > 0 && key[--k] != '/')
+                ;   // drop the last component
+        } else if(len > 0 && !(len == 1 && p[0] == '.') && k + 1 + len < size) {
+            key[k++] = '/';
+            memcpy(key + k, p, len);
+            k += len;
+        }
+        p += len;
+    }
+    key[k] = '\0';
+}
+
+// FNV-1a, then the splitmix64 finaliser so both halves are well mixed
+uint64_t bloom_hash(const char *key) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(const unsigned char *p = (const unsigned char *)key; *p; p++)
+        h = (h ^ *p) * 0x100000001b3ULL;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+// the K bits by double hashing; the step is odd, so they are all different
+#define BIT(h, i) (((uint32_t)(h) + (uint64_t)(i) * ((h) >> 32 | 1)) & (BLOOM_BITS - 1))
+
+void bloom_set(uint64_t *bits, uint64_t hash) {
+    for(int i = 0; i < BLOOM_K; i++) {
+        uint64_t b = BIT(hash, i);
+        __atomic_fetch_or(&bits[b / 64], 1ULL << (b % 64), __ATOMIC_RELAXED);
+    }
+}
+
+int bloom_test(const uint64_t *bits, uint64_t hash) {
+    for(int i = 0; i < BLOOM_K; i++) {
+        uint64_t b = BIT(hash, i);
+        if(!(__atomic_load_n(&bits[b / 64], __ATOMIC_RELAXED) & (1ULL << (b % 64))))
+            return 0;
+    }
+    return 1;
+}
+
+int bloom_init(void) {
+    F = mmap(NULL, sizeof(*F), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(F == MAP_FAILED) {
+        F = NULL;
+        return -1;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    F->epoch = ((uint64_t)ts.tv_sec << 32 ^ (uint64_t)ts.tv_nsec ^ (uint64_t)getpid() << 16) | 1;
+    return 0;
+}
+
+void bloom_add(const char *path) {
+    if(!F) return;
+    char key[1024];
+    bloom_key(path, key, sizeof(key));
+    uint64_t h = bloom_hash(key);
+    bloom_set(F->bits, h);
+    // the bits are in before the seq that covers them
+    uint64_t s = __atomic_fetch_add(&F->seq, 1, __ATOMIC_ACQ_REL);
+    struct logent *e = &F->log[s % BLOOM_LOG];
+    __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&e->hash, h, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->seq, s + 1, __ATOMIC_RELEASE);
+}
+
+void bloom_hold(int on) {
+    if(F)
+        __atomic_store_n(&F->held, on, __ATOMIC_RELEASE);
+}
+
+static int send_all(int sock, const void *buf, size_t len) {
+    for(size_t w = 0; w < len; ) {
+        ssize_t n = send(sock, (const char *)buf + w, len - w, 0);
+        if(n <= 0) return -1;
+        w += n;
+    }
+    return 0;
+}
+
+// the additions from seq from on, as far as they are published; how many,
+// with the seq to ask from next time in *upto, or -1 when the log cannot say
+static long collect(uint64_t from, uint64_t now, uint64_t *out, uint64_t *upto) {
+    uint64_t s = from;
+    for(; s < now; s++) {
+        struct logent *e = &F->log[s % BLOOM_LOG];
+        uint64_t a = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+        uint64_t h = __atomic_load_n(&e->hash, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(a != s + 1 || __atomic_load_n(&e->seq, __ATOMIC_RELAXED) != s + 1)
+            break;
+        out[s - from] = htobe64(h);
+    }
+    // one still unpublished after many more were is a writer that died
+    // between the two steps; it would hold everything after it back
+    if(s < now && now - s >= BLOOM_LAG)
+        return -1;
+    *upto = s;
+    return s - from;
+}
+
+int bloom_serve(int sock, const char *cmdline) {
+    if(!F) return -1;
+    if(__atomic_load_n(&F->held, __ATOMIC_ACQUIRE))
+        return send_all(sock, "Filter not ready\n", 17);
+    unsigned long long epoch = 0, from = 0;
+    sscanf(cmdline, "%*s %llu %llu", &epoch, &from);
+    uint64_t now = __atomic_load_n(&F->seq, __ATOMIC_ACQUIRE);
+    char head[96];
+    if(epoch == F->epoch && from <= now && now - from <= BLOOM_LOG - BLOOM_LAG) {
+        uint64_t *adds = malloc((now - from + 1) * sizeof(*adds)), upto;
+        long n = adds ? collect(from, now, adds, &upto) : -1;
+        if(n >= 0) {
+            int len = snprintf(head, sizeof(head), "BLOOM %llu %llu add %ld\n",
+                               (unsigned long long)F->epoch, (unsigned long long)upto, n);
+            int rc = send_all(sock, head, len) == 0 && send_all(sock, adds, n * sizeof(*adds)) == 0 ? 0 : -1;
+            free(adds);
+            return rc;
+        }
+        free(adds);
+    }
+    // the whole filter: every addition before now set its bits before it
+    // took its seq, so all of them are in what is read after it
+    int len = snprintf(head, sizeof(head), "BLOOM %llu %llu full %lu\n",
+                       (unsigned long long)F->epoch, (unsigned long long)now, (unsigned long)sizeof(F->bits));
+    if(send_all(sock, head, len) < 0)
+        return -1;
+    uint64_t chunk[4096];
+    for(size_t w = 0; w < BLOOM_WORDS; w += 4096) {
+        for(size_t i = 0; i < 4096; i++)
+            chunk[i] = htole64(__atomic_load_n(&F->bits[w + i], __ATOMIC_RELAXED));
+        if(send_all(sock, chunk, sizeof(chunk)) < 0)
+            return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : bloom.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Bloom filter of the paths a storage server holds. The server
+ *               keeps it in shared memory with a log of recent additions, and
+ *               S1 pulls it, then only what was added since, so a download
+ *               of a file no server has is answered without asking them.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BLOOM_BITS   (1u << 23)         // 1 MiB: about 2% false positives at a million files
+#define BLOOM_WORDS  (BLOOM_BITS / 64)
+#define BLOOM_K      7                  // bits per path
+#define BLOOM_LOG    8192               // additions kept for incremental pulls
+#define BLOOM_LAG    64                 // an addition still unpublished this many later is taken as lost
+
+/*
+ * Wire format. S1 sends "bloom <epoch> <seq>" with what it last got (0 0 the
+ * first time) and the server answers with one text line and a body:
+ *
+ *   "BLOOM <epoch> <seq> full <bytes>\n" then the filter, 64-bit words little endian
+ *   "BLOOM <epoch> <seq> add <count>\n"  then the hash of each path added, big endian
+ *
+ * A full filter comes when the epoch differs (the server restarted) or the
+ * log no longer reaches back to the seq asked for. Removals leave their bits
+ * set, so a filter only ever errs towards "maybe": a path it says is absent
+ * was never stored there. A filter that is held answers "Filter not ready"
+ * instead, which S1 takes as a failed pull.
+ */
+
+// the filter key of a client path or a path relative to a store: "~S1"
+// stripped and "//", "." and ".." resolved as the filesystem would, "/a/b.pdf"
+void bloom_key(const char *path, char *key, size_t size);
+
+// the hash of a key; the filter's bits for it derive from this alone
+uint64_t bloom_hash(const char *key);
+
+void bloom_set(uint64_t *bits, uint64_t hash);
+int bloom_test(const uint64_t *bits, uint64_t hash);
+
+// storage servers: map the filter before the acceptors fork; 0 or -1
+int bloom_init(void);
+
+// note a stored file, by client path or path relative to the store
+void bloom_add(const char *path);
+
+// while on, the filter is not served: files are being stored that it does
+// not hold yet (an old instance draining after a handoff)
+void bloom_hold(int on);
+
+// answer a "bloom" command; 0 or -1
+int bloom_serve(int sock, const char *cmdline);
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : bstat.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Per-backend statistics and health kept in shared memory so that
+ *               every forked S1 worker sees the latency, load and failures of
+ *               the others' requests.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+
+#include "bstat.h"
+
+#define BSTAT_MAX_FD 4096
+
+static struct bstat *slots;
+
+// which backend each of this worker's open sockets belongs to
+static struct bstat *fd_owner[BSTAT_MAX_FD];
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+// map the table before the first fork so all workers share it
+int bstat_init(void) {
+    slots = mmap(NULL, sizeof(struct bstat) * BSTAT_SLOTS, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(slots == MAP_FAILED) {
+        slots = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+struct bstat *bstat_get(const struct backend *b) {
+    if(!slots || !b) return NULL;
+    for(int i = 0; i < BSTAT_SLOTS; i++) {
+        struct bstat *s = &slots[i];
+        int used = __atomic_load_n(&s->used, __ATOMIC_ACQUIRE);
+        if(used == 2 && strcmp(s->name, b->name) == 0)
+            return s;
+        // claim a free slot: 0 -> 1 while the name is written, then 2
+        if(used == 0) {
+            int expected = 0;
+            if(__atomic_compare_exchange_n(&s->used, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                snprintf(s->name, sizeof(s->name), "%s", b->name);
+                __atomic_store_n(&s->used, 2, __ATOMIC_RELEASE);
+                return s;
+            }
+            i--;    // lost the race, look at this slot again
+        }
+    }
+    return NULL;
+}
+
+void bstat_latency(const struct backend *b, long us) {
+    struct bstat *s = bstat_get(b);
+    if(!s) return;
+    if(us < 0) us = 0;
+    // racy read-modify-write is fine, a lost sample only slows convergence
+    unsigned int old = __atomic_load_n(&s->ewma_us, __ATOMIC_RELAXED);
+    unsigned int now = s->samples ? old - old / 8 + (unsigned int)(us / 8) : (unsigned int)us;
+    __atomic_store_n(&s->ewma_us, now, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s->samples, 1, __ATOMIC_RELAXED);
+}
+
+unsigned int bstat_ewma(const struct backend *b) {
+    struct bstat *s = bstat_get(b);
+    return s ? __atomic_load_n(&s->ewma_us, __ATOMIC_RELAXED) : 0;
+}
+
+int bstat_load(const struct backend *b) {
+    struct bstat *s = bstat_get(b);
+    return s ? __atomic_load_n(&s->inflight, __ATOMIC_RELAXED) : 0;
+}
+
+// expected cost of sending one more request: latency scaled by queue depth,
+// backends behind an open circuit last
+unsigned long bstat_cost(const struct backend *b) {
+    struct bstat *s = bstat_get(b);
+    if(!s) return 0;
+    long long until = __atomic_load_n(&s->open_until_ms, __ATOMIC_ACQUIRE);
+    if(until != 0 && now_ms() < until)
+        return (unsigned long)-1;
+    return (bstat_ewma(b) + 1UL) * (bstat_load(b) + 1UL);
+}
+
+// closed circuit: available. open: rejected until the cooldown ends, then one
+// caller wins the trial request (half-open) and the rest wait another cooldown
+int bstat_available(const struct backend *b) {
+    struct bstat *s = bstat_get(b);
+    if(!s) return 1;
+    long long until = __atomic_load_n(&s->open_until_ms, __ATOMIC_ACQUIRE);
+    if(until == 0) return 1;
+    long long now = now_ms();
+    if(now < until) return 0;
+    return __atomic_compare_exchange_n(&s->open_until_ms, &until, now + BSTAT_COOLDOWN_MS, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+void bstat_success(const struct backend *b) {
+    struct bstat *s = bstat_get(b);
+    if(!s) return;
+    __atomic_store_n(&s->fails, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->open_until_ms, 0, __ATOMIC_RELEASE);
+}
+
+void bstat_failure(const struct backend *b) {
+    struct bstat *s = bstat_get(b);
+    if(!s) return;
+    if(__atomic_add_fetch(&s->fails, 1, __ATOMIC_RELAXED) >= BSTAT_TRIP)
+        __atomic_store_n(&s->open_until_ms, now_ms() + BSTAT_COOLDOWN_MS, __ATOMIC_RELEASE);
+}
+
+int bstat_connect(const struct backend *b) {
+    struct bstat *s = bstat_get(b);
+    if(!bstat_available(b))
+        return -1;      // fast-fail, no connect timeout against a dead backend
+    if(s && __atomic_load_n(&s->inflight, __ATOMIC_RELAXED) >= BSTAT_MAX_INFLIGHT) {
+        fprintf(stderr, "Backend %s overloaded, shedding request\n", b->name);
+        return -1;
+    }
+    int sock = backend_connect(b);
+    if(sock < 0) {
+        bstat_failure(b);
+        return -1;
+    }
+    bstat_success(b);
+    if(s && sock < BSTAT_MAX_FD) {
+        __atomic_add_fetch(&s->inflight, 1, __ATOMIC_RELAXED);
+        fd_owner[sock] = s;
+    }
+    return sock;
+}
+
+void bstat_close(int sock) {
+    if(sock < 0) return;
+    if(sock < BSTAT_MAX_FD && fd_owner[sock]) {
+        __atomic_sub_fetch(&fd_owner[sock]->inflight, 1, __ATOMIC_RELAXED);
+        fd_owner[sock] = NULL;
+    }
+    close(sock);
+}
+
+void bstat_export(FILE *out) {
+    static const struct {
+        const char *name, *type, *help;
+    } series[] = {
+        {"w25_backend_up", "gauge", "1 unless the backend's circuit is open."},
+        {"w25_backend_in_flight", "gauge", "Open connections to the backend from all workers."},
+        {"w25_backend_latency_seconds", "gauge", "Time to first byte, exponentially weighted."},
+        {"w25_backend_probe_failures_total", "counter", "Failed health probes."},
+    };
+    if(!slots) return;
+    long long now = now_ms();
+    for(int k = 0; k < 4; k++) {
+        fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", series[k].name, series[k].help, series[k].name, series[k].type);
+        for(int i = 0; i < BSTAT_SLOTS; i++) {
+            struct bstat *s = &slots[i];
+            if(__atomic_load_n(&s->used, __ATOMIC_ACQUIRE) != 2) continue;
+            long long until = __atomic_load_n(&s->open_until_ms, __ATOMIC_RELAXED);
+            double v = k == 0 ? (until == 0 || now >= until) :
+                       k == 1 ? __atomic_load_n(&s->inflight, __ATOMIC_RELAXED) :
+                       k == 2 ? __atomic_load_n(&s->ewma_us, __ATOMIC_RELAXED) / 1e6 :
+                                __atomic_load_n(&s->probes_failed, __ATOMIC_RELAXED);
+            fprintf(out, "%s{backend=\"%s\"} %g\n", series[k].name, s->name, v);
+        }
+    }
+}
+
+// connect, send "ping" and wait for "PONG"; returns the round trip or -1
+static long probe(const struct backend *b) {
+    long long t0 = now_ms();
+    struct timespec ts0, ts1;
+    clock_gettime(CLOCK_MONOTONIC, &ts0);
+    int sock = backend_dial(b);
+    if(sock < 0) return -1;
+    char buf[16] = "";
+    struct pollfd pfd = {sock, POLLIN, 0};
+    int left = BSTAT_PROBE_TIMEOUT - (int)(now_ms() - t0);
+    int ok = send(sock, "ping", 4, 0) == 4 && left > 0 && poll(&pfd, 1, left) == 1 &&
+             recv(sock, buf, sizeof(buf) - 1, 0) >= 4 && strncmp(buf, "PONG", 4) == 0;
+    close(sock);
+    clock_gettime(CLOCK_MONOTONIC, &ts1);
+    return ok ? (ts1.tv_sec - ts0.tv_sec) * 1000000L + (ts1.tv_nsec - ts0.tv_nsec) / 1000 : -1;
+}
+
+void bstat_probe_loop(const struct route_table *rt) {
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    while(1) {
+        for(int i = 0; i < rt->nbackends; i++) {
+            const struct backend *b = &rt->backends[i];
+            struct bstat *s = bstat_get(b);
+            long us = probe(b);
+            if(!s) continue;
+            // only state changes are logged
+            int was_down = __atomic_load_n(&s->fails, __ATOMIC_RELAXED) >= BSTAT_TRIP;
+            if(us < 0) {
+                __atomic_add_fetch(&s->probes_failed, 1, __ATOMIC_RELAXED);
+                bstat_failure(b);
+                if(!was_down && __atomic_load_n(&s->fails, __ATOMIC_RELAXED) >= BSTAT_TRIP)
+                    fprintf(stderr, "Backend %s (%s) is down\n", b->name, backend_addr(b));
+            } else {
+                __atomic_store_n(&s->probe_us, (unsigned int)us, __ATOMIC_RELAXED);
+                bstat_success(b);
+                if(was_down)
+                    fprintf(stderr, "Backend %s (%s) is up again\n", b->name, backend_addr(b));
+            }
+        }
+        usleep(BSTAT_PROBE_MS * 1000);
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : bstat.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Per-backend statistics and health kept in shared memory so that
+ *               every forked S1 worker sees the latency, load and failures of
+ *               the others' requests.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef BSTAT_H
+#define BSTAT_H
+
+#include <stdio.h>
+#include "route.h"
+
+#define BSTAT_SLOTS         ROUTE_MAX_BACKENDS
+#define BSTAT_TRIP          3       // consecutive failures that open the circuit
+#define BSTAT_COOLDOWN_MS   2000    // how long an open circuit rejects requests
+#define BSTAT_MAX_INFLIGHT  256     // requests per backend before S1 sheds load
+#define BSTAT_PROBE_MS      500     // health probe interval
+#define BSTAT_PROBE_TIMEOUT 300     // probe answer deadline
+
+// slots are claimed by backend name, so they survive a routing table reload
+struct bstat {
+    char name[32];
+    int used;
+    unsigned int ewma_us;       // time to first byte, exponentially weighted (1/8)
+    unsigned long samples;
+    int inflight;               // open connections from all workers
+    int fails;                  // consecutive connect or probe failures
+    long long open_until_ms;    // circuit open until this monotonic time, 0 = closed
+    unsigned int probe_us;      // last successful probe round trip
+    unsigned long probes_failed;
+};
+
+int bstat_init(void);
+struct bstat *bstat_get(const struct backend *b);
+void bstat_latency(const struct backend *b, long us);
+unsigned int bstat_ewma(const struct backend *b);
+int bstat_load(const struct backend *b);
+unsigned long bstat_cost(const struct backend *b);
+
+// circuit breaker
+int bstat_available(const struct backend *b);
+void bstat_success(const struct backend *b);
+void bstat_failure(const struct backend *b);
+
+// connect through the breaker and count the connection as in flight;
+// every socket from bstat_connect must be closed with bstat_close
+int bstat_connect(const struct backend *b);
+void bstat_close(int sock);
+
+// per-backend series for the metrics endpoint
+void bstat_export(FILE *out);
+
+// health prober, runs in its own process until the parent exits
+void bstat_probe_loop(const struct route_table *rt);
+
+#endif
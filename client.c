@@ -0,0 +1,206 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : client.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Client side of the S1 protocol, shared by w25clients and the
+ *               w25load load generator.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "client.h"
+#include "crc32c.h"
+
+int client_connect(const char *host, int port) {
+    struct sockaddr_in serv_addr;
+    struct hostent *server = gethostbyname(host);
+    if (server == NULL) {
+        fprintf(stderr, "ERROR, no such host\n");
+        return -1;
+    }
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        perror("ERROR opening socket");
+        return -1;
+    }
+    memset((char *)&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    memcpy(&serv_addr.sin_addr.s_addr, server->h_addr, server->h_length);
+    serv_addr.sin_port = htons(port);
+    if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
+        perror("ERROR connecting");
+        close(sockfd);
+        return -1;
+    }
+    // the size header and the data go out as separate sends
+    int one = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return sockfd;
+}
+
+/* send_all ensures that all N bytes are sent */
+ssize_t send_all(int sockfd, const void *buf, size_t len) {
+    size_t total = 0;
+    const char *p = buf;
+    while(total < len) {
+        ssize_t n = send(sockfd, p+total, len-total, 0);
+        if(n <= 0) {
+            return n;
+        }
+        total += n;
+    }
+    return total;
+}
+
+/* recv_all ensures that all N bytes are received */
+ssize_t recv_all(int sockfd, void *buf, size_t len) {
+    size_t total = 0;
+    char *p = buf;
+    while(total < len) {
+        ssize_t n = recv(sockfd, p+total, len-total, 0);
+        if(n <= 0) {
+            return n;
+        }
+        total += n;
+    }
+    return total;
+}
+
+static int send_cmd(int sock, const char *cmdline) {
+    size_t len = strlen(cmdline);
+    return send_all(sock, cmdline, len) == (ssize_t)len ? 0 : -1;
+}
+
+// replies to text commands are not framed; S1 sends each in one piece
+// ending in a newline (some with a stray NUL after it), so once a newline is
+// in, whatever else already arrived belongs to the same reply
+static int recv_text(int sock, char *reply, size_t rlen) {
+    size_t used = 0;
+    reply[0] = '\0';
+    while(used + 1 < rlen) {
+        int complete = used > 0 && memchr(reply, '\n', used) != NULL;
+        ssize_t n = recv(sock, reply + used, rlen - used - 1, complete ? MSG_DONTWAIT : 0);
+        if(n <= 0) {
+            if(used) break;
+            return -1;
+        }
+        used += n;
+        reply[used] = '\0';
+    }
+    // a reply longer than the buffer: drop the rest
+    char sink[CLIENT_BUFSIZE];
+    while(used + 1 >= rlen && recv(sock, sink, sizeof(sink), MSG_DONTWAIT) > 0)
+        ;
+    return 0;
+}
+
+int client_upload(int sock, const char *name, const char *dest, const void *data, uint32_t size,
+                  char *reply, size_t rlen) {
+    char buffer[CLIENT_BUFSIZE];
+    snprintf(buffer, sizeof(buffer), "uploadf %s %s", name, dest);
+    if(send_cmd(sock, buffer) < 0)
+        return -1;
+    // Wait for S1 to reply with "READY"
+    memset(buffer, 0, sizeof(buffer));
+    ssize_t n = recv(sock, buffer, 5, 0);
+    if(n <= 0 || strncmp(buffer, "READY", 5) != 0) {
+        // S1 refused before READY (bad extension), the reason is the reply
+        if(n > 0 && reply) {
+            snprintf(reply, rlen, "%s", buffer);
+            recv_text(sock, reply + strlen(reply), rlen - strlen(reply));
+        }
+        return -1;
+    }
+    // Send file size as a 4-byte integer, then the file data and its checksum.
+    uint32_t net_filesize = htonl(size), net_crc = htonl(crc32c(0, data, size));
+    if(send_all(sock, &net_filesize, sizeof(net_filesize)) < (ssize_t)sizeof(net_filesize) ||
+       send_all(sock, data, size) < (ssize_t)size ||
+       (size > 0 && send_all(sock, &net_crc, sizeof(net_crc)) < (ssize_t)sizeof(net_crc)))
+        return -1;
+    // Get server acknowledgment.
+    return recv_text(sock, reply ? reply : buffer, reply ? rlen : sizeof(buffer));
+}
+
+int client_fetch(int sock, const char *cmdline, char **data, uint32_t *size) {
+    *data = NULL;
+    *size = 0;
+    if(send_cmd(sock, cmdline) < 0)
+        return -1;
+    // S1 sends first a 4-byte filesize, then the raw file data.
+    uint32_t net_filesize;
+    if(recv_all(sock, &net_filesize, sizeof(net_filesize)) != sizeof(net_filesize))
+        return -1;
+    // S1 answers a bad request with a text message instead of a size; four
+    // letters as a size would be a file of over 1GB
+    const unsigned char *h = (const unsigned char *)&net_filesize;
+    if(isalpha(h[0]) && isalpha(h[1]) && isalpha(h[2]) && isalpha(h[3])) {
+        char rest[CLIENT_BUFSIZE];
+        recv_text(sock, rest, sizeof(rest));
+        return 1;
+    }
+    uint32_t filesize = ntohl(net_filesize);
+    if(filesize == 0)
+        return 1;
+    char *filebuf = malloc(filesize);
+    if(!filebuf)
+        return -1;
+    uint32_t net_crc;
+    if(recv_all(sock, filebuf, filesize) != (ssize_t)filesize ||
+       recv_all(sock, &net_crc, sizeof(net_crc)) != sizeof(net_crc) ||
+       ntohl(net_crc) != crc32c(0, filebuf, filesize)) {
+        free(filebuf);
+        return -1;
+    }
+    *data = filebuf;
+    *size = filesize;
+    return 0;
+}
+
+int client_text(int sock, const char *cmdline, char *reply, size_t rlen) {
+    if(send_cmd(sock, cmdline) < 0)
+        return -1;
+    return recv_text(sock, reply, rlen);
+}
+
+int client_list(int sock, const char *cmdline, int fd, char *status, size_t slen) {
+    if(send_cmd(sock, cmdline) < 0)
+        return -1;
+    // nothing comes after the status line until the next command, so reading
+    // ahead through a FILE takes nothing that belongs to another reply
+    FILE *in = fdopen(dup(sock), "r");
+    if(!in)
+        return -1;
+    int ch, rc = -1, bol = 1;
+    while((ch = getc(in)) == '\0')
+        ;   // trailing NULs of the previous reply
+    ungetc(ch, in);
+    char line[2048];
+    while(fgets(line, sizeof(line), in)) {
+        size_t len = strlen(line);
+        if(bol && strncmp(line, "~S1/", 4) != 0) {
+            if(status)
+                snprintf(status, slen, "%s", line);
+            rc = strncmp(line, "-- ", 3) == 0 ? 0 : 1;
+            break;
+        }
+        bol = len > 0 && line[len - 1] == '\n';
+        if(fd >= 0 && write(fd, line, len) != (ssize_t)len)
+            fd = -1;
+    }
+    fclose(in);
+    return rc;
+}
@@ -0,0 +1,48 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : client.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Client side of the S1 protocol, shared by w25clients and the
+ *               w25load load generator.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define CLIENT_BUFSIZE 1024
+
+// connect to S1; -1 on failure with a message on stderr
+int client_connect(const char *host, int port);
+
+ssize_t send_all(int sockfd, const void *buf, size_t len);
+ssize_t recv_all(int sockfd, void *buf, size_t len);
+
+/*
+ * Each call sends one command and reads its whole reply. They return 0 on
+ * success and -1 when the connection failed or the server broke protocol,
+ * after which the connection is unusable.
+ */
+
+// uploadf <name> <dest>: wait for READY, send <size><data><crc>, read the ack
+int client_upload(int sock, const char *name, const char *dest, const void *data, uint32_t size,
+                  char *reply, size_t rlen);
+
+// downlf/downltar: *data is malloc'd; returns 1 when the server sent no file,
+// and -1 too when the file did not match its checksum
+int client_fetch(int sock, const char *cmdline, char **data, uint32_t *size);
+
+// dispfnames: the entries go to fd as they arrive (-1 drops them) and the
+// status line ending the listing to status; 1 when S1 turned it down
+int client_list(int sock, const char *cmdline, int fd, char *status, size_t slen);
+
+// removef/removem: text reply, read up to its final newline
+int client_text(int sock, const char *cmdline, char *reply, size_t rlen);
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : crc32c.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : CRC32C (Castagnoli), the checksum carried by every file
+ *               transfer and kept with every stored file. Uses the CPU's
+ *               CRC32C instructions where it has them (SSE4.2 with PCLMULQDQ
+ *               on x86-64, the CRC extension on ARMv8) and a table otherwise.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+// the servers are built without optimisation and this loop has to keep up
+// with memory
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("O2")
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "crc32c.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CRC32C_X86 1
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define CRC32C_ARM 1
+#include <arm_acle.h>
+#endif
+
+#define POLY 0x82f63b78u                // reflected Castagnoli polynomial
+
+// slicing-by-8 tables, for CPUs without the instruction
+static uint32_t table[8][256];
+
+static uint32_t crc_table(uint32_t crc, const unsigned char *p, size_t len) {
+    while(len && ((uintptr_t)p & 7)) {
+        crc = table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+    while(len >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff] ^ table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24] ^
+              table[3][hi & 0xff] ^ table[2][(hi >> 8) & 0xff] ^ table[1][(hi >> 16) & 0xff] ^ table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while(len--)
+        crc = table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef CRC32C_X86
+
+/*
+ * The crc32 instruction takes 3 cycles but can start one every cycle, so the
+ * buffer is cut into three blocks run side by side. The CRCs of the later
+ * blocks start from zero, and the one before each is moved past it by a
+ * carry-less multiply with x^(8*block-33) mod P, folded back to 32 bits by
+ * another crc32 (the 33 makes up for what that and the multiply add).
+ */
+#define LONG_BLOCK  8192
+#define SHORT_BLOCK 256
+
+static uint64_t k_long, k_short;
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t crc_shift(uint32_t crc, uint64_t k) {
+    __m128i prod = _mm_clmulepi64_si128(_mm_cvtsi32_si128(crc), _mm_cvtsi64_si128(k), 0);
+    return _mm_crc32_u64(0, _mm_cvtsi128_si64(prod));
+}
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t crc_triple(uint32_t crc, const unsigned char **pp, size_t block, uint64_t k) {
+    const unsigned char *p = *pp, *end = p + block;
+    uint64_t c0 = crc, c1 = 0, c2 = 0, a, b, c;
+    do {
+        memcpy(&a, p, 8);
+        memcpy(&b, p + block, 8);
+        memcpy(&c, p + 2 * block, 8);
+        c0 = _mm_crc32_u64(c0, a);
+        c1 = _mm_crc32_u64(c1, b);
+        c2 = _mm_crc32_u64(c2, c);
+        p += 8;
+    } while(p < end);
+    *pp = p + 2 * block;
+    crc = crc_shift(c0, k) ^ c1;
+    return crc_shift(crc, k) ^ c2;
+}
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t crc_hw(uint32_t crc, const unsigned char *p, size_t len) {
+    while(len && ((uintptr_t)p & 7)) {
+        crc = _mm_crc32_u8(crc, *p++);
+        len--;
+    }
+    for(; len >= 3 * LONG_BLOCK; len -= 3 * LONG_BLOCK)
+        crc = crc_triple(crc, &p, LONG_BLOCK, k_long);
+    for(; len >= 3 * SHORT_BLOCK; len -= 3 * SHORT_BLOCK)
+        crc = crc_triple(crc, &p, SHORT_BLOCK, k_short);
+    uint64_t c = crc, v;
+    for(; len >= 8; len -= 8, p += 8) {
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = c;
+    while(len--)
+        crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+
+// x^n mod P, reflected
+static uint32_t xpow(size_t n) {
+    uint32_t v = 1u << 31;
+    while(n--)
+        v = v & 1 ? (v >> 1) ^ POLY : v >> 1;
+    return v;
+}
+
+#elif defined(CRC32C_ARM)
+
+static uint32_t crc_hw(uint32_t crc, const unsigned char *p, size_t len) {
+    while(len && ((uintptr_t)p & 7)) {
+        crc = __crc32cb(crc, *p++);
+        len--;
+    }
+    uint64_t v;
+    for(; len >= 8; len -= 8, p += 8) {
+        memcpy(&v, p, 8);
+        crc = __crc32cd(crc, v);
+    }
+    while(len--)
+        crc = __crc32cb(crc, *p++);
+    return crc;
+}
+
+#endif
+
+static uint32_t (*crc_fn)(uint32_t, const unsigned char *, size_t) = crc_table;
+static const char *impl = "table";
+
+__attribute__((constructor))
+static void crc32c_init(void) {
+    for(uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for(int k = 0; k < 8; k++)
+            c = c & 1 ? (c >> 1) ^ POLY : c >> 1;
+        table[0][n] = c;
+    }
+    for(uint32_t n = 0; n < 256; n++)
+        for(int t = 1; t < 8; t++)
+            table[t][n] = table[0][table[t - 1][n] & 0xff] ^ (table[t - 1][n] >> 8);
+#ifdef CRC32C_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul")) {
+        k_long = xpow(8 * LONG_BLOCK - 33);
+        k_short = xpow(8 * SHORT_BLOCK - 33);
+        crc_fn = crc_hw;
+        impl = "sse4.2+pclmul";
+    }
+#elif defined(CRC32C_ARM)
+    crc_fn = crc_hw;
+    impl = "armv8";
+#endif
+}
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len) {
+    return ~crc_fn(~crc, buf, len);
+}
+
+const char *crc32c_impl(void) {
+    return impl;
+}
@@ -0,0 +1,35 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : crc32c.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : CRC32C (Castagnoli), the checksum carried by every file
+ *               transfer and kept with every stored file. Uses the CPU's
+ *               CRC32C instructions where it has them (SSE4.2 with PCLMULQDQ
+ *               on x86-64, the CRC extension on ARMv8) and a table otherwise.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * On the wire every file body that is not empty is followed by the CRC32C of
+ * its data, 4 bytes in network order: <size><data><crc>. That holds for
+ * uploadf, storef, downlf and downltar, on every hop, and the receiver checks
+ * it before it acks or keeps the data. An empty body has no trailer.
+ */
+#define CRC32C_LEN 4
+
+// CRC32C of len bytes following data whose CRC32C was crc; start from 0
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+// which implementation crc32c() runs ("sse4.2+pclmul", "armv8", "table")
+const char *crc32c_impl(void);
+
+#endif
@@ -0,0 +1,262 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : fcache.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : LRU cache of open descriptors (and mmaps for small files) used by
+ *               the storage servers to serve hot files without open/stat.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+
+#include "fcache.h"
+
+#define FCACHE_CHUNK (64 * 1024)
+
+static struct fcache_entry *entries;
+static struct fcache_entry **buckets;
+static struct fcache_entry *lru_head, *lru_tail, *free_list;
+static unsigned int nbuckets;
+static int pipefd[2] = {-1, -1};
+static int validate;
+
+// FNV-1a hash of the path
+static unsigned int hash_path(const char *path) {
+    uint32_t h = 2166136261u;
+    while(*path) {
+        h ^= (unsigned char)*path++;
+        h *= 16777619u;
+    }
+    return h & (nbuckets - 1);
+}
+
+static struct fcache_entry *find(const char *path) {
+    if(!entries) return NULL;
+    struct fcache_entry *e = buckets[hash_path(path)];
+    while(e && strcmp(e->path, path) != 0)
+        e = e->hnext;
+    return e;
+}
+
+static void lru_unlink(struct fcache_entry *e) {
+    if(e->prev) e->prev->next = e->next; else lru_head = e->next;
+    if(e->next) e->next->prev = e->prev; else lru_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void lru_push(struct fcache_entry *e) {
+    e->prev = NULL;
+    e->next = lru_head;
+    if(lru_head) lru_head->prev = e; else lru_tail = e;
+    lru_head = e;
+}
+
+static void drop(struct fcache_entry *e) {
+    struct fcache_entry **pp = &buckets[hash_path(e->path)];
+    while(*pp != e)
+        pp = &(*pp)->hnext;
+    *pp = e->hnext;
+    lru_unlink(e);
+    if(e->map) munmap(e->map, e->size);
+    close(e->fd);
+    e->path[0] = '\0';
+    e->next = free_list;
+    free_list = e;
+}
+
+// open the file and add it to the cache, evicting the least recently used entry
+static void insert(const char *path) {
+    if(find(path)) return;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return;
+    struct stat st;
+    if(fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return;
+    }
+    if(!free_list)
+        drop(lru_tail);
+    struct fcache_entry *e = free_list;
+    free_list = e->next;
+    strncpy(e->path, path, sizeof(e->path) - 1);
+    e->path[sizeof(e->path) - 1] = '\0';
+    e->fd = fd;
+    e->size = st.st_size;
+    e->ino = st.st_ino;
+    e->mtime = st.st_mtim;
+    e->map = NULL;
+    if(st.st_size > 0 && st.st_size <= FCACHE_MMAP_MAX) {
+        void *m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if(m != MAP_FAILED) e->map = m;
+    }
+    unsigned int b = hash_path(e->path);
+    e->hnext = buckets[b];
+    buckets[b] = e;
+    lru_push(e);
+}
+
+int fcache_init(int slots) {
+    if(slots <= 0) slots = FCACHE_SLOTS;
+    nbuckets = 1;
+    while(nbuckets < (unsigned int)slots * 2)
+        nbuckets <<= 1;
+    entries = calloc(slots, sizeof(*entries));
+    buckets = calloc(nbuckets, sizeof(*buckets));
+    if(!entries || !buckets || pipe(pipefd) < 0) {
+        free(entries);
+        free(buckets);
+        entries = NULL;
+        return -1;
+    }
+    for(int i = 0; i < slots; i++) {
+        entries[i].fd = -1;
+        entries[i].next = free_list;
+        free_list = &entries[i];
+    }
+    fcntl(pipefd[0], F_SETFL, O_NONBLOCK);
+    fcntl(pipefd[1], F_SETFL, O_NONBLOCK);
+    fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipefd[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+}
+
+void fcache_validate(int on) {
+    validate = on;
+}
+
+int fcache_fd(void) {
+    return pipefd[0];
+}
+
+// apply queued child messages: "H path" hit, "M path" miss, "I path" invalidate
+void fcache_pump(void) {
+    static char pending[8192];
+    static size_t plen;
+    if(!entries) return;
+    while(1) {
+        ssize_t n = read(pipefd[0], pending + plen, sizeof(pending) - plen - 1);
+        if(n <= 0) break;
+        plen += n;
+        pending[plen] = '\0';
+        char *line = pending, *nl;
+        while((nl = memchr(line, '\n', pending + plen - line)) != NULL) {
+            *nl = '\0';
+            if(nl - line > 2) {
+                struct fcache_entry *e = find(line + 2);
+                if(line[0] == 'H' && e) {
+                    lru_unlink(e);
+                    lru_push(e);
+                } else if(line[0] == 'M') {
+                    insert(line + 2);
+                } else if(line[0] == 'I' && e) {
+                    drop(e);
+                }
+            }
+            line = nl + 1;
+        }
+        plen = pending + plen - line;
+        memmove(pending, line, plen);
+    }
+}
+
+void fcache_child(void) {
+    if(pipefd[0] >= 0) close(pipefd[0]);
+    pipefd[0] = -1;
+}
+
+// post one message to the parent; a full pipe only costs us a cache update
+static void post(char op, const char *path) {
+    char msg[620];
+    if(pipefd[1] < 0) return;
+    int len = snprintf(msg, sizeof(msg), "%c %s\n", op, path);
+    if(len > 0 && len < (int)sizeof(msg))
+        (void)!write(pipefd[1], msg, len);
+}
+
+const struct fcache_entry *fcache_lookup(const char *path) {
+    struct fcache_entry *e = find(path);
+    if(!e) return NULL;
+    struct stat st;
+    // replaced or rewritten behind our back (another acceptor's storef)
+    if(validate && (stat(path, &st) < 0 || st.st_ino != e->ino || st.st_size != e->size ||
+                    st.st_mtim.tv_sec != e->mtime.tv_sec || st.st_mtim.tv_nsec != e->mtime.tv_nsec)) {
+        post('I', path);
+        return NULL;
+    }
+    post('H', path);
+    return e;
+}
+
+void fcache_miss(const char *path) {
+    post('M', path);
+}
+
+void fcache_invalidate(const char *path) {
+    post('I', path);
+}
+
+// send every byte of the vector, picking up after short sends
+static int send_vec(int sock, struct iovec *iov, int cnt) {
+    while(cnt > 0) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = cnt;
+        ssize_t n = sendmsg(sock, &msg, 0);
+        if(n <= 0) return -1;
+        for(; cnt > 0 && (size_t)n >= iov->iov_len; iov++, cnt--)
+            n -= iov->iov_len;
+        if(cnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+int fcache_send(int sock, int fd, void *map, off_t size, uint32_t crc, int sized) {
+    // the size goes out with the first data and the checksum with the last,
+    // so neither is a small send of its own
+    uint32_t net_filesize = htonl(size), net_crc = htonl(crc);
+    struct iovec iov[3] = {{&net_filesize, sized ? 0 : sizeof(net_filesize)}, {NULL, 0}, {NULL, 0}};
+    if(size == 0)
+        return send_vec(sock, iov, 1);
+    if(map) {
+        iov[1].iov_base = map;
+        iov[1].iov_len = size;
+        iov[2].iov_base = &net_crc;
+        iov[2].iov_len = sizeof(net_crc);
+        return send_vec(sock, iov, 3);
+    }
+    // pread keeps the shared file offset untouched for other children
+    char buf[FCACHE_CHUNK];
+    off_t off = 0;
+    while(off < size) {
+        size_t want = size - off < FCACHE_CHUNK ? size - off : FCACHE_CHUNK;
+        ssize_t n = pread(fd, buf, want, off);
+        if(n <= 0) return -1;
+        struct iovec *v = off == 0 ? iov : iov + 1;
+        iov[1].iov_base = buf;
+        iov[1].iov_len = n;
+        off += n;
+        iov[2].iov_base = &net_crc;
+        iov[2].iov_len = off == size ? sizeof(net_crc) : 0;
+        if(send_vec(sock, v, iov + 3 - v) < 0)
+            return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : fcache.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : LRU cache of open descriptors (and mmaps for small files) used by
+ *               the storage servers to serve hot files without open/stat.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef FCACHE_H
+#define FCACHE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define FCACHE_SLOTS     256            // max number of cached files
+#define FCACHE_MMAP_MAX  (64 * 1024)    // files up to this size are also mmapped
+
+/*
+ * The servers fork one child per connection, so the cache lives in the
+ * accepting parent and every child inherits a snapshot of it (descriptors and
+ * mappings survive fork). Children report hits, misses and invalidations back
+ * over a pipe; the parent applies them in fcache_pump() before each accept.
+ *
+ * With several acceptor processes each one has its own cache and only sees
+ * its own children's invalidations, so fcache_validate(1) makes every hit
+ * compare the entry with a stat() of the path first.
+ */
+
+struct fcache_entry {
+    char path[600];
+    int fd;
+    off_t size;
+    ino_t ino;
+    struct timespec mtime;
+    void *map;                          // NULL when file is larger than FCACHE_MMAP_MAX
+    struct fcache_entry *prev, *next;   // lru list, head is most recent
+    struct fcache_entry *hnext;         // hash chain
+};
+
+// parent side
+int fcache_init(int slots);
+int fcache_fd(void);
+void fcache_pump(void);
+void fcache_validate(int on);
+
+// child side
+void fcache_child(void);
+const struct fcache_entry *fcache_lookup(const char *path);
+void fcache_miss(const char *path);
+void fcache_invalidate(const char *path);
+
+// send <size><data><crc> for an open file, from the mapping when there is
+// one; with sized set the size went out already
+int fcache_send(int sock, int fd, void *map, off_t size, uint32_t crc, int sized);
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : fdpass.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Passing open descriptors over Unix sockets (SCM_RIGHTS). A
+ *               backend on the same host hands S1 the file it would have sent,
+ *               and S1 sends it to the client itself with no relay.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#include "fdpass.h"
+
+#ifndef MSG_CMSG_CLOEXEC
+#define MSG_CMSG_CLOEXEC 0
+#endif
+
+int fdpass_sendn(int sock, const void *buf, size_t len, const int *fds, int nfds) {
+    char control[CMSG_SPACE(sizeof(int) * FDPASS_MAX)];
+    struct iovec iov = {(void *)buf, len};
+    struct msghdr msg;
+    if(nfds < 1 || nfds > FDPASS_MAX)
+        return -1;
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    memcpy(CMSG_DATA(cm), fds, sizeof(int) * nfds);
+    ssize_t n = sendmsg(sock, &msg, 0);
+    if(n <= 0)
+        return -1;
+    // the descriptors went with the first byte, the rest is plain data
+    for(size_t sent = n; sent < len; ) {
+        ssize_t k = send(sock, (const char *)buf + sent, len - sent, 0);
+        if(k <= 0) return -1;
+        sent += k;
+    }
+    return 0;
+}
+
+int fdpass_send(int sock, const void *buf, size_t len, int fd) {
+    return fdpass_sendn(sock, buf, len, &fd, 1);
+}
+
+ssize_t fdpass_recvn(int sock, void *buf, size_t len, int *fds, int nfds) {
+    char control[CMSG_SPACE(sizeof(int) * FDPASS_MAX)];
+    struct iovec iov = {buf, len};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    for(int i = 0; i < nfds; i++)
+        fds[i] = -1;
+    ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if(n <= 0)
+        return n;
+    int got = 0;
+    for(struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if(cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+            continue;
+        int k = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for(int i = 0; i < k; i++) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cm) + i * sizeof(int), sizeof(int));
+            // more than the caller asked for: do not leak them
+            if(got < nfds) fds[got++] = fd;
+            else close(fd);
+        }
+    }
+    while((size_t)n < len) {
+        ssize_t k = recv(sock, (char *)buf + n, len - n, 0);
+        if(k <= 0) {
+            for(int i = 0; i < got; i++) {
+                close(fds[i]);
+                fds[i] = -1;
+            }
+            return k;
+        }
+        n += k;
+    }
+    return n;
+}
+
+ssize_t fdpass_recv(int sock, void *buf, size_t len, int *fd) {
+    return fdpass_recvn(sock, buf, len, fd, 1);
+}
+
+int fdpass_sendfile(int sock, int fd, off_t size) {
+    off_t off = 0;
+#ifdef __linux__
+    // the kernel copies page cache to socket, nothing passes through S1
+    while(off < size) {
+        ssize_t n = sendfile(sock, fd, &off, size - off);
+        if(n <= 0) break;
+    }
+    if(off == size)
+        return 0;
+#endif
+    char buf[64 * 1024];
+    while(off < size) {
+        ssize_t n = pread(fd, buf, size - off < (off_t)sizeof(buf) ? size - off : (off_t)sizeof(buf), off);
+        if(n <= 0) return -1;
+        for(ssize_t done = 0; done < n; ) {
+            ssize_t s = send(sock, buf + done, n - done, 0);
+            if(s <= 0) return -1;
+            done += s;
+        }
+        off += n;
+    }
+    return 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : fdpass.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Passing open descriptors over Unix sockets (SCM_RIGHTS). A
+ *               backend on the same host hands S1 the file it would have sent,
+ *               and S1 sends it to the client itself with no relay.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef FDPASS_H
+#define FDPASS_H
+
+#include <sys/types.h>
+
+#define FDPASS_MAX 4                    // descriptors per message
+
+// send len bytes with fd attached to the first of them; -1 if not sent
+int fdpass_send(int sock, const void *buf, size_t len, int fd);
+
+// receive exactly len bytes; *fd is the descriptor that came with them or -1
+ssize_t fdpass_recv(int sock, void *buf, size_t len, int *fd);
+
+// the same with nfds descriptors (at most FDPASS_MAX); fds fills in order,
+// unused slots are -1
+int fdpass_sendn(int sock, const void *buf, size_t len, const int *fds, int nfds);
+ssize_t fdpass_recvn(int sock, void *buf, size_t len, int *fds, int nfds);
+
+// send size bytes of an open file to sock from offset 0, leaving the file
+// offset alone (the descriptor may be shared); 0 when all were sent
+int fdpass_sendfile(int sock, int fd, off_t size);
+
+#endif
@@ -0,0 +1,351 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : lanes.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Admission scheduling shared by all workers of a server: every
+ *               request waits for a slot in the lane of its class (metadata,
+ *               small transfer, bulk), and the waiters of a lane are let in
+ *               by the bytes their clients already moved, so one client with
+ *               a tar or a multi-GB upload cannot hold the others up.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+
+#include "lanes.h"
+
+// not in glibc's headers
+#define IOPRIO_WHO_PROCESS  1
+#define IOPRIO_CLASS_BE     2
+#define IOPRIO_CLASS_SHIFT  13
+
+enum { FREE, WAITING, RUNNING };
+
+struct entry {
+    pid_t pid;
+    int lane;
+    int state;
+    uint64_t tag;               // start tag: where its client's account stood
+};
+
+struct lanestate {
+    int slots, busy, waiting;
+    uint64_t vtime;             // start tag of the last request let in
+    unsigned long granted;
+    unsigned long wait_us;
+};
+
+struct lanes {
+    pthread_mutex_t lock;       // robust: a worker killed holding it does not stop the rest
+    pthread_cond_t cond;        // a waiter was let in
+    struct lanestate lane[LANE_COUNT];
+    struct entry e[LANE_ENTRIES];
+    uint64_t finish[LANE_CLIENTS][LANE_COUNT];
+};
+
+static const char *lane_names[LANE_COUNT] = {"meta", "small", "bulk"};
+
+static struct lanes *S;
+static int renice_bulk;
+
+// this process's request
+static int mine = -1;
+static int saved_ioprio = -1;
+static uint64_t forwarding;     // the account S1 passes on, 0 for none
+
+int lanes_init(const char *spec, int renice) {
+    int slots[LANE_COUNT];
+    if(sscanf(spec ? spec : LANE_SLOTS, "%d,%d,%d", &slots[0], &slots[1], &slots[2]) != 3 ||
+       slots[0] < 1 || slots[1] < 1 || slots[2] < 1)
+        return -1;
+    S = mmap(NULL, sizeof(*S), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(S == MAP_FAILED) {
+        S = NULL;
+        return -1;
+    }
+    pthread_mutexattr_t ma;
+    pthread_mutexattr_init(&ma);
+    pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&ma, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&S->lock, &ma);
+    pthread_mutexattr_destroy(&ma);
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setpshared(&ca, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&S->cond, &ca);
+    pthread_condattr_destroy(&ca);
+    for(int i = 0; i < LANE_COUNT; i++)
+        S->lane[i].slots = slots[i];
+    renice_bulk = renice;
+    return 0;
+}
+
+enum lane lane_of(const char *cmd, long bytes) {
+    if(strcasecmp(cmd, "downltar") == 0)
+        return LANE_BULK;
+    if(strcasecmp(cmd, "uploadf") == 0 || strcasecmp(cmd, "storef") == 0 || strcasecmp(cmd, "downlf") == 0)
+        return bytes > LANE_SMALL_MAX ? LANE_BULK : LANE_SMALL;
+    return LANE_META;
+}
+
+uint64_t lane_client(int sock) {
+    struct sockaddr_storage ss;
+    socklen_t len = sizeof(ss);
+    if(getpeername(sock, (struct sockaddr *)&ss, &len) < 0)
+        return 0;
+    if(ss.ss_family == AF_INET)
+        return ntohl(((struct sockaddr_in *)&ss)->sin_addr.s_addr);
+    if(ss.ss_family == AF_INET6) {
+        uint64_t h[2];
+        memcpy(h, &((struct sockaddr_in6 *)&ss)->sin6_addr, sizeof(h));
+        return h[0] ^ h[1];
+    }
+    struct ucred cred;
+    len = sizeof(cred);
+    if(ss.ss_family == AF_UNIX && getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0)
+        return 1ULL << 32 | cred.uid;
+    return 0;
+}
+
+void lane_forward(uint64_t client) {
+    forwarding = client;
+}
+
+void lane_tag(char *line, size_t size) {
+    if(!forwarding) return;
+    char tag[LANE_TAG_LEN];
+    int n = snprintf(tag, sizeof(tag), "%%%llx ", (unsigned long long)forwarding);
+    size_t len = strlen(line);
+    if(len + n >= size) return;
+    memmove(line + n, line, len + 1);
+    memcpy(line, tag, n);
+}
+
+uint64_t lane_accept(char *buffer, int sock) {
+    char *end;
+    if(buffer[0] == '%') {
+        uint64_t client = strtoull(buffer + 1, &end, 16);
+        if(end > buffer + 1 && *end == ' ') {
+            memmove(buffer, end + 1, strlen(end + 1) + 1);
+            return client;
+        }
+    }
+    return lane_client(sock);
+}
+
+static void lock(void) {
+    if(pthread_mutex_lock(&S->lock) == EOWNERDEAD)
+        pthread_mutex_consistent(&S->lock);
+}
+
+static long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void run(struct entry *e) {
+    struct lanestate *L = &S->lane[e->lane];
+    e->state = RUNNING;
+    L->busy++;
+    if(e->tag > L->vtime)
+        L->vtime = e->tag;
+    L->granted++;
+}
+
+// let in the waiters with the lowest tags while the lane has free slots
+static void dispatch(int lane) {
+    struct lanestate *L = &S->lane[lane];
+    int woke = 0;
+    while(L->busy < L->slots && L->waiting > 0) {
+        struct entry *best = NULL;
+        for(int i = 0; i < LANE_ENTRIES; i++) {
+            struct entry *e = &S->e[i];
+            if(e->state == WAITING && e->lane == lane && (!best || e->tag < best->tag))
+                best = e;
+        }
+        if(!best) {
+            L->waiting = 0;     // out of step after a worker died mid-update
+            break;
+        }
+        L->waiting--;
+        run(best);
+        woke = 1;
+    }
+    if(woke)
+        pthread_cond_broadcast(&S->cond);
+}
+
+// gone, or a zombie its acceptor has not collected yet
+static int dead(pid_t pid) {
+    if(kill(pid, 0) < 0)
+        return errno == ESRCH;
+    char path[64], buf[256];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE *fp = fopen(path, "r");
+    if(!fp) return 0;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[n] = '\0';
+    char *p = strrchr(buf, ')');
+    return p && p[1] == ' ' && p[2] == 'Z';
+}
+
+// free what workers that died without leaving held or waited for
+static void reap(void) {
+    for(int i = 0; i < LANE_ENTRIES; i++) {
+        struct entry *e = &S->e[i];
+        if(e->state == FREE || e->pid == getpid() || !dead(e->pid))
+            continue;
+        if(e->state == RUNNING)
+            S->lane[e->lane].busy--;
+        else
+            S->lane[e->lane].waiting--;
+        e->state = FREE;
+    }
+    for(int l = 0; l < LANE_COUNT; l++)
+        dispatch(l);
+}
+
+static uint64_t *account(uint64_t client, int lane) {
+    return &S->finish[(client * 0x9e3779b97f4a7c15ULL >> 32) % LANE_CLIENTS][lane];
+}
+
+static void lower_priority(void) {
+    saved_ioprio = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT | 7);
+    // without privileges nice only goes up, so only where the process ends with the request
+    if(renice_bulk)
+        setpriority(PRIO_PROCESS, 0, 10);
+}
+
+void lane_enter(enum lane lane, uint64_t client, long bytes) {
+    lane_leave();
+    if(!S) return;
+    lock();
+    struct entry *e = NULL;
+    for(int i = 0; i < LANE_ENTRIES && !e; i++)
+        if(S->e[i].state == FREE)
+            e = &S->e[i];
+    if(!e) {
+        // more requests than entries: let it through rather than turn it away
+        pthread_mutex_unlock(&S->lock);
+        return;
+    }
+    struct lanestate *L = &S->lane[lane];
+    uint64_t *finish = account(client, lane);
+    e->pid = getpid();
+    e->lane = lane;
+    e->tag = *finish > L->vtime ? *finish : L->vtime;
+    *finish = e->tag + (bytes > 0 ? bytes : 0) + LANE_OP_COST;
+    if(L->busy < L->slots && L->waiting == 0)
+        run(e);
+    else {
+        e->state = WAITING;
+        L->waiting++;
+        long long t = now_us();
+        while(e->state == WAITING) {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            ts.tv_nsec += LANE_REAP_MS * 1000000L;
+            ts.tv_sec += ts.tv_nsec / 1000000000L;
+            ts.tv_nsec %= 1000000000L;
+            int rc = pthread_cond_timedwait(&S->cond, &S->lock, &ts);
+            if(rc == EOWNERDEAD)
+                pthread_mutex_consistent(&S->lock);
+            if(rc != 0 && e->state == WAITING)
+                reap();
+        }
+        L->wait_us += now_us() - t;
+    }
+    mine = e - S->e;
+    pthread_mutex_unlock(&S->lock);
+    if(lane == LANE_BULK)
+        lower_priority();
+}
+
+void lane_resize(enum lane lane, uint64_t client, long bytes) {
+    if(!S || mine < 0) return;
+    lock();
+    struct entry *e = &S->e[mine];
+    int moved = 0;
+    if(e->state == RUNNING && e->pid == getpid() && lane != e->lane) {
+        struct lanestate *from = &S->lane[e->lane], *to = &S->lane[lane];
+        moved = 1;
+        from->busy--;
+        dispatch(e->lane);
+        if(to->busy < to->slots && to->waiting == 0) {
+            e->lane = lane;
+            run(e);
+        } else {
+            // holding a slot of the wrong lane would keep out what it is for
+            e->state = FREE;
+            mine = -1;
+        }
+    }
+    *account(client, lane) += bytes > 0 ? bytes : 0;
+    pthread_mutex_unlock(&S->lock);
+    if(moved && lane == LANE_BULK)
+        lower_priority();
+}
+
+void lane_leave(void) {
+    // a request lane_resize let run outside the lanes has no slot but may be reniced
+    if(saved_ioprio >= 0) {
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, saved_ioprio);
+        saved_ioprio = -1;
+    }
+    if(!S || mine < 0) return;
+    lock();
+    struct entry *e = &S->e[mine];
+    mine = -1;
+    // a waiter may have taken it for a dead worker's and freed it
+    if(e->state == RUNNING && e->pid == getpid()) {
+        e->state = FREE;
+        S->lane[e->lane].busy--;
+        dispatch(e->lane);
+    }
+    pthread_mutex_unlock(&S->lock);
+}
+
+void lanes_export(FILE *out) {
+    if(!S) return;
+    static const struct {
+        const char *name, *type, *help;
+    } series[] = {
+        {"w25_lane_slots", "gauge", "Requests of the lane let run at once."},
+        {"w25_lane_busy", "gauge", "Requests of the lane running."},
+        {"w25_lane_waiting", "gauge", "Requests waiting for a slot in the lane."},
+        {"w25_lane_granted_total", "counter", "Requests let into the lane."},
+        {"w25_lane_wait_seconds_total", "counter", "Time requests spent waiting for a slot in the lane."},
+    };
+    for(size_t k = 0; k < sizeof(series) / sizeof(series[0]); k++) {
+        fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", series[k].name, series[k].help, series[k].name, series[k].type);
+        for(int l = 0; l < LANE_COUNT; l++) {
+            struct lanestate *L = &S->lane[l];
+            double v = k == 0 ? L->slots : k == 1 ? __atomic_load_n(&L->busy, __ATOMIC_RELAXED) :
+                       k == 2 ? __atomic_load_n(&L->waiting, __ATOMIC_RELAXED) :
+                       k == 3 ? __atomic_load_n(&L->granted, __ATOMIC_RELAXED) :
+                       __atomic_load_n(&L->wait_us, __ATOMIC_RELAXED) / 1e6;
+            fprintf(out, "%s{lane=\"%s\"} %g\n", series[k].name, lane_names[l], v);
+        }
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : lanes.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Admission scheduling shared by all workers of a server: every
+ *               request waits for a slot in the lane of its class (metadata,
+ *               small transfer, bulk), and the waiters of a lane are let in
+ *               by the bytes their clients already moved, so one client with
+ *               a tar or a multi-GB upload cannot hold the others up.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef LANES_H
+#define LANES_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+enum lane { LANE_META, LANE_SMALL, LANE_BULK, LANE_COUNT };
+
+#define LANE_SMALL_MAX   (1L << 20)     // transfers up to this size take the small lane
+#define LANE_OP_COST     (64L << 10)    // what a request costs its client besides its bytes
+#define LANE_SLOTS       "32,16,2"      // default slots of the meta, small and bulk lanes
+#define LANE_ENTRIES     512            // requests queued or running; past that they are not held
+#define LANE_CLIENTS     256            // per-client accounts, hashed; clients may share one
+#define LANE_REAP_MS     100            // a waiter looks for workers that died holding a slot this often
+#define LANE_TAG_LEN     20             // "%<hex> " in front of a forwarded command
+
+/*
+ * A request holds its slot until the worker calls lane_leave or enters again
+ * for its next command, so the slots of a lane bound how many of its requests
+ * run at once and the lanes never wait on each other. Within a lane requests
+ * are let in start-time fair queueing order: each client's account runs
+ * ahead by the cost of what it was let in for, so a client with many queued
+ * requests gets its share and no more while others wait. Bulk requests also
+ * run at the lowest best-effort I/O priority, and in a process that does one
+ * request and exits, at nice 10 too.
+ */
+
+// map the lanes before the first fork; spec is "meta,small,bulk" slots, NULL
+// for LANE_SLOTS; renice when workers exit after one request; 0 or -1
+int lanes_init(const char *spec, int renice);
+
+// the lane of a command moving bytes of file data
+enum lane lane_of(const char *cmd, long bytes);
+
+// the account of the peer of sock: its IPv4 address, or uid over a Unix socket
+uint64_t lane_client(int sock);
+
+/*
+ * At the backends every request comes from S1, so S1 passes on the account
+ * of the client it serves in front of each command it forwards, "%<hex> ",
+ * ahead of the request ID. lane_forward sets the account for this process's
+ * forwards, lane_tag puts it in front of a command line, and a backend takes
+ * it off with lane_accept, falling back to the peer when there is none.
+ */
+void lane_forward(uint64_t client);
+void lane_tag(char *line, size_t size);
+uint64_t lane_accept(char *buffer, int sock);
+
+// wait for a slot, leaving the one held from the previous request first
+void lane_enter(enum lane lane, uint64_t client, long bytes);
+
+// the size of the request became known after it entered: charge bytes to
+// its client and move it to the lane of that size if a slot there is free,
+// else give up its slot and run outside the lanes. never waits, so it is
+// safe while a backend already holds a slot for it, whose own lanes then
+// bound how many such requests run
+void lane_resize(enum lane lane, uint64_t client, long bytes);
+
+// give the slot back; a no-op without one
+void lane_leave(void);
+
+// series for the metrics endpoint
+void lanes_export(FILE *out);
+
+#endif
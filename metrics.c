@@ -0,0 +1,202 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : metrics.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Per-command request counters, byte counts, in-flight gauges and
+ *               latency histograms shared by all workers of a server, served in
+ *               Prometheus text format on a local admin port.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "metrics.h"
+
+static const char *cmd_names[M_NCMDS] = {
+    "uploadf", "downlf", "removef", "downltar", "dispfnames", "storef", "other"
+};
+
+static struct metrics_shard *shards;
+static char server_name[16];
+
+// the request this worker is serving
+static struct metrics_cmd_stats *cur;
+static struct timespec cur_start;
+
+int metrics_init(const char *server) {
+    snprintf(server_name, sizeof(server_name), "%s", server);
+    shards = mmap(NULL, sizeof(struct metrics_shard) * METRICS_SHARDS, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(shards == MAP_FAILED) {
+        shards = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// log-linear bucket: exact below 2^SUB_BITS, then 2^SUB_BITS per power of two
+static int bucket_of(unsigned long us) {
+    const unsigned long sub = 1UL << METRICS_SUB_BITS;
+    if(us < sub) return (int)us;
+    int p = 63 - __builtin_clzl(us);
+    int b = (p - METRICS_SUB_BITS + 1) * sub + ((us >> (p - METRICS_SUB_BITS)) & (sub - 1));
+    return b < METRICS_BUCKETS ? b : METRICS_BUCKETS - 1;
+}
+
+// exclusive upper bound of a bucket in microseconds
+static unsigned long bucket_limit(int b) {
+    const unsigned long sub = 1UL << METRICS_SUB_BITS;
+    if(b < (int)sub) return b + 1;
+    int p = b / sub + METRICS_SUB_BITS - 1;
+    return ((sub + b % sub) << (p - METRICS_SUB_BITS)) + (1UL << (p - METRICS_SUB_BITS));
+}
+
+void metrics_begin(const char *cmd) {
+    if(!shards) return;
+    metrics_end();
+    int id = M_OTHER;
+    for(int i = 0; i < M_OTHER; i++)
+        if(strcasecmp(cmd, cmd_names[i]) == 0)
+            id = i;
+    cur = &shards[getpid() % METRICS_SHARDS].cmd[id];
+    __atomic_add_fetch(&cur->started, 1, __ATOMIC_RELAXED);
+    clock_gettime(CLOCK_MONOTONIC, &cur_start);
+}
+
+void metrics_bytes(unsigned long in, unsigned long out) {
+    if(!cur) return;
+    if(in) __atomic_add_fetch(&cur->bytes_in, in, __ATOMIC_RELAXED);
+    if(out) __atomic_add_fetch(&cur->bytes_out, out, __ATOMIC_RELAXED);
+}
+
+void metrics_end(void) {
+    if(!cur) return;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long us = (now.tv_sec - cur_start.tv_sec) * 1000000L + (now.tv_nsec - cur_start.tv_nsec) / 1000;
+    if(us < 0) us = 0;
+    __atomic_add_fetch(&cur->hist[bucket_of(us)], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&cur->sum_us, us, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&cur->count, 1, __ATOMIC_RELEASE);
+    cur = NULL;
+}
+
+#define LOAD(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+
+static void write_metrics(FILE *out, void (*extra)(FILE *out)) {
+    struct metrics_cmd_stats total[M_NCMDS];
+    memset(total, 0, sizeof(total));
+    for(int s = 0; s < METRICS_SHARDS; s++) {
+        for(int c = 0; c < M_NCMDS; c++) {
+            struct metrics_cmd_stats *src = &shards[s].cmd[c], *t = &total[c];
+            t->count += __atomic_load_n(&src->count, __ATOMIC_ACQUIRE);
+            t->started += LOAD(src->started);
+            t->bytes_in += LOAD(src->bytes_in);
+            t->bytes_out += LOAD(src->bytes_out);
+            t->sum_us += LOAD(src->sum_us);
+            for(int b = 0; b < METRICS_BUCKETS; b++)
+                t->hist[b] += LOAD(src->hist[b]);
+        }
+    }
+
+    fprintf(out, "# HELP w25_requests_total Requests handled, by command.\n# TYPE w25_requests_total counter\n");
+    for(int c = 0; c < M_NCMDS; c++)
+        fprintf(out, "w25_requests_total{server=\"%s\",cmd=\"%s\"} %lu\n", server_name, cmd_names[c], total[c].count);
+    fprintf(out, "# HELP w25_requests_in_flight Requests being served.\n# TYPE w25_requests_in_flight gauge\n");
+    for(int c = 0; c < M_NCMDS; c++) {
+        // count is read first, so a request finishing meanwhile cannot go negative
+        long inflight = (long)(total[c].started - total[c].count);
+        fprintf(out, "w25_requests_in_flight{server=\"%s\",cmd=\"%s\"} %ld\n", server_name, cmd_names[c],
+                inflight > 0 ? inflight : 0);
+    }
+    fprintf(out, "# HELP w25_received_bytes_total File payload received.\n# TYPE w25_received_bytes_total counter\n");
+    for(int c = 0; c < M_NCMDS; c++)
+        fprintf(out, "w25_received_bytes_total{server=\"%s\",cmd=\"%s\"} %lu\n", server_name, cmd_names[c], total[c].bytes_in);
+    fprintf(out, "# HELP w25_sent_bytes_total File payload sent.\n# TYPE w25_sent_bytes_total counter\n");
+    for(int c = 0; c < M_NCMDS; c++)
+        fprintf(out, "w25_sent_bytes_total{server=\"%s\",cmd=\"%s\"} %lu\n", server_name, cmd_names[c], total[c].bytes_out);
+
+    fprintf(out, "# HELP w25_request_duration_seconds Time from command to reply.\n"
+                 "# TYPE w25_request_duration_seconds histogram\n");
+    for(int c = 0; c < M_NCMDS; c++) {
+        // the buckets may be summed while requests finish, keep them consistent with _count
+        unsigned long cum = 0, hist_total = 0;
+        for(int b = 0; b < METRICS_BUCKETS; b++)
+            hist_total += total[c].hist[b];
+        if(hist_total == 0) continue;
+        for(int b = 0; b < METRICS_BUCKETS - 1; b++) {
+            cum += total[c].hist[b];
+            fprintf(out, "w25_request_duration_seconds_bucket{server=\"%s\",cmd=\"%s\",le=\"%g\"} %lu\n",
+                    server_name, cmd_names[c], bucket_limit(b) / 1e6, cum);
+        }
+        fprintf(out, "w25_request_duration_seconds_bucket{server=\"%s\",cmd=\"%s\",le=\"+Inf\"} %lu\n",
+                server_name, cmd_names[c], hist_total);
+        fprintf(out, "w25_request_duration_seconds_sum{server=\"%s\",cmd=\"%s\"} %.6f\n",
+                server_name, cmd_names[c], total[c].sum_us / 1e6);
+        fprintf(out, "w25_request_duration_seconds_count{server=\"%s\",cmd=\"%s\"} %lu\n",
+                server_name, cmd_names[c], hist_total);
+    }
+    if(extra)
+        extra(out);
+}
+
+pid_t metrics_serve(int port, void (*extra)(FILE *out)) {
+    if(!shards || port <= 0) return 0;
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if(sockfd < 0) return -1;
+    int one = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if(bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sockfd, 16) < 0) {
+        perror("ERROR binding metrics port");
+        close(sockfd);
+        return -1;
+    }
+    pid_t pid = fork();
+    if(pid != 0) {
+        close(sockfd);
+        return pid;
+    }
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+    signal(SIGPIPE, SIG_IGN);
+    // one scrape at a time is plenty, answer any request with the metrics
+    while(1) {
+        int c = accept(sockfd, NULL, NULL);
+        if(c < 0) continue;
+        char req[1024];
+        struct timeval tv = {1, 0};
+        setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        (void)!recv(c, req, sizeof(req), 0);
+        FILE *out = fdopen(c, "w");
+        if(!out) {
+            close(c);
+            continue;
+        }
+        fprintf(out, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n");
+        write_metrics(out, extra);
+        fclose(out);
+    }
+}
@@ -0,0 +1,59 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : metrics.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Per-command request counters, byte counts, in-flight gauges and
+ *               latency histograms shared by all workers of a server, served in
+ *               Prometheus text format on a local admin port.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#define METRICS_SHARDS      16      // workers add to shard pid % METRICS_SHARDS
+#define METRICS_SUB_BITS    2       // histogram: 4 linear sub-buckets per power of two
+#define METRICS_BUCKETS     100     // 1us resolution up to ~67s, the last bucket takes the rest
+
+enum metrics_cmd {
+    M_UPLOADF, M_DOWNLF, M_REMOVEF, M_DOWNLTAR, M_DISPFNAMES, M_STOREF, M_OTHER, M_NCMDS
+};
+
+// one shard per group of workers so they do not share cache lines
+struct metrics_cmd_stats {
+    unsigned long started;
+    unsigned long count;            // finished; started - count are in flight
+    unsigned long bytes_in;
+    unsigned long bytes_out;
+    unsigned long sum_us;
+    unsigned long hist[METRICS_BUCKETS];
+};
+
+struct metrics_shard {
+    struct metrics_cmd_stats cmd[M_NCMDS];
+} __attribute__((aligned(64)));
+
+// map the counters before the first fork; server is the label, e.g. "S2"
+int metrics_init(const char *server);
+
+// a worker handles one request at a time: begin when the command is parsed,
+// add payload bytes while serving it, end when the reply is out (no-op if
+// nothing was begun)
+void metrics_begin(const char *cmd);
+void metrics_bytes(unsigned long in, unsigned long out);
+void metrics_end(void);
+
+/*
+ * Fork the admin process serving the text exposition to every connection on
+ * 127.0.0.1:port; extra, when given, appends server specific series. It dies
+ * with the parent.
+ */
+pid_t metrics_serve(int port, void (*extra)(FILE *out));
+
+#endif
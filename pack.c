@@ -0,0 +1,761 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : pack.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Packed storage for small files. A backend started with -p
+ *               appends files up to that size to large segment files under
+ *               <base>/.pack instead of giving each its own inode, and finds
+ *               them through an index of path -> segment/offset/length kept in
+ *               memory and persisted as an append-only log.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include "pack.h"
+#include "storage.h"
+
+#define PACK_MAGIC 0x32505357u          // "WSP2", records with a checksum
+
+enum { REC_PUT = 1, REC_DEL = 2, REC_MARK = 3 };
+
+// one index log record, followed by pathlen bytes of path
+struct rec {
+    uint32_t magic;
+    uint8_t op;
+    uint8_t pad;
+    uint16_t pathlen;
+    uint32_t seg;
+    uint32_t len;
+    uint64_t off;
+    int64_t mtime;
+    uint32_t crc;                       // CRC32C of the data
+    uint32_t pad2;
+};
+
+struct entry {
+    char *path;
+    uint32_t hash;
+    uint32_t seg;
+    uint32_t len;
+    uint32_t crc;
+    uint64_t off;
+    int64_t mtime;
+    struct entry *next;
+};
+
+struct seginfo {
+    uint64_t live;                      // bytes of files still in it
+    uint32_t files;
+    int fd;                             // opened on first use, -1
+};
+
+static struct {
+    int on;
+    size_t max;
+    char base[256];
+    char dir[300];                      // <base>/.pack
+    char idxpath[320];
+    int lockfd;
+    pid_t lockpid;                      // flocks belong to the open file, so each process opens its own
+    int idxfd;
+    ino_t idxino;
+    off_t idxpos;                       // log replayed up to here
+    long records;                       // in the log, for deciding when to rewrite it
+    struct entry **tab;
+    size_t nbuckets, count;
+    struct seginfo *segs;
+    uint32_t nsegs;
+    uint32_t active;
+    long last_tick;
+} P = { .lockfd = -1, .idxfd = -1 };
+
+static long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+static uint32_t hash_path(const char *s) {
+    uint32_t h = 2166136261u;
+    while(*s)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+/* the in-memory index */
+
+static struct entry *lookup(const char *path) {
+    if(!P.tab) return NULL;
+    uint32_t h = hash_path(path);
+    for(struct entry *e = P.tab[h & (P.nbuckets - 1)]; e; e = e->next)
+        if(e->hash == h && strcmp(e->path, path) == 0)
+            return e;
+    return NULL;
+}
+
+static int grow_segs(uint32_t seg) {
+    if(seg < P.nsegs) return 0;
+    uint32_t n = P.nsegs ? P.nsegs : 16;
+    while(n <= seg) n *= 2;
+    struct seginfo *s = realloc(P.segs, n * sizeof(*s));
+    if(!s) return -1;
+    for(uint32_t i = P.nsegs; i < n; i++) {
+        s[i].live = 0;
+        s[i].files = 0;
+        s[i].fd = -1;
+    }
+    P.segs = s;
+    P.nsegs = n;
+    return 0;
+}
+
+static void rehash(void) {
+    size_t n = P.nbuckets ? P.nbuckets * 2 : 1024;
+    struct entry **tab = calloc(n, sizeof(*tab));
+    if(!tab) return;
+    for(size_t i = 0; i < P.nbuckets; i++) {
+        for(struct entry *e = P.tab[i], *next; e; e = next) {
+            next = e->next;
+            e->next = tab[e->hash & (n - 1)];
+            tab[e->hash & (n - 1)] = e;
+        }
+    }
+    free(P.tab);
+    P.tab = tab;
+    P.nbuckets = n;
+}
+
+static void unlink_entry(struct entry *e) {
+    struct entry **pp = &P.tab[e->hash & (P.nbuckets - 1)];
+    while(*pp != e) pp = &(*pp)->next;
+    *pp = e->next;
+    P.segs[e->seg].live -= e->len;
+    P.segs[e->seg].files--;
+    P.count--;
+    free(e->path);
+    free(e);
+}
+
+static void apply(const struct rec *r, const char *path) {
+    P.records++;
+    if(grow_segs(r->seg) < 0) return;
+    if(r->seg > P.active) P.active = r->seg;
+    struct entry *e = lookup(path);
+    if(r->op == REC_DEL) {
+        if(e) unlink_entry(e);
+        return;
+    }
+    if(r->op != REC_PUT) return;
+    if(e) {
+        P.segs[e->seg].live -= e->len;
+        P.segs[e->seg].files--;
+    } else {
+        if(P.count >= P.nbuckets) rehash();
+        e = calloc(1, sizeof(*e));
+        if(!e || !(e->path = strdup(path))) { free(e); return; }
+        e->hash = hash_path(path);
+        e->next = P.tab[e->hash & (P.nbuckets - 1)];
+        P.tab[e->hash & (P.nbuckets - 1)] = e;
+        P.count++;
+    }
+    e->seg = r->seg;
+    e->len = r->len;
+    e->off = r->off;
+    e->mtime = r->mtime;
+    e->crc = r->crc;
+    P.segs[e->seg].live += e->len;
+    P.segs[e->seg].files++;
+}
+
+static void clear_index(void) {
+    for(size_t i = 0; i < P.nbuckets; i++) {
+        for(struct entry *e = P.tab[i], *next; e; e = next) {
+            next = e->next;
+            free(e->path);
+            free(e);
+        }
+        P.tab[i] = NULL;
+    }
+    for(uint32_t i = 0; i < P.nsegs; i++) {
+        P.segs[i].live = 0;
+        P.segs[i].files = 0;
+    }
+    P.count = 0;
+    P.records = 0;
+    P.idxpos = 0;
+}
+
+/* locking and the log */
+
+static int lock(int how) {
+    if(P.lockpid != getpid()) {
+        char path[340];
+        if(P.lockfd >= 0) close(P.lockfd);
+        snprintf(path, sizeof(path), "%s/lock", P.dir);
+        P.lockfd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        P.lockpid = getpid();
+    }
+    while(flock(P.lockfd, how) < 0)
+        if(errno != EINTR) return -1;
+    return 0;
+}
+
+static void unlock(void) {
+    flock(P.lockfd, LOCK_UN);
+}
+
+// read the log from where this process left off; called with the lock held
+static void replay(void) {
+    struct stat st;
+    // a compactor rewrote the log: start again from the new one
+    if(stat(P.idxpath, &st) == 0 && st.st_ino != P.idxino) {
+        if(P.idxfd >= 0) close(P.idxfd);
+        P.idxfd = open(P.idxpath, O_RDWR | O_APPEND | O_CLOEXEC);
+        P.idxino = st.st_ino;
+        clear_index();
+    }
+    if(P.idxfd < 0 || fstat(P.idxfd, &st) < 0 || st.st_size <= P.idxpos)
+        return;
+    size_t n = st.st_size - P.idxpos;
+    char *buf = malloc(n);
+    if(!buf) return;
+    ssize_t got = pread(P.idxfd, buf, n, P.idxpos);
+    size_t at = 0;
+    while(got > 0 && at + sizeof(struct rec) <= (size_t)got) {
+        struct rec r;
+        memcpy(&r, buf + at, sizeof(r));
+        if(r.magic != PACK_MAGIC || at + sizeof(r) + r.pathlen > (size_t)got)
+            break;
+        char path[1024];
+        size_t pl = r.pathlen < sizeof(path) ? r.pathlen : sizeof(path) - 1;
+        memcpy(path, buf + at + sizeof(r), pl);
+        path[pl] = '\0';
+        apply(&r, path);
+        at += sizeof(r) + r.pathlen;
+    }
+    P.idxpos += at;
+    free(buf);
+}
+
+// append a record and apply it; called with the lock held after replay()
+static int log_rec(int fd, int op, const char *path, uint32_t seg, uint64_t off, uint32_t len, int64_t mtime,
+                   uint32_t crc) {
+    char buf[sizeof(struct rec) + 1024];
+    struct rec r;
+    size_t pl = strlen(path);
+    if(pl >= 1024) return -1;
+    memset(&r, 0, sizeof(r));
+    r.magic = PACK_MAGIC;
+    r.op = op;
+    r.pathlen = pl;
+    r.seg = seg;
+    r.off = off;
+    r.len = len;
+    r.mtime = mtime;
+    r.crc = crc;
+    memcpy(buf, &r, sizeof(r));
+    memcpy(buf + sizeof(r), path, pl);
+    // one write; a short one (a full disk) is cut off again, or replay would
+    // stop at it and never see the records appended after it
+    struct stat st;
+    if(fstat(fd, &st) < 0)
+        return -1;
+    if(write(fd, buf, sizeof(r) + pl) != (ssize_t)(sizeof(r) + pl)) {
+        (void)!ftruncate(fd, st.st_size);
+        return -1;
+    }
+    if(fd == P.idxfd) {
+        apply(&r, path);
+        P.idxpos += sizeof(r) + pl;
+    }
+    return 0;
+}
+
+static void seg_path(uint32_t seg, char *out, size_t size) {
+    snprintf(out, size, "%s/seg.%06u", P.dir, seg);
+}
+
+static int seg_fd(uint32_t seg, int create) {
+    if(grow_segs(seg) < 0) return -1;
+    if(P.segs[seg].fd < 0) {
+        char path[340];
+        seg_path(seg, path, sizeof(path));
+        P.segs[seg].fd = open(path, O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+    }
+    return P.segs[seg].fd;
+}
+
+static void seg_drop(uint32_t seg) {
+    if(seg < P.nsegs && P.segs[seg].fd >= 0) {
+        close(P.segs[seg].fd);
+        P.segs[seg].fd = -1;
+    }
+}
+
+// write data at the end of the active segment, sealing it when full; called locked
+static int append_data(const void *data, size_t len, uint32_t *seg, uint64_t *off) {
+    struct stat st;
+    int fd = seg_fd(P.active, 1);
+    if(fd < 0 || fstat(fd, &st) < 0) return -1;
+    if(st.st_size > 0 && st.st_size + (off_t)len > PACK_SEG_MAX) {
+        P.active++;
+        fd = seg_fd(P.active, 1);
+        if(fd < 0) return -1;
+        st.st_size = 0;
+    }
+    for(size_t w = 0; w < len; ) {
+        ssize_t k = pwrite(fd, (const char *)data + w, len - w, st.st_size + w);
+        if(k <= 0) return -1;
+        w += k;
+    }
+    *seg = P.active;
+    *off = st.st_size;
+    return 0;
+}
+
+/* the interface */
+
+int pack_open(const char *base, size_t max) {
+    snprintf(P.base, sizeof(P.base), "%s", base);
+    snprintf(P.dir, sizeof(P.dir), "%s/.pack", base);
+    snprintf(P.idxpath, sizeof(P.idxpath), "%s/index", P.dir);
+    P.max = max < PACK_LIMIT ? max : PACK_LIMIT;
+    // without -p, files packed by an earlier start are still served
+    if(max == 0 && access(P.idxpath, F_OK) < 0)
+        return 0;
+    if(max > 0 && store_mkdirs(P.dir) < 0)
+        return -1;
+    int fd = open(P.idxpath, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(fd < 0) return -1;
+    close(fd);
+    P.on = 1;
+    P.last_tick = now_ms();
+    rehash();
+    grow_segs(0);
+    if(lock(LOCK_EX) < 0) return -1;
+    replay();
+    // a record torn by a crash ends the log; cut it off so later ones are read
+    struct stat st;
+    if(P.idxfd >= 0 && fstat(P.idxfd, &st) == 0 && st.st_size > P.idxpos &&
+       ftruncate(P.idxfd, P.idxpos) < 0) {
+        unlock();
+        return -1;
+    }
+    unlock();
+    return P.tab && P.segs ? 0 : -1;
+}
+
+int pack_fits(size_t size) {
+    return P.on && P.max > 0 && size <= P.max;
+}
+
+int pack_opened(void) {
+    return P.on;
+}
+
+void pack_refresh(void) {
+    if(!P.on || lock(LOCK_SH) < 0) return;
+    replay();
+    unlock();
+}
+
+int pack_put(const char *path, const void *data, size_t len, uint32_t crc) {
+    if(!P.on || lock(LOCK_EX) < 0) return -1;
+    replay();
+    uint32_t seg;
+    uint64_t off;
+    int rc = append_data(data, len, &seg, &off) == 0 &&
+             log_rec(P.idxfd, REC_PUT, path, seg, off, len, time(NULL), crc) == 0 ? 0 : -1;
+    unlock();
+    // a loose copy from before would shadow nothing, but it takes an inode
+    if(rc == 0) unlink(path);
+    return rc;
+}
+
+int pack_exists(const char *path) {
+    pack_refresh();
+    return lookup(path) != NULL;
+}
+
+int pack_read(const char *path, char **data, size_t *len, uint32_t *crc) {
+    *data = NULL;
+    *len = 0;
+    if(!P.on) return -1;
+    // a compactor can move the file and delete its segment under us: look again
+    for(int tries = 0; tries < 3; tries++) {
+        pack_refresh();
+        struct entry *e = lookup(path);
+        if(!e) return -1;
+        int fd = seg_fd(e->seg, 0);
+        if(fd < 0) continue;
+        char *buf = malloc(e->len ? e->len : 1);
+        if(!buf) return -1;
+        size_t got = 0;
+        while(got < e->len) {
+            ssize_t k = pread(fd, buf + got, e->len - got, e->off + got);
+            if(k <= 0) break;
+            got += k;
+        }
+        if(got == e->len) {
+            *data = buf;
+            *len = got;
+            *crc = e->crc;
+            return 0;
+        }
+        free(buf);
+        seg_drop(e->seg);
+    }
+    return -1;
+}
+
+int pack_remove(const char *path) {
+    if(!P.on || lock(LOCK_EX) < 0) return -1;
+    replay();
+    int rc = lookup(path) && log_rec(P.idxfd, REC_DEL, path, 0, 0, 0, 0, 0) == 0 ? 0 : -1;
+    unlock();
+    return rc;
+}
+
+void pack_remove_batch(const char *base, char *const *rels, size_t n, signed char *status) {
+    for(size_t i = 0; i < n; i++)
+        status[i] = 1;
+    if(!P.on || n == 0 || lock(LOCK_EX) < 0) return;
+    // one lock and one catch-up for the lot
+    replay();
+    for(size_t i = 0; i < n; i++) {
+        char path[600];
+        store_path(base, rels[i], path, sizeof(path));
+        if(lookup(path))
+            status[i] = log_rec(P.idxfd, REC_DEL, path, 0, 0, 0, 0, 0) == 0 ? 0 : -1;
+    }
+    unlock();
+}
+
+void pack_find(const char *pattern, struct pathlist *out) {
+    if(!P.on) return;
+    pack_refresh();
+    size_t blen = strlen(P.base);
+    for(size_t i = 0; i < P.nbuckets; i++) {
+        for(struct entry *e = P.tab[i]; e; e = e->next) {
+            char client[1100];
+            snprintf(client, sizeof(client), "~S1%s", e->path + blen);
+            if(store_match(pattern, client))
+                pathlist_add(out, client);
+        }
+    }
+}
+
+static int cmp_file(const void *a, const void *b) {
+    return store_pathcmp(((const struct store_file *)a)->path, ((const struct store_file *)b)->path);
+}
+
+size_t pack_files(const struct store_listing *l, struct store_file **out) {
+    *out = NULL;
+    if(!P.on) return 0;
+    pack_refresh();
+    size_t blen = strlen(P.base), n = 0, cap = 0;
+    for(size_t i = 0; i < P.nbuckets; i++) {
+        for(struct entry *e = P.tab[i]; e; e = e->next) {
+            char client[1100];
+            snprintf(client, sizeof(client), "~S1%s", e->path + blen);
+            if(!store_listed(l, client))
+                continue;
+            if(n == cap) {
+                cap = cap ? cap * 2 : 256;
+                struct store_file *files = realloc(*out, cap * sizeof(*files));
+                if(!files) break;
+                *out = files;
+            }
+            (*out)[n].path = strdup(client);
+            (*out)[n].size = e->len;
+            (*out)[n].mtime = e->mtime;
+            if((*out)[n].path) n++;
+        }
+    }
+    if(n) qsort(*out, n, sizeof(**out), cmp_file);
+    return n;
+}
+
+void pack_files_free(struct store_file *files, size_t n) {
+    for(size_t i = 0; i < n; i++)
+        free((char *)files[i].path);
+    free(files);
+}
+
+void pack_each(void (*fn)(void *arg, const char *rel), void *arg) {
+    if(!P.on) return;
+    pack_refresh();
+    size_t blen = strlen(P.base);
+    for(size_t i = 0; i < P.nbuckets; i++)
+        for(struct entry *e = P.tab[i]; e; e = e->next)
+            fn(arg, e->path + blen);
+}
+
+/* tar */
+
+static void tar_octal(char *field, size_t width, unsigned long long v) {
+    snprintf(field, width, "%0*llo", (int)width - 1, v);
+}
+
+static void tar_block(FILE *out, const char *name, size_t size, long long mtime, char type) {
+    char h[512];
+    memset(h, 0, sizeof(h));
+    snprintf(h, 100, "%s", name);
+    tar_octal(h + 100, 8, 0644);
+    tar_octal(h + 108, 8, 0);
+    tar_octal(h + 116, 8, 0);
+    tar_octal(h + 124, 12, size);
+    tar_octal(h + 136, 12, mtime > 0 ? mtime : 0);
+    h[156] = type;
+    memcpy(h + 257, "ustar", 6);
+    memcpy(h + 263, "00", 2);
+    memset(h + 148, ' ', 8);
+    unsigned sum = 0;
+    for(int i = 0; i < 512; i++)
+        sum += (unsigned char)h[i];
+    snprintf(h + 148, 8, "%06o", sum);
+    fwrite(h, 1, 512, out);
+}
+
+static void tar_pad(FILE *out, size_t size) {
+    static const char zero[512];
+    if(size % 512)
+        fwrite(zero, 1, 512 - size % 512, out);
+}
+
+static void tar_member(FILE *out, const char *name, const char *data, size_t size, long long mtime) {
+    size_t nlen = strlen(name);
+    if(nlen >= 100) {
+        // GNU long name, which S1's tar merge and GNU/BSD tar understand
+        tar_block(out, "././@LongLink", nlen + 1, 0, 'L');
+        fwrite(name, 1, nlen + 1, out);
+        tar_pad(out, nlen + 1);
+    }
+    tar_block(out, name, size, mtime, '0');
+    fwrite(data, 1, size, out);
+    tar_pad(out, size);
+}
+
+// offset of the end-of-archive blocks in a tar, or -1
+static long tar_end(FILE *fp) {
+    unsigned char h[512];
+    long pos = 0;
+    while(fseek(fp, pos, SEEK_SET) == 0 && fread(h, 1, 512, fp) == 512) {
+        if(h[0] == '\0')
+            return pos;
+        // octal, or GNU base-256 for the very large
+        unsigned long long size = 0;
+        int i = 124;
+        if(h[i] & 0x80) {
+            for(i = 125; i < 136; i++) size = (size << 8) | h[i];
+        } else {
+            while(i < 136 && h[i] == ' ') i++;
+            for(; i < 136 && h[i] >= '0' && h[i] <= '7'; i++) size = size * 8 + (h[i] - '0');
+        }
+        pos += 512 + (long)((size + 511) / 512 * 512);
+    }
+    return pos;
+}
+
+// where a file was when the tar was started; the index entry itself can be
+// freed by the next refresh
+struct member {
+    char *path;
+    uint32_t seg;
+    uint32_t len;
+    uint64_t off;
+    int64_t mtime;
+};
+
+static int cmp_pos(const void *a, const void *b) {
+    const struct member *x = a, *y = b;
+    if(x->seg != y->seg) return x->seg < y->seg ? -1 : 1;
+    return x->off < y->off ? -1 : x->off > y->off;
+}
+
+// add one packed file; 1 when it was removed since, 0 or -1
+static int tar_packed(FILE *fp, const struct member *m, char *buf) {
+    int fd = seg_fd(m->seg, 0);
+    if(fd >= 0 && pread(fd, buf, m->len, m->off) == (ssize_t)m->len) {
+        tar_member(fp, m->path, buf, m->len, m->mtime);
+        return 0;
+    }
+    // moved by a compactor since: look it up again
+    char *data;
+    size_t len;
+    uint32_t crc;
+    if(pack_read(m->path, &data, &len, &crc) < 0)
+        return lookup(m->path) ? -1 : 1;
+    tar_member(fp, m->path, data, len, m->mtime);
+    free(data);
+    return 0;
+}
+
+int pack_tar(const char *tarname, const struct timespec *since) {
+    if(!P.on) return 0;
+    FILE *fp = fopen(tarname, "r+b");
+    if(!fp) fp = fopen(tarname, "w+b");
+    if(!fp) return -1;
+    long end = tar_end(fp);
+    if(end < 0 || fseek(fp, end, SEEK_SET) < 0) {
+        fclose(fp);
+        return -1;
+    }
+    pack_refresh();
+    struct member *list = malloc((P.count ? P.count : 1) * sizeof(*list));
+    // files packed by an earlier start can be larger than this one's -p
+    char *buf = malloc(PACK_LIMIT);
+    size_t n = 0;
+    int rc = list && buf ? 0 : -1;
+    for(size_t i = 0; rc == 0 && i < P.nbuckets; i++) {
+        for(struct entry *e = P.tab[i]; rc == 0 && e; e = e->next) {
+            // whole seconds, so a file of the second since falls in is kept
+            if(since && e->mtime < since->tv_sec)
+                continue;
+            struct member *m = &list[n];
+            m->path = strdup(e->path);
+            m->seg = e->seg;
+            m->len = e->len;
+            m->off = e->off;
+            m->mtime = e->mtime;
+            if(m->path) n++;
+            else rc = -1;
+        }
+    }
+    // segment order, so the whole pack is read front to back
+    if(n) qsort(list, n, sizeof(*list), cmp_pos);
+    for(size_t i = 0; rc == 0 && i < n; i++)
+        if(tar_packed(fp, &list[i], buf) < 0)
+            rc = -1;
+    for(size_t i = 0; i < n; i++)
+        free(list[i].path);
+    free(list);
+    free(buf);
+    static const char zero[1024];
+    fwrite(zero, 1, sizeof(zero), fp);
+    // the earlier end-of-archive may have been longer than what replaced it
+    int ok = fflush(fp) == 0 && ftruncate(fileno(fp), ftell(fp)) == 0;
+    return fclose(fp) == 0 && ok && rc == 0 ? 0 : -1;
+}
+
+/* compaction */
+
+static int seg_garbage(uint32_t seg) {
+    char path[340];
+    struct stat st;
+    seg_path(seg, path, sizeof(path));
+    if(stat(path, &st) < 0 || st.st_size == 0)
+        return 0;
+    return P.segs[seg].live * 100 < (uint64_t)st.st_size * (100 - PACK_GARBAGE);
+}
+
+static void compact_seg(uint32_t seg) {
+    // the files to move, then move each under the lock if it is still there
+    if(lock(LOCK_EX) < 0) return;
+    replay();
+    size_t n = 0, cap = P.segs[seg].files;
+    char **paths = malloc((cap ? cap : 1) * sizeof(*paths));
+    for(size_t i = 0; paths && i < P.nbuckets; i++)
+        for(struct entry *e = P.tab[i]; e && n < cap; e = e->next)
+            if(e->seg == seg) paths[n++] = strdup(e->path);
+    unlock();
+    char *buf = malloc(PACK_LIMIT);
+    for(size_t i = 0; paths && buf && i < n; i += 64) {
+        if(lock(LOCK_EX) < 0) break;
+        replay();
+        for(size_t j = i; j < n && j < i + 64; j++) {
+            struct entry *e = paths[j] ? lookup(paths[j]) : NULL;
+            int fd = e && e->seg == seg ? seg_fd(seg, 0) : -1;
+            uint32_t to;
+            uint64_t off;
+            if(fd >= 0 && pread(fd, buf, e->len, e->off) == (ssize_t)e->len &&
+               append_data(buf, e->len, &to, &off) == 0)
+                log_rec(P.idxfd, REC_PUT, e->path, to, off, e->len, e->mtime, e->crc);
+        }
+        unlock();
+    }
+    for(size_t i = 0; paths && i < n; i++)
+        free(paths[i]);
+    free(paths);
+    free(buf);
+    // readers that still hold it open keep their copy
+    if(lock(LOCK_EX) < 0) return;
+    replay();
+    if(P.segs[seg].files == 0) {
+        char path[340];
+        seg_path(seg, path, sizeof(path));
+        unlink(path);
+        seg_drop(seg);
+    }
+    unlock();
+}
+
+// replace the log with one PUT per live file once it is mostly dead records
+static void rewrite_index(void) {
+    if(lock(LOCK_EX) < 0) return;
+    replay();
+    if(P.records < 1024 || (size_t)P.records < 2 * P.count) {
+        unlock();
+        return;
+    }
+    char tmp[340];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", P.idxpath);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    // the mark keeps the active segment number when it holds no files
+    int ok = fd >= 0 && log_rec(fd, REC_MARK, "", P.active, 0, 0, 0, 0) == 0;
+    for(size_t i = 0; ok && i < P.nbuckets; i++)
+        for(struct entry *e = P.tab[i]; ok && e; e = e->next)
+            ok = log_rec(fd, REC_PUT, e->path, e->seg, e->off, e->len, e->mtime, e->crc) == 0;
+    if(fd >= 0 && close(fd) < 0) ok = 0;
+    if(ok && rename(tmp, P.idxpath) == 0)
+        replay();                       // picks up the new log from the start
+    else
+        unlink(tmp);
+    unlock();
+}
+
+static void compact(void) {
+    char path[340];
+    snprintf(path, sizeof(path), "%s/compact", P.dir);
+    // one compactor at a time, whichever acceptor started it
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(fd < 0 || flock(fd, LOCK_EX | LOCK_NB) < 0)
+        return;
+    pack_refresh();
+    for(uint32_t seg = 0; seg < P.active; seg++)
+        if(seg_garbage(seg))
+            compact_seg(seg);
+    rewrite_index();
+    close(fd);
+}
+
+pid_t pack_tick(void) {
+    if(!P.on || now_ms() - P.last_tick < PACK_TICK_MS)
+        return 0;
+    P.last_tick = now_ms();
+    int due = P.records >= 1024 && (size_t)P.records >= 2 * P.count;
+    for(uint32_t seg = 0; seg < P.active && !due; seg++)
+        due = seg_garbage(seg);
+    if(!due)
+        return 0;
+    pid_t pid = fork();
+    if(pid == 0) {
+        compact();
+        _exit(0);
+    }
+    return pid < 0 ? 0 : pid;
+}
@@ -0,0 +1,95 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : pack.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Packed storage for small files. A backend started with -p
+ *               appends files up to that size to large segment files under
+ *               <base>/.pack instead of giving each its own inode, and finds
+ *               them through an index of path -> segment/offset/length kept in
+ *               memory and persisted as an append-only log.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef PACK_H
+#define PACK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "storage.h"
+
+#define PACK_LIMIT     (1024 * 1024)            // largest size -p accepts
+#define PACK_SEG_MAX   (64L * 1024 * 1024)      // a segment past this is sealed
+#define PACK_GARBAGE   50                       // compact sealed segments over this % dead
+#define PACK_TICK_MS   5000                     // how often the parent looks at that
+
+/*
+ * The servers fork per connection and several processes write at once, so
+ * every change is made under an flock of <base>/.pack/lock: the data goes to
+ * the end of the active segment, then one record to the index log. The
+ * parent loads the log at startup and every process catches up on what
+ * others appended (pack_refresh) before it looks anything up; children
+ * start from the parent's copy, refreshed before each fork.
+ *
+ * Keys are store paths ("./S2/dir/file.txt"), the same as the loose file
+ * would have. A put removes the loose file, and storing a loose file must
+ * remove the packed one, so only one of them exists.
+ */
+
+// open or create the pack under base for files up to max bytes; with max 0
+// an existing pack is opened for its files but nothing new is packed; 0 or -1
+int pack_open(const char *base, size_t max);
+
+// packing is on and a file of size bytes belongs in it
+int pack_fits(size_t size);
+
+// there is a pack to read from and compact
+int pack_opened(void);
+
+// read what other processes appended to the index
+void pack_refresh(void);
+
+// store len bytes as path, with their CRC32C; 0 or -1
+int pack_put(const char *path, const void *data, size_t len, uint32_t crc);
+
+// the file is packed
+int pack_exists(const char *path);
+
+// a malloc'd copy of a packed file and its CRC32C; 0, or -1 when it is not packed
+int pack_read(const char *path, char **data, size_t *len, uint32_t *crc);
+
+// 0 when a packed file was removed, -1 when there was none
+int pack_remove(const char *path);
+
+// pack_remove for n client paths under base in one go; status[i] becomes 0
+// when removed, 1 when not packed, -1 when it failed
+void pack_remove_batch(const char *base, char *const *rels, size_t n, signed char *status);
+
+// add the client path of every packed file matching a removem pattern
+void pack_find(const char *pattern, struct pathlist *out);
+
+// the packed files a listing shows, in listing order, as an array that
+// pack_files_free releases; how many
+size_t pack_files(const struct store_listing *l, struct store_file **out);
+void pack_files_free(struct store_file *files, size_t n);
+
+// call fn for every packed file with its path relative to base ("/dir/f.txt")
+void pack_each(void (*fn)(void *arg, const char *rel), void *arg);
+
+// add every packed file to a tar made by store_tar, read in segment order,
+// or with since only those stored from then on; 0 or -1
+int pack_tar(const char *tarname, const struct timespec *since);
+
+/*
+ * Parent, on every wakeup: every PACK_TICK_MS, if a sealed segment is more
+ * than PACK_GARBAGE% dead, fork a compactor. It copies the live files to the
+ * active segment, deletes the old one and rewrites the index log once it is
+ * mostly dead records. Returns the compactor's pid or 0.
+ */
+pid_t pack_tick(void);
+
+#endif
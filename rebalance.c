@@ -0,0 +1,218 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : rebalance.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Online rebalancing tool. Moves every stored file whose owners on the
+ *               consistent hash ring changed between two routing configs.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ *
+ * Adding an instance to a pool:
+ *   1. start the new backend
+ *   2. copy routes.conf to routes.old, add the backend to routes.conf, SIGHUP S1
+ *   3. rebalance routes.old routes.conf
+ *
+ * While files are moving S1 also looks for them on the previous owners, and
+ * the copy to the new owner uses "storef -n" so a newer upload is never
+ * overwritten by the old copy.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "route.h"
+#include "crc32c.h"
+
+#define BUFSIZE 1024
+
+// send all bytes
+ssize_t send_all(int sockfd, const void *buf, size_t len) {
+    size_t total = 0;
+    const char *p = buf;
+    while(total < len) {
+        ssize_t n = send(sockfd, p + total, len - total, 0);
+        if(n <= 0) return n;
+        total += n;
+    }
+    return total;
+}
+
+// receive all bytes
+ssize_t recv_all(int sockfd, void *buf, size_t len) {
+    size_t total = 0;
+    char *p = buf;
+    while(total < len) {
+        ssize_t n = recv(sockfd, p + total, len - total, 0);
+        if(n <= 0) return n;
+        total += n;
+    }
+    return total;
+}
+
+// send one command and read the whole reply until the server closes
+char *request(const struct backend *b, const char *cmd, size_t *len) {
+    int sock = backend_connect(b);
+    if(sock < 0) return NULL;
+    size_t cap = 4096, used = 0;
+    char *out = malloc(cap);
+    if(!out || send_all(sock, cmd, strlen(cmd)) < (ssize_t)strlen(cmd)) {
+        free(out);
+        close(sock);
+        return NULL;
+    }
+    ssize_t n;
+    while(out && (n = recv(sock, out + used, cap - used - 1, 0)) > 0) {
+        used += n;
+        if(cap - used < 2) {
+            cap *= 2;
+            char *bigger = realloc(out, cap);
+            if(!bigger) free(out);
+            out = bigger;
+        }
+    }
+    close(sock);
+    if(out) out[used] = '\0';
+    if(len) *len = used;
+    return out;
+}
+
+// copy one file from src to each of its owners, then remove it from src
+int move_file(const struct backend *src, const struct backend **dst, int ndst, const char *key) {
+    // both command lines must fit what a backend reads, or the wrong file is stored
+    char cmd[BUFSIZE], storef[BUFSIZE];
+    const char *slash = strrchr(key, '/');
+    if(snprintf(cmd, sizeof(cmd), "downlf ~S1%s", key) >= (int)sizeof(cmd) ||
+       snprintf(storef, sizeof(storef), "storef ~S1%.*s %s -n", (int)(slash - key), key, slash + 1) >= (int)sizeof(storef)) {
+        fprintf(stderr, "%s: path too long to move\n", key);
+        return -1;
+    }
+    int sock = backend_connect(src);
+    if(sock < 0) return -1;
+    uint32_t net_size;
+    if(send_all(sock, cmd, strlen(cmd)) < (ssize_t)strlen(cmd) ||
+       recv_all(sock, &net_size, sizeof(net_size)) != sizeof(net_size) ||
+       memcmp(&net_size, "ERRO", 4) == 0) {
+        close(sock);
+        return -1;
+    }
+    // a copy that does not match its checksum is left where it is
+    uint32_t size = ntohl(net_size), net_crc = 0;
+    char *data = malloc(size ? size : 1);
+    if(!data || recv_all(sock, data, size) != (ssize_t)size ||
+       (size > 0 && (recv_all(sock, &net_crc, sizeof(net_crc)) != sizeof(net_crc) ||
+                     ntohl(net_crc) != crc32c(0, data, size)))) {
+        free(data);
+        close(sock);
+        return -1;
+    }
+    close(sock);
+
+    int rc = 0;
+    for(int d = 0; d < ndst; d++) {
+        int copied = 0;
+        sock = backend_connect(dst[d]);
+        if(sock < 0) {
+            rc = -1;
+            continue;
+        }
+        char reply[BUFSIZE];
+        memset(reply, 0, sizeof(reply));
+        if(send_all(sock, storef, strlen(storef)) == (ssize_t)strlen(storef) &&
+           recv(sock, reply, sizeof(reply) - 1, 0) > 0 && strncmp(reply, "READY", 5) == 0 &&
+           send_all(sock, &net_size, sizeof(net_size)) == sizeof(net_size) &&
+           send_all(sock, data, size) == (ssize_t)size &&
+           (size == 0 || send_all(sock, &net_crc, sizeof(net_crc)) == sizeof(net_crc))) {
+            memset(reply, 0, sizeof(reply));
+            recv(sock, reply, sizeof(reply) - 1, 0);
+            // "File exists" means a newer upload already landed on the owner
+            if(strncmp(reply, "File stored", 11) == 0 || strncmp(reply, "File exists", 11) == 0)
+                copied = 1;
+        }
+        close(sock);
+        if(!copied)
+            rc = -1;
+    }
+    free(data);
+    if(rc == 0) {
+        snprintf(cmd, sizeof(cmd), "removef ~S1%s", key);
+        free(request(src, cmd, NULL));
+    }
+    return rc;
+}
+
+// backends of a pool in either config, looked up by name in the new one first
+int pool_sources(const struct route_table *rt_old, const struct route_table *rt_new,
+                 const struct pool *p_new, const struct backend **out) {
+    int n = 0;
+    const struct pool *p_old = route_lookup(rt_old, p_new->ext);
+    const struct pool *pools[2] = {p_new, p_old};
+    const struct route_table *tables[2] = {rt_new, rt_old};
+    for(int t = 0; t < 2; t++) {
+        if(!pools[t]) continue;
+        for(int m = 0; m < pools[t]->nmembers; m++) {
+            const struct backend *b = &tables[t]->backends[pools[t]->members[m]];
+            int seen = 0;
+            for(int i = 0; i < n; i++)
+                if(strcmp(out[i]->name, b->name) == 0) seen = 1;
+            if(!seen && n < 2 * ROUTE_MAX_MEMBERS)
+                out[n++] = b;
+        }
+    }
+    return n;
+}
+
+int main(int argc, char *argv[]) {
+    static struct route_table rt_old, rt_new;
+    if(argc < 3) {
+        fprintf(stderr, "Usage: %s old.conf new.conf\n", argv[0]);
+        exit(1);
+    }
+    if(route_load(&rt_old, argv[1]) < 0 || route_load(&rt_new, argv[2]) < 0) {
+        fprintf(stderr, "ERROR loading routing configs\n");
+        exit(1);
+    }
+    int moved = 0, failed = 0;
+    for(int i = 0; i < rt_new.npools; i++) {
+        const struct pool *p = &rt_new.pools[i];
+        if(p->nmembers == 0) continue;
+        const struct backend *sources[2 * ROUTE_MAX_MEMBERS];
+        int ns = pool_sources(&rt_old, &rt_new, p, sources);
+        for(int s = 0; s < ns; s++) {
+            char *list = request(sources[s], "lsall", NULL);
+            if(!list) {
+                fprintf(stderr, "%s: cannot list backend %s\n", p->ext, sources[s]->name);
+                failed++;
+                continue;
+            }
+            for(char *key = strtok(list, "\n"); key; key = strtok(NULL, "\n")) {
+                char *ext = strrchr(key, '.');
+                if(!ext || strcasecmp(ext, p->ext) != 0) continue;
+                // the first R distinct backends on the ring hold the replicas
+                const struct backend *owners[ROUTE_MAX_MEMBERS];
+                int no = route_walk(&rt_new, p, key, owners, p->replicas), mine = 0;
+                for(int o = 0; o < no; o++)
+                    if(strcmp(owners[o]->name, sources[s]->name) == 0) mine = 1;
+                if(mine) continue;
+                if(move_file(sources[s], owners, no, key) == 0) {
+                    printf("%s: %s -> %s%s\n", key, sources[s]->name, owners[0]->name, no > 1 ? " (+replicas)" : "");
+                    moved++;
+                } else {
+                    fprintf(stderr, "%s: move from %s failed\n", key, sources[s]->name);
+                    failed++;
+                }
+            }
+            free(list);
+        }
+    }
+    printf("moved %d files, %d errors\n", moved, failed);
+    return failed ? 1 : 0;
+}
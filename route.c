@@ -0,0 +1,362 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : route.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Routing table for S1. Maps a file extension to the pool of
+ *               backend servers that store it, loaded from a config file.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ *
+ * Config format, one directive per line, '#' starts a comment:
+ *
+ *   backend <name> <host>:<port>|unix:<path> [weight]
+ *   route   <ext> <backend|local[=dir]> [<backend> ...] [replicas=R] [quorum=W] [hedge=MS]
+ *
+ * Each pool places its backends on a consistent hash ring with
+ * ROUTE_VNODES points per unit of weight, so adding a backend only moves
+ * the keys that land on its new points.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "route.h"
+
+static uint32_t fnv1a(const char *s, int fold) {
+    uint32_t h = 2166136261u;
+    while(*s) {
+        h ^= (unsigned char)(fold ? tolower((unsigned char)*s) : *s);
+        h *= 16777619u;
+        s++;
+    }
+    return h;
+}
+
+// murmur3 finaliser, spreads similar names ("S2#1", "S2#2") across the ring
+static uint32_t mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static int cmp_vnode(const void *a, const void *b) {
+    uint32_t x = ((const struct vnode *)a)->hash, y = ((const struct vnode *)b)->hash;
+    return x < y ? -1 : x > y;
+}
+
+// place every member on the ring, scaling vnodes down if the weights are large
+static void build_ring(const struct route_table *rt, struct pool *p) {
+    int per_weight = ROUTE_VNODES;
+    if(p->total_weight > 0 && p->total_weight * per_weight > ROUTE_RING_MAX)
+        per_weight = ROUTE_RING_MAX / p->total_weight;
+    if(per_weight < 1) per_weight = 1;
+    p->nvnodes = 0;
+    for(int m = 0; m < p->nmembers; m++) {
+        const struct backend *b = &rt->backends[p->members[m]];
+        for(int v = 0; v < b->weight * per_weight && p->nvnodes < ROUTE_RING_MAX; v++) {
+            char label[64];
+            snprintf(label, sizeof(label), "%s#%d", b->name, v);
+            p->ring[p->nvnodes].hash = mix(fnv1a(label, 0));
+            p->ring[p->nvnodes].backend = p->members[m];
+            p->nvnodes++;
+        }
+    }
+    qsort(p->ring, p->nvnodes, sizeof(p->ring[0]), cmp_vnode);
+}
+
+static void reset(struct route_table *rt) {
+    memset(rt, 0, sizeof(*rt));
+    for(int i = 0; i < ROUTE_BUCKETS; i++)
+        rt->buckets[i] = -1;
+}
+
+static int add_backend(struct route_table *rt, const char *name, const char *host, int port, int weight) {
+    if(rt->nbackends == ROUTE_MAX_BACKENDS) {
+        fprintf(stderr, "routes: too many backends\n");
+        return -1;
+    }
+    struct backend *b = &rt->backends[rt->nbackends];
+    memset(b, 0, sizeof(*b));
+    snprintf(b->name, sizeof(b->name), "%s", name);
+    snprintf(b->host, sizeof(b->host), "%s", host);
+    b->port = port;
+    b->weight = weight > 0 ? weight : 1;
+    b->addr.sin_family = AF_INET;
+    b->addr.sin_port = htons(port);
+    if(strcmp(host, "unix") == 0)
+        return rt->nbackends++;
+    if(inet_pton(AF_INET, host, &b->addr.sin_addr) != 1) {
+        struct hostent *he = gethostbyname(host);
+        if(!he) {
+            fprintf(stderr, "routes: cannot resolve %s\n", host);
+            return -1;
+        }
+        memcpy(&b->addr.sin_addr, he->h_addr, he->h_length);
+    }
+    return rt->nbackends++;
+}
+
+static int find_backend(const struct route_table *rt, const char *name) {
+    for(int i = 0; i < rt->nbackends; i++)
+        if(strcmp(rt->backends[i].name, name) == 0)
+            return i;
+    return -1;
+}
+
+static struct pool *add_pool(struct route_table *rt, const char *ext) {
+    if(rt->npools == ROUTE_MAX_POOLS || route_lookup(rt, ext)) {
+        fprintf(stderr, "routes: duplicate or too many routes (%s)\n", ext);
+        return NULL;
+    }
+    struct pool *p = &rt->pools[rt->npools];
+    memset(p, 0, sizeof(*p));
+    for(int i = 0; ext[i] && i < (int)sizeof(p->ext) - 1; i++)
+        p->ext[i] = tolower((unsigned char)ext[i]);
+    p->replicas = 1;
+    p->quorum = 1;
+    unsigned int h = fnv1a(p->ext, 0) & (ROUTE_BUCKETS - 1);
+    while(rt->buckets[h] >= 0)
+        h = (h + 1) & (ROUTE_BUCKETS - 1);
+    rt->buckets[h] = rt->npools++;
+    return p;
+}
+
+static void add_member(struct route_table *rt, struct pool *p, int idx) {
+    if(p->nmembers == ROUTE_MAX_MEMBERS) return;
+    p->members[p->nmembers++] = idx;
+    p->total_weight += rt->backends[idx].weight;
+}
+
+// built-in table, same as the original hardcoded routing
+void route_defaults(struct route_table *rt) {
+    static const char *exts[] = {".pdf", ".txt", ".zip"};
+    static const char *names[] = {"S2", "S3", "S4"};
+    reset(rt);
+    struct pool *c = add_pool(rt, ".c");
+    c->local = 1;
+    strcpy(c->dir, "./S1");
+    for(int i = 0; i < 3; i++) {
+        int b = add_backend(rt, names[i], "127.0.0.1", 9002 + i, 1);
+        struct pool *p = add_pool(rt, exts[i]);
+        add_member(rt, p, b);
+        build_ring(rt, p);
+    }
+}
+
+int route_load(struct route_table *rt, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if(!fp) return -1;
+    struct route_table *tmp = malloc(sizeof(*tmp));
+    if(!tmp) {
+        fclose(fp);
+        return -1;
+    }
+    reset(tmp);
+    char line[512];
+    int lineno = 0, rc = 0;
+    while(rc == 0 && fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if(hash) *hash = '\0';
+        char *argv[2 + ROUTE_MAX_MEMBERS];
+        int argc = 0;
+        for(char *tok = strtok(line, " \t\r\n"); tok && argc < 2 + ROUTE_MAX_MEMBERS; tok = strtok(NULL, " \t\r\n"))
+            argv[argc++] = tok;
+        if(argc == 0) continue;
+        // a trailing "shm" on a unix backend turns on the shared ring
+        int shm = argc >= 4 && strcmp(argv[0], "backend") == 0 && strcmp(argv[argc - 1], "shm") == 0;
+        if(shm) argc--;
+        if(strcmp(argv[0], "backend") == 0 && (argc == 3 || argc == 4)) {
+            char *colon = strrchr(argv[2], ':');
+            if(strncmp(argv[2], "unix:", 5) == 0) {
+                // same host: a Unix socket skips the TCP stack
+                int b = find_backend(tmp, argv[1]) < 0 && strlen(argv[2] + 5) < sizeof(tmp->backends[0].uaddr.sun_path) ?
+                        add_backend(tmp, argv[1], "unix", 0, argc == 4 ? atoi(argv[3]) : 1) : -1;
+                if(b < 0) {
+                    rc = -1;
+                } else {
+                    tmp->backends[b].uaddr.sun_family = AF_UNIX;
+                    strcpy(tmp->backends[b].uaddr.sun_path, argv[2] + 5);
+                    tmp->backends[b].shm = shm;
+                }
+            } else if(shm) {
+                rc = -1;
+            } else if(!colon || find_backend(tmp, argv[1]) >= 0) {
+                rc = -1;
+            } else {
+                *colon = '\0';
+                if(add_backend(tmp, argv[1], argv[2], atoi(colon + 1), argc == 4 ? atoi(argv[3]) : 1) < 0)
+                    rc = -1;
+            }
+        } else if(strcmp(argv[0], "route") == 0 && argc >= 3 && argv[1][0] == '.') {
+            struct pool *p = add_pool(tmp, argv[1]);
+            int quorum = 0;
+            for(int i = 2; p && i < argc; i++) {
+                int b = find_backend(tmp, argv[i]);
+                if(strncmp(argv[i], "replicas=", 9) == 0)
+                    p->replicas = atoi(argv[i] + 9);
+                else if(strncmp(argv[i], "quorum=", 7) == 0)
+                    quorum = atoi(argv[i] + 7);
+                else if(strncmp(argv[i], "hedge=", 6) == 0)
+                    p->hedge_ms = atoi(argv[i] + 6);
+                else if(strcmp(argv[i], "local") == 0 || strncmp(argv[i], "local=", 6) == 0) {
+                    // the storage engine runs inside S1, by default in ./S1
+                    p->local = 1;
+                    snprintf(p->dir, sizeof(p->dir), "%s", argv[i][5] && argv[i][6] ? argv[i] + 6 : "./S1");
+                }
+                else if(b >= 0)
+                    add_member(tmp, p, b);
+                else
+                    p = NULL;
+            }
+            if(p) {
+                // majority of the replicas unless configured
+                p->quorum = quorum > 0 ? quorum : p->replicas / 2 + 1;
+                if(p->replicas < 1 || (!p->local && p->replicas > p->nmembers) || p->quorum > p->replicas)
+                    p = NULL;
+            }
+            if(!p || (!p->local && p->nmembers == 0))
+                rc = -1;
+        } else {
+            rc = -1;
+        }
+        if(rc < 0)
+            fprintf(stderr, "%s:%d: invalid directive\n", path, lineno);
+    }
+    fclose(fp);
+    if(rc == 0) {
+        for(int i = 0; i < tmp->npools; i++)
+            build_ring(tmp, &tmp->pools[i]);
+        *rt = *tmp;
+    }
+    free(tmp);
+    return rc;
+}
+
+const struct pool *route_lookup(const struct route_table *rt, const char *ext) {
+    if(!ext) return NULL;
+    unsigned int h = fnv1a(ext, 1) & (ROUTE_BUCKETS - 1);
+    while(rt->buckets[h] >= 0) {
+        const struct pool *p = &rt->pools[rt->buckets[h]];
+        if(strcasecmp(p->ext, ext) == 0)
+            return p;
+        h = (h + 1) & (ROUTE_BUCKETS - 1);
+    }
+    return NULL;
+}
+
+// whether S1 stores any type itself; without local routes it is stateless
+int route_has_local(const struct route_table *rt) {
+    for(int i = 0; i < rt->npools; i++)
+        if(rt->pools[i].local)
+            return 1;
+    return 0;
+}
+
+// distinct backends in ring order starting at the path's position; the first
+// one owns the path, the rest are where it lived before instances were added
+int route_walk(const struct route_table *rt, const struct pool *p, const char *path,
+               const struct backend **out, int max) {
+    if(p->nvnodes == 0) return 0;
+    uint32_t h = mix(fnv1a(path, 0));
+    int lo = 0, hi = p->nvnodes;
+    while(lo < hi) {
+        int mid = (lo + hi) / 2;
+        if(p->ring[mid].hash < h) lo = mid + 1; else hi = mid;
+    }
+    int n = 0;
+    for(int i = 0; i < p->nvnodes && n < max && n < p->nmembers; i++) {
+        const struct backend *b = &rt->backends[p->ring[(lo + i) % p->nvnodes].backend];
+        int seen = 0;
+        for(int j = 0; j < n; j++)
+            if(out[j] == b) seen = 1;
+        if(!seen)
+            out[n++] = b;
+    }
+    return n;
+}
+
+const struct backend *route_pick(const struct route_table *rt, const struct pool *p, const char *path) {
+    const struct backend *b = NULL;
+    route_walk(rt, p, path, &b, 1);
+    return b;
+}
+
+// connect with a ROUTE_CONNECT_MS timeout so an unreachable host cannot
+// stall the request for the kernel's SYN retry period; silent, sets errno
+int backend_dial(const struct backend *b) {
+    if(b->uaddr.sun_path[0]) {
+        // a Unix socket connect never waits on the network
+        int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(sockfd < 0)
+            return -1;
+        if(connect(sockfd, (const struct sockaddr *)&b->uaddr, sizeof(b->uaddr)) < 0) {
+            int saved = errno;
+            close(sockfd);
+            errno = saved;
+            return -1;
+        }
+        return sockfd;
+    }
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if(sockfd < 0)
+        return -1;
+    int flags = fcntl(sockfd, F_GETFL);
+    fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+    int rc = connect(sockfd, (const struct sockaddr *)&b->addr, sizeof(b->addr));
+    if(rc < 0 && errno == EINPROGRESS) {
+        struct pollfd pfd = {sockfd, POLLOUT, 0};
+        int err = 0;
+        socklen_t len = sizeof(err);
+        rc = poll(&pfd, 1, ROUTE_CONNECT_MS);
+        if(rc == 0)
+            errno = ETIMEDOUT;
+        else if(rc > 0 && getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err != 0)
+            errno = err;
+        rc = rc > 0 && err == 0 ? 0 : -1;
+    }
+    if(rc < 0) {
+        int saved = errno;
+        close(sockfd);
+        errno = saved;
+        return -1;
+    }
+    fcntl(sockfd, F_SETFL, flags);
+    // sizes and checksums are small sends next to the data
+    int one = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return sockfd;
+}
+
+int backend_connect(const struct backend *b) {
+    int sockfd = backend_dial(b);
+    if(sockfd < 0)
+        fprintf(stderr, "ERROR connecting to backend %s (%s): %s\n", b->name, backend_addr(b), strerror(errno));
+    return sockfd;
+}
+
+const char *backend_addr(const struct backend *b) {
+    static __thread char buf[160];
+    if(b->uaddr.sun_path[0])
+        snprintf(buf, sizeof(buf), "unix:%s", b->uaddr.sun_path);
+    else
+        snprintf(buf, sizeof(buf), "%s:%d", b->host, b->port);
+    return buf;
+}
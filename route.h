@@ -0,0 +1,78 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : route.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Routing table for S1. Maps a file extension to the pool of
+ *               backend servers that store it, loaded from a config file.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+
+#define ROUTE_CONF          "routes.conf"
+#define ROUTE_MAX_BACKENDS  64
+#define ROUTE_MAX_POOLS     32
+#define ROUTE_MAX_MEMBERS   16
+#define ROUTE_BUCKETS       64      // power of two, > ROUTE_MAX_POOLS
+#define ROUTE_VNODES        40      // ring points per unit of backend weight
+#define ROUTE_RING_MAX      1024    // ring points per pool
+#define ROUTE_FALLBACK      3       // ring successors tried for reads during a rebalance
+#define ROUTE_CONNECT_MS    1000    // give up on a backend connect after this long
+
+struct backend {
+    char name[32];
+    char host[64];
+    int port;
+    int weight;
+    struct sockaddr_in addr;
+    struct sockaddr_un uaddr;           // AF_UNIX transport when sun_path is set
+    int shm;                            // uploads go through a shared ring (unix only)
+};
+
+struct vnode {
+    uint32_t hash;
+    int backend;                        // index into route_table.backends
+};
+
+struct pool {
+    char ext[16];                       // lower case, with the leading dot
+    int local;                          // stored by S1 itself, in dir
+    char dir[128];                      // "./S1" unless given as local=<dir>
+    int nmembers;
+    int members[ROUTE_MAX_MEMBERS];     // indices into route_table.backends
+    int total_weight;
+    int replicas;                       // copies of each file (R)
+    int quorum;                         // copies that must be stored before the ack (W)
+    int hedge_ms;                       // ask the next replica if the first is this slow, 0 = off
+    int nvnodes;
+    struct vnode ring[ROUTE_RING_MAX];  // consistent hash ring, sorted by hash
+};
+
+struct route_table {
+    struct backend backends[ROUTE_MAX_BACKENDS];
+    int nbackends;
+    struct pool pools[ROUTE_MAX_POOLS];
+    int npools;
+    int buckets[ROUTE_BUCKETS];         // open addressing, pool index or -1
+};
+
+void route_defaults(struct route_table *rt);
+int route_load(struct route_table *rt, const char *path);
+const struct pool *route_lookup(const struct route_table *rt, const char *ext);
+const struct backend *route_pick(const struct route_table *rt, const struct pool *p, const char *path);
+int route_has_local(const struct route_table *rt);
+int route_walk(const struct route_table *rt, const struct pool *p, const char *path,
+               const struct backend **out, int max);
+int backend_dial(const struct backend *b);
+const char *backend_addr(const struct backend *b);     // "host:port" or "unix:path"
+int backend_connect(const struct backend *b);
+
+#endif
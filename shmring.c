@@ -0,0 +1,223 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : shmring.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Single-producer/single-consumer byte ring in a memfd shared by
+ *               S1 and a backend on the same host, with an eventfd each way to
+ *               wake the other side. Upload payloads go through it instead of
+ *               the Unix socket (Linux only).
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include "shmring.h"
+#include "crc32c.h"
+
+#define SHMRING_DATA 4096               // offset of the data in the memfd
+#define SHMRING_STEP (SHMRING_SIZE / 4) // copy at most this much per wakeup
+
+static void ring_reset(struct shmring *r) {
+    memset(r, 0, sizeof(*r));
+    r->memfd = r->ready = r->space = r->peer = -1;
+}
+
+void shmring_close(struct shmring *r) {
+    if(r->hdr) munmap(r->hdr, SHMRING_DATA + r->cap);
+    if(r->memfd >= 0) close(r->memfd);
+    if(r->ready >= 0) close(r->ready);
+    if(r->space >= 0) close(r->space);
+    ring_reset(r);
+}
+
+#ifdef __linux__
+
+static int ring_map(struct shmring *r, size_t cap, int flags) {
+    void *p = mmap(NULL, SHMRING_DATA + cap, PROT_READ | PROT_WRITE, MAP_SHARED | flags, r->memfd, 0);
+    if(p == MAP_FAILED)
+        return -1;
+    r->hdr = p;
+    r->data = (char *)p + SHMRING_DATA;
+    r->cap = cap;
+    return 0;
+}
+
+int shmring_create(struct shmring *r, size_t cap) {
+    ring_reset(r);
+    r->memfd = memfd_create("w25ring", MFD_CLOEXEC);
+    r->ready = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    r->space = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(r->memfd < 0 || r->ready < 0 || r->space < 0 ||
+       ftruncate(r->memfd, SHMRING_DATA + cap) < 0 || ring_map(r, cap, 0) < 0) {
+        shmring_close(r);
+        return -1;
+    }
+    return 0;
+}
+
+int shmring_attach(struct shmring *r, const int fds[3]) {
+    struct stat st;
+    ring_reset(r);
+    r->memfd = fds[0];
+    r->ready = fds[1];
+    r->space = fds[2];
+    // the size comes from the memfd itself, never from the header
+    size_t cap = r->memfd >= 0 && fstat(r->memfd, &st) == 0 && st.st_size > SHMRING_DATA ?
+                 (size_t)st.st_size - SHMRING_DATA : 0;
+    if(cap == 0 || (cap & (cap - 1)) != 0 || r->ready < 0 || r->space < 0 ||
+       ring_map(r, cap, MAP_POPULATE) < 0) {
+        shmring_close(r);
+        return -1;
+    }
+    return 0;
+}
+
+#else
+
+int shmring_create(struct shmring *r, size_t cap) {
+    (void)cap;
+    ring_reset(r);
+    return -1;
+}
+
+int shmring_attach(struct shmring *r, const int fds[3]) {
+    ring_reset(r);
+    r->memfd = fds[0];
+    r->ready = fds[1];
+    r->space = fds[2];
+    shmring_close(r);
+    return -1;
+}
+
+#endif
+
+void shmring_fds(const struct shmring *r, int fds[3]) {
+    fds[0] = r->memfd;
+    fds[1] = r->ready;
+    fds[2] = r->space;
+}
+
+// wake the other side if it said it is going to sleep
+static void ring_signal(uint32_t *waiting, int efd) {
+    if(!__atomic_load_n(waiting, __ATOMIC_SEQ_CST))
+        return;
+    __atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+    uint64_t one = 1;
+    (void)!write(efd, &one, sizeof(one));
+}
+
+/*
+ * Sleep until efd fires, unless *pos moved from seen after the wait flag went
+ * up (the flag and the position are both seq_cst, so either this side sees
+ * the move or the other side sees the flag). The peer's socket turning
+ * readable means it gave up or went away; nothing else is sent on it while a
+ * transfer is running.
+ */
+static int ring_wait(struct shmring *r, uint32_t *waiting, const uint64_t *pos, uint64_t seen, int efd) {
+    struct pollfd p[2] = {{efd, POLLIN, 0}, {r->peer, POLLIN, 0}};
+    __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(pos, __ATOMIC_SEQ_CST) != seen)
+        return 0;
+    for(;;) {
+        int n = poll(p, r->peer >= 0 ? 2 : 1, -1);
+        if(n < 0 && errno == EINTR) continue;
+        if(n < 0 || (r->peer >= 0 && p[1].revents)) return -1;
+        uint64_t v;
+        (void)!read(efd, &v, sizeof(v));
+        return 0;
+    }
+}
+
+int shmring_write(struct shmring *r, const void *buf, size_t len) {
+    const char *src = buf;
+    uint64_t head = r->hdr->head;
+    while(len > 0) {
+        uint64_t tail = __atomic_load_n(&r->hdr->tail, __ATOMIC_ACQUIRE);
+        size_t room = r->cap - (size_t)(head - tail);
+        if(room == 0) {
+            if(ring_wait(r, &r->hdr->space_wait, &r->hdr->tail, tail, r->space) < 0) return -1;
+            continue;
+        }
+        size_t n = len < room ? len : room;
+        if(n > SHMRING_STEP) n = SHMRING_STEP;
+        size_t off = head & (r->cap - 1), first = r->cap - off < n ? r->cap - off : n;
+        memcpy(r->data + off, src, first);
+        memcpy(r->data, src + first, n - first);
+        head += n;
+        __atomic_store_n(&r->hdr->head, head, __ATOMIC_SEQ_CST);
+        ring_signal(&r->hdr->ready_wait, r->ready);
+        src += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// wait for data and return the readable run that does not wrap
+static size_t ring_peek(struct shmring *r, char **p) {
+    for(;;) {
+        uint64_t tail = r->hdr->tail;
+        uint64_t head = __atomic_load_n(&r->hdr->head, __ATOMIC_ACQUIRE);
+        if(head != tail) {
+            size_t off = tail & (r->cap - 1), n = (size_t)(head - tail);
+            *p = r->data + off;
+            return r->cap - off < n ? r->cap - off : n;
+        }
+        if(ring_wait(r, &r->hdr->ready_wait, &r->hdr->head, head, r->ready) < 0) return 0;
+    }
+}
+
+static void ring_consume(struct shmring *r, size_t n) {
+    __atomic_store_n(&r->hdr->tail, r->hdr->tail + n, __ATOMIC_SEQ_CST);
+    ring_signal(&r->hdr->space_wait, r->space);
+}
+
+int shmring_read(struct shmring *r, void *buf, size_t len) {
+    char *dst = buf, *p;
+    while(len > 0) {
+        size_t n = ring_peek(r, &p);
+        if(n == 0) return -1;
+        if(n > len) n = len;
+        memcpy(dst, p, n);
+        ring_consume(r, n);
+        dst += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int shmring_read_fd(struct shmring *r, int fd, size_t len, uint32_t *crc) {
+    int ok = 1;
+    char *p;
+    while(len > 0) {
+        size_t n = ring_peek(r, &p);
+        if(n == 0) return -1;
+        if(n > len) n = len;
+        if(n > SHMRING_STEP) n = SHMRING_STEP;
+        if(crc) *crc = crc32c(*crc, p, n);
+        for(size_t w = 0; fd >= 0 && ok && w < n; ) {
+            ssize_t k = write(fd, p + w, n - w);
+            if(k <= 0) ok = 0;
+            else w += k;
+        }
+        ring_consume(r, n);
+        len -= n;
+    }
+    return ok ? 0 : -1;
+}
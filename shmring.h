@@ -0,0 +1,73 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : shmring.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Single-producer/single-consumer byte ring in a memfd shared by
+ *               S1 and a backend on the same host, with an eventfd each way to
+ *               wake the other side. Upload payloads go through it instead of
+ *               the Unix socket (Linux only).
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define SHMRING_SIZE (1024 * 1024)      // data bytes, a power of two
+
+/*
+ * head and tail count bytes ever written and read, so the ring is empty when
+ * they are equal and each is stored by one side only. A side about to sleep
+ * sets its wait flag first and the other side only signals the eventfd when
+ * it sees the flag, so a transfer that keeps both busy makes no syscalls.
+ * Each side's fields sit on their own cache line at the start of the memfd;
+ * the data starts one page in.
+ */
+struct shmring_hdr {
+    uint64_t head;                      // producer
+    uint32_t space_wait;                // producer sleeps on space
+    char pad1[52];
+    uint64_t tail;                      // consumer
+    uint32_t ready_wait;                // consumer sleeps on ready
+    char pad2[52];
+};
+
+struct shmring {
+    struct shmring_hdr *hdr;
+    char *data;
+    size_t cap;
+    int memfd;
+    int ready;                          // eventfd: producer published data
+    int space;                          // eventfd: consumer freed space
+    int peer;                           // control socket; readable or closed means abort
+};
+
+// make a new ring; -1 (and nothing open) if shared memory is not available
+int shmring_create(struct shmring *r, size_t cap);
+
+// map a ring made by the other side from its memfd, ready and space eventfds;
+// the descriptors belong to the ring from then on, even on failure
+int shmring_attach(struct shmring *r, const int fds[3]);
+
+// memfd, ready, space, in the order shmring_attach takes them
+void shmring_fds(const struct shmring *r, int fds[3]);
+
+// producer: copy len bytes in, waiting for space as needed; 0 when all went
+int shmring_write(struct shmring *r, const void *buf, size_t len);
+
+// consumer: take len bytes out into buf
+int shmring_read(struct shmring *r, void *buf, size_t len);
+
+// consumer: take len bytes out and write them to fd straight from the shared
+// pages (fd < 0 drops them), adding them to the CRC32C in *crc unless it is
+// NULL; keeps draining after a write error, -1 then
+int shmring_read_fd(struct shmring *r, int fd, size_t len, uint32_t *crc);
+
+void shmring_close(struct shmring *r);
+
+#endif
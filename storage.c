@@ -0,0 +1,539 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : storage.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Storage engine shared by the storage servers and S1. Every
+ *               call works on a base directory ("./S2") and a client path
+ *               ("~S1/dir/file.pdf"), so S1 can store a type in-process with
+ *               the same on-disk layout a backend would use.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <time.h>
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/xattr.h>
+#endif
+
+#include "storage.h"
+#include "crc32c.h"
+
+#define STORE_CHUNK (64 * 1024)
+
+// the checksum as an extended attribute, in hex so getfattr shows it
+static int crc_set(int fd, uint32_t crc) {
+    char hex[16];
+    int n = snprintf(hex, sizeof(hex), "%08x", crc);
+#if defined(__linux__)
+    return fsetxattr(fd, STORE_XATTR, hex, n, 0);
+#elif defined(__APPLE__)
+    return fsetxattr(fd, STORE_XATTR, hex, n, 0, 0);
+#else
+    (void)fd;
+    (void)n;
+    return -1;
+#endif
+}
+
+static int crc_get(int fd, uint32_t *crc) {
+    char hex[16];
+    ssize_t n = -1;
+#if defined(__linux__)
+    n = fgetxattr(fd, STORE_XATTR, hex, sizeof(hex) - 1);
+#elif defined(__APPLE__)
+    n = fgetxattr(fd, STORE_XATTR, hex, sizeof(hex) - 1, 0, 0);
+#else
+    (void)fd;
+#endif
+    if(n != 8) return -1;
+    hex[n] = '\0';
+    char *end;
+    *crc = strtoul(hex, &end, 16);
+    return *end ? -1 : 0;
+}
+
+void store_path(const char *base, const char *rel, char *out, size_t size) {
+    const char *subpath = strstr(rel, "~S1");
+    snprintf(out, size, "%s%s", base, subpath ? subpath + 3 : rel);
+}
+
+int store_mkdirs(const char *path) {
+    char tmp[600];
+    snprintf(tmp, sizeof(tmp), "%s", path);
+    for(char *p = tmp + 1; *p; p++) {
+        if(*p != '/') continue;
+        *p = '\0';
+        if(mkdir(tmp, 0755) < 0 && errno != EEXIST)
+            return -1;
+        *p = '/';
+    }
+    return mkdir(tmp, 0755) < 0 && errno != EEXIST ? -1 : 0;
+}
+
+int store_create(const char *base, const char *dest, const char *filename, int keep,
+                 char *path, size_t psize, char *tmppath, size_t tsize) {
+    char dir[512];
+    store_path(base, dest, dir, sizeof(dir));
+    store_mkdirs(dir);
+    snprintf(path, psize, "%s/%s", dir, filename);
+    if(keep && access(path, F_OK) == 0)
+        return -2;
+    snprintf(tmppath, tsize, "%s.tmp%d", path, (int)getpid());
+    return open(tmppath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+int store_commit(int fd, const char *tmppath, const char *path, int ok, uint32_t crc) {
+    // without attributes the checksum is worked out again on download
+    if(ok) crc_set(fd, crc);
+    if(close(fd) < 0) ok = 0;
+    if(ok && rename(tmppath, path) == 0)
+        return 0;
+    unlink(tmppath);
+    return -1;
+}
+
+int store_recv(const char *base, const char *dest, const char *filename, int sock, size_t size,
+               int keep, char *path, size_t psize) {
+    char tmppath[620], *buf = malloc(STORE_CHUNK);
+    if(!buf) return -1;
+    int fd = store_create(base, dest, filename, keep, path, psize, tmppath, sizeof(tmppath));
+    size_t got = 0;
+    int ok = 1, sane = 1;
+    uint32_t crc = 0, net_crc;
+    // keep reading after a write error so the connection stays in step
+    while(got < size) {
+        ssize_t n = recv(sock, buf, size - got < STORE_CHUNK ? size - got : STORE_CHUNK, 0);
+        if(n <= 0) { ok = sane = 0; break; }
+        got += n;
+        crc = crc32c(crc, buf, n);
+        for(ssize_t w = 0; fd >= 0 && ok && w < n; ) {
+            ssize_t k = write(fd, buf + w, n - w);
+            if(k <= 0) ok = 0;
+            else w += k;
+        }
+    }
+    free(buf);
+    if(sane && size > 0 && recv(sock, &net_crc, sizeof(net_crc), MSG_WAITALL) != sizeof(net_crc))
+        ok = sane = 0;
+    int bad = sane && size > 0 && ntohl(net_crc) != crc;
+    if(fd == -2) return sane ? 1 : -1;
+    if(fd < 0) return -1;
+    if(bad) {
+        store_commit(fd, tmppath, path, 0, 0);
+        return 2;
+    }
+    return store_commit(fd, tmppath, path, ok, crc);
+}
+
+int store_put(const char *base, const char *dest, const char *filename, const void *data, size_t size,
+              int keep, char *path, size_t psize) {
+    char tmppath[620];
+    int fd = store_create(base, dest, filename, keep, path, psize, tmppath, sizeof(tmppath));
+    if(fd == -2) return 1;
+    if(fd < 0) return -1;
+    int ok = 1;
+    for(size_t w = 0; ok && w < size; ) {
+        ssize_t k = write(fd, (const char *)data + w, size - w);
+        if(k <= 0) ok = 0;
+        else w += k;
+    }
+    return store_commit(fd, tmppath, path, ok, crc32c(0, data, size));
+}
+
+int store_open(const char *base, const char *rel, struct stat *st, char *path, size_t psize) {
+    store_path(base, rel, path, psize);
+    int fd = open(path, O_RDONLY);
+    if(fd >= 0 && fstat(fd, st) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int store_crc(int fd, off_t size, uint32_t *crc) {
+    if(crc_get(fd, crc) == 0)
+        return 0;
+    char *buf = malloc(STORE_CHUNK);
+    if(!buf) return -1;
+    uint32_t c = 0;
+    off_t off = 0;
+    while(off < size) {
+        ssize_t n = pread(fd, buf, size - off < STORE_CHUNK ? size - off : STORE_CHUNK, off);
+        if(n <= 0) break;
+        c = crc32c(c, buf, n);
+        off += n;
+    }
+    free(buf);
+    if(off < size) return -1;
+    // a read-only descriptor is enough to set it
+    crc_set(fd, c);
+    *crc = c;
+    return 0;
+}
+
+int store_remove(const char *base, const char *rel, char *path, size_t psize) {
+    store_path(base, rel, path, psize);
+    return remove(path);
+}
+
+int pathlist_add(struct pathlist *l, const char *path) {
+    if(l->n == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 256;
+        char **v = realloc(l->v, cap * sizeof(*v));
+        if(!v) return -1;
+        l->v = v;
+        l->cap = cap;
+    }
+    if(!(l->v[l->n] = strdup(path))) return -1;
+    l->n++;
+    return 0;
+}
+
+int pathlist_split(struct pathlist *l, const char *text, size_t len) {
+    const char *end = text + len;
+    while(text < end) {
+        const char *nl = memchr(text, '\n', end - text);
+        size_t n = nl ? (size_t)(nl - text) : (size_t)(end - text);
+        char path[1024];
+        if(n > 0 && n < sizeof(path)) {
+            memcpy(path, text, n);
+            path[n] = '\0';
+            if(pathlist_add(l, path) < 0) return -1;
+        }
+        text += n + 1;
+    }
+    return 0;
+}
+
+void pathlist_free(struct pathlist *l) {
+    for(size_t i = 0; i < l->n; i++)
+        free(l->v[i]);
+    free(l->v);
+    l->v = NULL;
+    l->n = l->cap = 0;
+}
+
+int store_match(const char *pattern, const char *path) {
+    size_t plen = strlen(pattern);
+    if(plen && pattern[plen - 1] == '/')
+        return strncmp(path, pattern, plen) == 0;
+    return fnmatch(pattern, path, FNM_PATHNAME) == 0;
+}
+
+// a temporary file of an upload still being written ("f.pdf.tmp1234")
+static int is_tmp(const char *name) {
+    const char *t = strstr(name, ".tmp");
+    if(!t) return 0;
+    for(t += 4; *t; t++)
+        if(*t < '0' || *t > '9') return 0;
+    return 1;
+}
+
+// files below dir, depth levels down (-1 for all), whose client path matches
+static void find_walk(const char *base, const char *dir, int depth, const char *pattern, struct pathlist *out) {
+    DIR *d = opendir(dir);
+    if(!d) return;
+    size_t blen = strlen(base);
+    struct dirent *e;
+    while((e = readdir(d)) != NULL) {
+        if(strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0 || is_tmp(e->d_name))
+            continue;
+        char path[1024];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        if(lstat(path, &st) < 0)
+            continue;
+        if(S_ISDIR(st.st_mode)) {
+            // packed files are found through the index
+            if(depth != 1 && strcmp(e->d_name, ".pack") != 0)
+                find_walk(base, path, depth < 0 ? -1 : depth - 1, pattern, out);
+        } else if(S_ISREG(st.st_mode)) {
+            char client[1100];
+            snprintf(client, sizeof(client), "~S1%s", path + blen);
+            if(store_match(pattern, client))
+                pathlist_add(out, client);
+        }
+    }
+    closedir(d);
+}
+
+int store_find(const char *base, const char *pattern, struct pathlist *out) {
+    if(strncmp(pattern, "~S1/", 4) != 0)
+        return -1;
+    // start from the directory above the first wildcard; a glob cannot reach
+    // further down than it has slashes after that
+    char top[512], dir[600];
+    size_t cut = strcspn(pattern, "*?[");
+    snprintf(top, sizeof(top), "%.*s", (int)cut, pattern);
+    *strrchr(top, '/') = '\0';
+    int depth = -1;
+    if(pattern[cut]) {
+        depth = 1;
+        for(const char *p = pattern + strlen(top) + 1; *p; p++)
+            depth += *p == '/';
+    } else if(pattern[strlen(pattern) - 1] != '/') {
+        // a plain path is one file
+        struct stat st;
+        store_path(base, pattern, dir, sizeof(dir));
+        if(stat(dir, &st) == 0 && S_ISREG(st.st_mode))
+            pathlist_add(out, pattern);
+        return 0;
+    }
+    store_path(base, top, dir, sizeof(dir));
+    find_walk(base, dir, depth, pattern, out);
+    return 0;
+}
+
+struct rm_batch {
+    const char *base;
+    char *const *rels;
+    size_t n, next;
+    signed char *status;
+};
+
+#define RM_GRAB 64      // paths a thread takes at a time
+
+static void *rm_worker(void *arg) {
+    struct rm_batch *b = arg;
+    size_t i;
+    while((i = __atomic_fetch_add(&b->next, RM_GRAB, __ATOMIC_RELAXED)) < b->n) {
+        size_t end = i + RM_GRAB < b->n ? i + RM_GRAB : b->n;
+        for(; i < end; i++) {
+            char path[600];
+            store_path(b->base, b->rels[i], path, sizeof(path));
+            b->status[i] = unlink(path) == 0 ? 0 : errno == ENOENT || errno == ENOTDIR ? 1 : -1;
+        }
+    }
+    return NULL;
+}
+
+void store_remove_batch(const char *base, char *const *rels, size_t n, signed char *status) {
+    struct rm_batch b = {base, rels, n, 0, status};
+    pthread_t tids[STORE_RM_THREADS];
+    int started = 0;
+    // each unlink waits on the disk, so several keep it busy
+    while(n >= STORE_RM_SERIAL && started < STORE_RM_THREADS - 1 &&
+          pthread_create(&tids[started], NULL, rm_worker, &b) == 0)
+        started++;
+    rm_worker(&b);
+    for(int i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+}
+
+int store_tar(const char *base, const struct timespec *since, const char *tarname) {
+    char cmdline[700], newer[64] = "";
+    // tar's --newer goes by ctime, which the rename of a stored file sets
+    if(since)
+        snprintf(newer, sizeof(newer), "--newer=@%lld.%09ld ", (long long)since->tv_sec, since->tv_nsec);
+    // packed files (.pack) are added by pack_tar
+    snprintf(cmdline, sizeof(cmdline), "tar -cf %s --exclude=.pack %s%s >/dev/null 2>&1", tarname, newer, base);
+    system(cmdline);
+    return access(tarname, F_OK);
+}
+
+int store_listing_parse(const char *cmdline, struct store_listing *l) {
+    char buf[2048], *save, *tok;
+    memset(l, 0, sizeof(*l));
+    snprintf(buf, sizeof(buf), "%s", cmdline);
+    strtok_r(buf, " \t\r\n", &save);      // the command
+    while((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+        if(strcmp(tok, "-r") == 0) {
+            l->recursive = 1;
+        } else if(strcmp(tok, "-l") == 0) {
+            l->details = 1;
+        } else if(strcmp(tok, "-g") == 0 || strcmp(tok, "-n") == 0 || strcmp(tok, "-c") == 0) {
+            char *v = strtok_r(NULL, " \t\r\n", &save);
+            if(!v) return -1;
+            if(tok[1] == 'g') snprintf(l->glob, sizeof(l->glob), "%s", v);
+            else if(tok[1] == 'c') snprintf(l->after, sizeof(l->after), "%s", v);
+            else if((l->limit = atol(v)) <= 0) return -1;
+        } else if(!l->dir[0] && strncmp(tok, "~S1", 3) == 0 && (tok[3] == '\0' || tok[3] == '/')) {
+            snprintf(l->dir, sizeof(l->dir), "%s", tok);
+        } else {
+            return -1;
+        }
+    }
+    // "~S1/a/" is "~S1/a"
+    size_t n = strlen(l->dir);
+    while(n > 3 && l->dir[n - 1] == '/')
+        l->dir[--n] = '\0';
+    return n ? 0 : -1;
+}
+
+int store_pathcmp(const char *a, const char *b) {
+    const unsigned char *x = (const unsigned char *)a, *y = (const unsigned char *)b;
+    while(*x && *x == *y) {
+        x++;
+        y++;
+    }
+    int kx = !*x ? 0 : *x == '/' ? 1 : *x + 1;
+    int ky = !*y ? 0 : *y == '/' ? 1 : *y + 1;
+    return kx - ky;
+}
+
+int store_listed(const struct store_listing *l, const char *path) {
+    size_t dlen = strlen(l->dir);
+    if(strncmp(path, l->dir, dlen) != 0 || path[dlen] != '/')
+        return 0;
+    const char *name = strrchr(path, '/') + 1;
+    if(!l->recursive && name != path + dlen + 1)
+        return 0;
+    if(l->glob[0] && fnmatch(l->glob, name, 0) != 0)
+        return 0;
+    return !l->after[0] || store_pathcmp(path, l->after) > 0;
+}
+
+int store_listing_line(const struct store_listing *l, const struct store_file *f, char *out, size_t size) {
+    int n;
+    if(l->details) {
+        char when[32];
+        time_t t = f->mtime;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", &tm);
+        n = snprintf(out, size, "%s\t%lld\t%s\n", f->path, f->size, when);
+    } else {
+        n = snprintf(out, size, "%s\n", f->path);
+    }
+    return n < (int)size ? n : (int)size - 1;
+}
+
+// one directory being listed: its names, sorted, and how far through them
+struct iter_dir {
+    char **names;
+    size_t n, next;
+    size_t plen;                        // its client path's length
+};
+
+struct store_iter {
+    char base[256];
+    struct store_listing l;
+    struct iter_dir *dirs;
+    int depth, cap;
+    char path[1100];                    // client path of the current name
+    struct store_file file;
+};
+
+static int cmp_name(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// start on the directory at it->path
+static void iter_push(struct store_iter *it) {
+    char dir[1400];
+    store_path(it->base, it->path, dir, sizeof(dir));
+    DIR *d = opendir(dir);
+    if(!d) return;
+    if(it->depth == it->cap) {
+        int cap = it->cap ? it->cap * 2 : 16;
+        struct iter_dir *dirs = realloc(it->dirs, cap * sizeof(*dirs));
+        if(!dirs) {
+            closedir(d);
+            return;
+        }
+        it->dirs = dirs;
+        it->cap = cap;
+    }
+    struct iter_dir *f = &it->dirs[it->depth++];
+    memset(f, 0, sizeof(*f));
+    f->plen = strlen(it->path);
+    size_t cap = 0;
+    struct dirent *e;
+    while((e = readdir(d)) != NULL) {
+        if(strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0 || is_tmp(e->d_name))
+            continue;
+        if(f->n == cap) {
+            cap = cap ? cap * 2 : 64;
+            char **names = realloc(f->names, cap * sizeof(*names));
+            if(!names) break;
+            f->names = names;
+        }
+        if(!(f->names[f->n] = strdup(e->d_name))) break;
+        f->n++;
+    }
+    closedir(d);
+    qsort(f->names, f->n, sizeof(*f->names), cmp_name);
+}
+
+struct store_iter *store_iter_open(const char *base, const struct store_listing *l) {
+    struct store_iter *it = calloc(1, sizeof(*it));
+    if(!it) return NULL;
+    snprintf(it->base, sizeof(it->base), "%s", base);
+    it->l = *l;
+    snprintf(it->path, sizeof(it->path), "%s", l->dir);
+    iter_push(it);
+    return it;
+}
+
+const struct store_file *store_iter_next(struct store_iter *it) {
+    while(it->depth > 0) {
+        struct iter_dir *d = &it->dirs[it->depth - 1];
+        if(d->next == d->n) {
+            for(size_t i = 0; i < d->n; i++)
+                free(d->names[i]);
+            free(d->names);
+            it->depth--;
+            continue;
+        }
+        snprintf(it->path + d->plen, sizeof(it->path) - d->plen, "/%s", d->names[d->next++]);
+        char full[1400];
+        struct stat st;
+        store_path(it->base, it->path, full, sizeof(full));
+        if(lstat(full, &st) < 0)
+            continue;
+        if(S_ISDIR(st.st_mode)) {
+            // packed files are listed from the index; a directory wholly
+            // before the cursor is never read
+            size_t plen = strlen(it->path);
+            const char *after = it->l.after;
+            if(!it->l.recursive || strcmp(it->path, "~S1/.pack") == 0)
+                continue;
+            if(after[0] && !(strncmp(after, it->path, plen) == 0 && after[plen] == '/') &&
+               store_pathcmp(it->path, after) < 0)
+                continue;
+            iter_push(it);
+            continue;
+        }
+        if(!S_ISREG(st.st_mode) || !store_listed(&it->l, it->path))
+            continue;
+        it->file.path = it->path;
+        it->file.size = st.st_size;
+        it->file.mtime = st.st_mtime;
+        return &it->file;
+    }
+    return NULL;
+}
+
+void store_iter_close(struct store_iter *it) {
+    if(!it) return;
+    while(it->depth > 0) {
+        struct iter_dir *d = &it->dirs[--it->depth];
+        for(size_t i = 0; i < d->n; i++)
+            free(d->names[i]);
+        free(d->names);
+    }
+    free(it->dirs);
+    free(it);
+}
+
+FILE *store_lsall(const char *base) {
+    char find_cmd[700];
+    snprintf(find_cmd, sizeof(find_cmd),
+             "cd %s 2>/dev/null && find . -type f ! -name '*.tmp[0-9]*' ! -path './.pack/*' | cut -c2-", base);
+    return popen(find_cmd, "r");
+}
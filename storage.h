@@ -0,0 +1,146 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : storage.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Storage engine shared by the storage servers and S1. Every
+ *               call works on a base directory ("./S2") and a client path
+ *               ("~S1/dir/file.pdf"), so S1 can store a type in-process with
+ *               the same on-disk layout a backend would use.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define STORE_XATTR "user.w25.crc32c"  // where a file's checksum is kept
+#define STORE_RM_THREADS 4              // unlinks in flight in store_remove_batch
+#define STORE_RM_SERIAL  256            // batches smaller than this use one thread
+
+// a growing list of client paths
+struct pathlist {
+    char **v;
+    size_t n, cap;
+};
+
+int pathlist_add(struct pathlist *l, const char *path);
+
+// add the lines of a removem list ("~S1/a.txt\n~S1/b.pdf\n"), skipping empty ones
+int pathlist_split(struct pathlist *l, const char *text, size_t len);
+
+void pathlist_free(struct pathlist *l);
+
+// path of a client path under base, "~S1" stripped
+void store_path(const char *base, const char *rel, char *out, size_t size);
+
+// mkdir -p
+int store_mkdirs(const char *path);
+
+/*
+ * Store size bytes read from sock as dest/filename, through a temporary file
+ * renamed into place so readers holding the old file keep a whole copy. The
+ * CRC32C trailer after the data is read and checked before the rename, and
+ * kept with the file. With keep set an existing file is left alone (the data
+ * is still read). Returns 0 when stored, 1 when kept, 2 when the data did not
+ * match its checksum, -1 on error; the final path goes in path.
+ */
+int store_recv(const char *base, const char *dest, const char *filename, int sock, size_t size,
+               int keep, char *path, size_t psize);
+
+// the same from memory
+int store_put(const char *base, const char *dest, const char *filename, const void *data, size_t size,
+              int keep, char *path, size_t psize);
+
+// the two halves of the above for data arriving some other way: store_create
+// makes the directory and a temporary file next to path and returns it open
+// for writing (-2 when keep found a file, -1 on error); store_commit keeps
+// crc with it, closes it and renames it into place if ok, else removes it,
+// 0 when stored
+int store_create(const char *base, const char *dest, const char *filename, int keep,
+                 char *path, size_t psize, char *tmppath, size_t tsize);
+int store_commit(int fd, const char *tmppath, const char *path, int ok, uint32_t crc);
+
+// open a stored file for reading; descriptor or -1
+int store_open(const char *base, const char *rel, struct stat *st, char *path, size_t psize);
+
+// the CRC32C of a stored file: the one kept with it, or for files stored
+// before checksums (or where the filesystem keeps no attributes) read from
+// the file and kept for next time; 0 or -1
+int store_crc(int fd, off_t size, uint32_t *crc);
+
+int store_remove(const char *base, const char *rel, char *path, size_t psize);
+
+// whether a client path matches a removem pattern: one ending in '/' takes
+// everything below that directory, anything else is a glob in which '*' and
+// '?' stay within one directory
+int store_match(const char *pattern, const char *path);
+
+// add the client path ("~S1/...") of every stored file matching pattern;
+// only the part of the tree the pattern can reach is walked. 0 or -1
+int store_find(const char *base, const char *pattern, struct pathlist *out);
+
+// remove n client paths, up to STORE_RM_THREADS unlinks at a time; status[i]
+// becomes 0 when removed, 1 when there was no such file, -1 when it failed
+void store_remove_batch(const char *base, char *const *rels, size_t n, signed char *status);
+
+// tar of the whole store into tarname, or with since of the files stored
+// from then on (directories are always in it)
+int store_tar(const char *base, const struct timespec *since, const char *tarname);
+
+/*
+ * Listings (dispfnames). Every store lists its files in the same order, byte
+ * order with '/' before anything else, which is the order a walk taking each
+ * directory's names sorted finds them in; S1 merges the stores' lists on
+ * that. A listing goes one directory at a time and never holds more than
+ * the directories it is inside, so it can run over any size of tree.
+ */
+
+// what to list, from "dispfnames <dir> [-r] [-l] [-g glob] [-n count] [-c cursor]"
+struct store_listing {
+    char dir[512];          // client directory, "~S1/a"
+    int recursive;          // -r: the whole subtree, else only the files directly in dir
+    int details;            // -l: size and modification time columns
+    char glob[256];         // -g: only file names matching this, "" for all
+    long limit;             // -n: at most this many files, 0 for no limit
+    char after[1024];       // -c: only paths after this one, the last of the previous page
+};
+
+// one listed file
+struct store_file {
+    const char *path;       // client path, "~S1/a/b.pdf"
+    long long size;
+    long long mtime;
+};
+
+// parse a dispfnames command line; 0 or -1
+int store_listing_parse(const char *cmdline, struct store_listing *l);
+
+// the listing order
+int store_pathcmp(const char *a, const char *b);
+
+// whether a file by that client path belongs in the listing
+int store_listed(const struct store_listing *l, const char *path);
+
+// the listing line of a file: its path, then with details its size and
+// modification time (UTC) separated by tabs; the length written
+int store_listing_line(const struct store_listing *l, const struct store_file *f, char *out, size_t size);
+
+// walk the loose files of a listing in order; next gives NULL at the end.
+// open gives NULL when there is no memory, an unreadable dir lists nothing
+struct store_iter;
+struct store_iter *store_iter_open(const char *base, const struct store_listing *l);
+const struct store_file *store_iter_next(struct store_iter *it);
+void store_iter_close(struct store_iter *it);
+
+// every stored file relative to base, one per line (for rebalance); pclose it
+FILE *store_lsall(const char *base);
+
+#endif
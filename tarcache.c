@@ -0,0 +1,641 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : tarcache.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : The downltar archive of a store, kept between requests. Files
+ *               stored since are appended to it and a removal marks it stale,
+ *               so an archive of an unchanged store is one sendfile with no
+ *               directory walk. Asked for since a snapshot token, it holds
+ *               only what changed from then on.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "tarcache.h"
+#include "crc32c.h"
+#include "fdpass.h"
+
+// slots are claimed by store, 0 -> 1 while it is set up, then 2
+struct slot {
+    char base[256];
+    char path[320];                 // the archive
+    int used;
+    pthread_mutex_t lock;           // robust: appends and publishing a build
+    uint64_t gen;                   // changes to the store
+    uint64_t built;                 // the change the archive is up to, 0 for none
+    off_t body;                     // bytes before the end-of-archive blocks
+    off_t grown;                    // of those, appended since the build
+    uint32_t crc;                   // their CRC32C
+    unsigned long hits, builds, appends, deltas;
+};
+
+static struct tarcache {
+    int held;                       // not current for anyone, see tarcache_hold
+    struct slot slots[TARCACHE_SLOTS];
+} *shared;
+
+static struct slot *slots;
+static int (*builder)(const char *base, const struct timespec *since, const char *tarname);
+static pid_t owner;
+
+// archives of servers that are gone, the same names with another pid
+static void sweep(void) {
+    DIR *d = opendir(".");
+    if(!d) return;
+    struct dirent *e;
+    while((e = readdir(d)) != NULL) {
+        const char *c = strstr(e->d_name, ".cache.");
+        int pid, end = 0;
+        if(c && sscanf(c, ".cache.%d.tar%n", &pid, &end) == 1 && c[end] == '\0' &&
+           pid > 0 && kill(pid, 0) < 0 && errno == ESRCH)
+            unlink(e->d_name);
+    }
+    closedir(d);
+}
+
+static void cleanup(void) {
+    // exit handlers are inherited by every fork, only the server removes them
+    if(getpid() != owner) return;
+    for(int i = 0; i < TARCACHE_SLOTS; i++)
+        if(__atomic_load_n(&slots[i].used, __ATOMIC_ACQUIRE) == 2)
+            unlink(slots[i].path);
+}
+
+int tarcache_init(int (*build)(const char *base, const struct timespec *since, const char *tarname)) {
+    shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(shared == MAP_FAILED) {
+        shared = NULL;
+        return -1;
+    }
+    slots = shared->slots;
+    builder = build;
+    owner = getpid();
+    sweep();
+    atexit(cleanup);
+    return 0;
+}
+
+static struct slot *find(const char *base) {
+    for(int i = 0; slots && i < TARCACHE_SLOTS; i++)
+        if(__atomic_load_n(&slots[i].used, __ATOMIC_ACQUIRE) == 2 && strcmp(slots[i].base, base) == 0)
+            return &slots[i];
+    return NULL;
+}
+
+static struct slot *claim(const char *base, const char *name) {
+    struct slot *s = find(base);
+    for(int i = 0; slots && !s && i < TARCACHE_SLOTS; i++) {
+        struct slot *f = &slots[i];
+        int expected = 0;
+        if(!__atomic_compare_exchange_n(&f->used, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            // taken meanwhile, maybe for this store
+            while(__atomic_load_n(&f->used, __ATOMIC_ACQUIRE) == 1)
+                usleep(100);
+            if(strcmp(f->base, base) == 0)
+                s = f;
+            continue;
+        }
+        snprintf(f->base, sizeof(f->base), "%s", base);
+        snprintf(f->path, sizeof(f->path), "%s.cache.%d.tar", name, (int)owner);
+        pthread_mutexattr_t ma;
+        pthread_mutexattr_init(&ma);
+        pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&ma, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&f->lock, &ma);
+        pthread_mutexattr_destroy(&ma);
+        f->gen = 1;
+        __atomic_store_n(&f->used, 2, __ATOMIC_RELEASE);
+        s = f;
+    }
+    return s;
+}
+
+static void lock(struct slot *s) {
+    if(pthread_mutex_lock(&s->lock) == EOWNERDEAD) {
+        // died appending: the file's tail cannot be trusted
+        s->built = 0;
+        pthread_mutex_consistent(&s->lock);
+    }
+}
+
+static int current(const struct slot *s) {
+    return s->built != 0 && s->built == s->gen && !__atomic_load_n(&shared->held, __ATOMIC_ACQUIRE);
+}
+
+/* tar */
+
+static void tar_octal(char *field, size_t width, unsigned long long v) {
+    snprintf(field, width, "%0*llo", (int)width - 1, v);
+}
+
+static void tar_header(char *h, const char *name, unsigned long long size, long long mtime, char type) {
+    memset(h, 0, 512);
+    snprintf(h, 100, "%s", name);
+    tar_octal(h + 100, 8, 0644);
+    tar_octal(h + 108, 8, 0);
+    tar_octal(h + 116, 8, 0);
+    tar_octal(h + 124, 12, size);
+    tar_octal(h + 136, 12, mtime > 0 ? mtime : 0);
+    h[156] = type;
+    memcpy(h + 257, "ustar", 6);
+    memcpy(h + 263, "00", 2);
+    memset(h + 148, ' ', 8);
+    unsigned sum = 0;
+    for(int i = 0; i < 512; i++)
+        sum += (unsigned char)h[i];
+    snprintf(h + 148, 8, "%06o", sum);
+}
+
+// offset of the end-of-archive blocks, or -1
+static off_t tar_end(int fd) {
+    unsigned char h[512];
+    off_t pos = 0;
+    while(pread(fd, h, 512, pos) == 512) {
+        if(h[0] == '\0')
+            return pos;
+        // octal, or GNU base-256 for the very large
+        unsigned long long size = 0;
+        int i = 124;
+        if(h[i] & 0x80) {
+            for(i = 125; i < 136; i++) size = (size << 8) | h[i];
+        } else {
+            while(i < 136 && h[i] == ' ') i++;
+            for(; i < 136 && h[i] >= '0' && h[i] <= '7'; i++) size = size * 8 + (h[i] - '0');
+        }
+        pos += 512 + (off_t)((size + 511) / 512 * 512);
+    }
+    return -1;
+}
+
+// write len bytes at *pos, adding them to *crc
+static int put(int fd, const void *buf, size_t len, off_t *pos, uint32_t *crc) {
+    for(size_t w = 0; w < len; ) {
+        ssize_t n = pwrite(fd, (const char *)buf + w, len - w, *pos + w);
+        if(n <= 0) return -1;
+        w += n;
+    }
+    *crc = crc32c(*crc, buf, len);
+    *pos += len;
+    return 0;
+}
+
+static int put_pad(int fd, unsigned long long size, off_t *pos, uint32_t *crc) {
+    static const char zero[512];
+    return size % 512 ? put(fd, zero, 512 - size % 512, pos, crc) : 0;
+}
+
+/*
+ * Append path as a member where the end-of-archive blocks start and write
+ * them again after it. Readers only ever send the body they were given, so
+ * nothing they read is overwritten.
+ */
+static int append(struct slot *s, const char *path, const void *data, size_t len) {
+    int src = -1;
+    struct stat st;
+    long long mtime = time(NULL);
+    if(!data) {
+        if((src = open(path, O_RDONLY)) < 0 || fstat(src, &st) < 0) {
+            if(src >= 0) close(src);
+            return -1;
+        }
+        len = st.st_size;
+        mtime = st.st_mtime;
+    }
+    int fd = len <= TARCACHE_APPEND_MAX ? open(s->path, O_WRONLY) : -1;
+    if(fd < 0) {
+        if(src >= 0) close(src);
+        return -1;
+    }
+    // tar drops the leading '/' of an absolute store too
+    const char *name = path;
+    while(*name == '/') name++;
+    size_t nlen = strlen(name);
+    off_t pos = s->body;
+    uint32_t crc = s->crc;
+    char h[512];
+    int rc = 0;
+    if(nlen >= 100) {
+        // GNU long name, like pack_tar
+        tar_header(h, "././@LongLink", nlen + 1, 0, 'L');
+        rc = put(fd, h, 512, &pos, &crc) < 0 || put(fd, name, nlen + 1, &pos, &crc) < 0 ||
+             put_pad(fd, nlen + 1, &pos, &crc) < 0 ? -1 : 0;
+    }
+    tar_header(h, name, len, mtime, '0');
+    if(rc == 0)
+        rc = put(fd, h, 512, &pos, &crc);
+    if(rc == 0 && data) {
+        rc = put(fd, data, len, &pos, &crc);
+    } else if(rc == 0) {
+        char buf[65536];
+        size_t done = 0;
+        while(rc == 0 && done < len) {
+            ssize_t n = read(src, buf, len - done < sizeof(buf) ? len - done : sizeof(buf));
+            rc = n > 0 ? put(fd, buf, n, &pos, &crc) : -1;
+            done += n > 0 ? n : 0;
+        }
+    }
+    if(rc == 0)
+        rc = put_pad(fd, len, &pos, &crc);
+    static const char end[TARCACHE_END];
+    uint32_t ignored = 0;
+    off_t tail = pos;
+    if(rc == 0)
+        rc = put(fd, end, sizeof(end), &tail, &ignored);
+    if(src >= 0) close(src);
+    if(close(fd) < 0 || rc < 0)
+        return -1;
+    s->grown += pos - s->body;
+    s->body = pos;
+    s->crc = crc;
+    return 0;
+}
+
+/*
+ * Build into a file of its own, trimmed to one pair of end-of-archive
+ * blocks (tar pads to a whole record), with the CRC32C of the rest.
+ * Returns it open, or -1.
+ */
+static int build(const char *base, const struct timespec *since, const char *tarname, off_t *body, uint32_t *crc) {
+    if(!builder || builder(base, since, tarname) < 0)
+        return -1;
+    int fd = open(tarname, O_RDWR);
+    off_t end = fd >= 0 ? tar_end(fd) : -1;
+    if(end < 0 || ftruncate(fd, end + TARCACHE_END) < 0) {
+        if(fd >= 0) close(fd);
+        unlink(tarname);
+        return -1;
+    }
+    char buf[65536];
+    uint32_t c = 0;
+    for(off_t pos = 0; pos < end; ) {
+        ssize_t n = pread(fd, buf, end - pos < (off_t)sizeof(buf) ? end - pos : (off_t)sizeof(buf), pos);
+        if(n <= 0) {
+            close(fd);
+            unlink(tarname);
+            return -1;
+        }
+        c = crc32c(c, buf, n);
+        pos += n;
+    }
+    *body = end;
+    *crc = c;
+    return fd;
+}
+
+/* removal log */
+
+// "./S2" -> "./S2.removed"
+static void log_path(const char *base, const char *suffix, char *out, size_t size) {
+    size_t n = strlen(base);
+    while(n > 1 && base[n - 1] == '/') n--;
+    snprintf(out, size, "%.*s%s", (int)n, base, suffix);
+}
+
+/*
+ * The log open and locked how (LOCK_SH or LOCK_EX), started with the time
+ * it covers from when there was none. The log is rotated by renaming it
+ * under an exclusive lock, so one that is not at the path any more once
+ * locked is let go and the new one opened. -1 when it cannot be.
+ */
+static int log_open(const char *base, int how) {
+    char path[320];
+    log_path(base, ".removed", path, sizeof(path));
+    while(1) {
+        int fd = open(path, O_RDWR | O_APPEND | O_CREAT, 0644);
+        struct stat st, now;
+        if(fd < 0 || flock(fd, how) < 0 || fstat(fd, &st) < 0) {
+            if(fd >= 0) close(fd);
+            return -1;
+        }
+        if(stat(path, &now) < 0 || now.st_ino != st.st_ino || now.st_dev != st.st_dev) {
+            close(fd);
+            continue;
+        }
+        if(st.st_size == 0 && flock(fd, LOCK_EX) == 0 && fstat(fd, &st) == 0 && st.st_size == 0) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            dprintf(fd, "since %lld.%09ld\n", (long long)ts.tv_sec, ts.tv_nsec);
+        }
+        if(flock(fd, how) < 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+static int ts_before(const struct timespec *a, const struct timespec *b) {
+    return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+// "<sec>.<nsec>" at *p, moving past it; 0 or -1
+static int ts_parse(const char **p, struct timespec *ts) {
+    char *end;
+    long long sec = strtoll(*p, &end, 10);
+    if(end == *p || *end != '.' || sec < 0)
+        return -1;
+    long nsec = strtol(end + 1, &end, 10);
+    ts->tv_sec = sec;
+    ts->tv_nsec = nsec;
+    *p = end;
+    return 0;
+}
+
+/*
+ * Write "removed <path>" for every removal of one log from since on to out,
+ * and the time it covers from to *from. The caller holds the current log,
+ * so the older generation cannot be rotated away meanwhile. 0, or -1 when
+ * the log cannot be read.
+ */
+static int log_read(FILE *fp, const struct timespec *since, struct timespec *from, FILE *out) {
+    char line[1200];
+    if(!fgets(line, sizeof(line), fp))
+        return -1;
+    const char *p = line + 6;
+    if(strncmp(line, "since ", 6) != 0 || ts_parse(&p, from) < 0)
+        return -1;
+    while(fgets(line, sizeof(line), fp)) {
+        struct timespec at;
+        p = line;
+        if(ts_parse(&p, &at) < 0 || *p != ' ' || !strchr(p, '\n'))
+            continue;   // a line cut short by a crash
+        if(!ts_before(&at, since))
+            fprintf(out, "removed %s", p + 1);
+    }
+    return 0;
+}
+
+int tarcache_since(const char *arg, struct timespec *since) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *end = strptime(arg, "%Y-%m-%dT%H:%M:%SZ", &tm);
+    if(end && *end == '\0') {
+        since->tv_sec = timegm(&tm);
+        since->tv_nsec = 0;
+        return 0;
+    }
+    // seconds, with up to nine digits of fraction
+    const char *p = arg;
+    long long sec = 0;
+    long nsec = 0;
+    int digits = 0;
+    for(; *p >= '0' && *p <= '9'; p++)
+        sec = sec * 10 + (*p - '0');
+    if(p == arg || p - arg > 18)
+        return -1;
+    if(*p == '.')
+        for(p++; *p >= '0' && *p <= '9' && digits < 9; p++, digits++)
+            nsec = nsec * 10 + (*p - '0');
+    if(*p)
+        return -1;
+    while(digits++ < 9)
+        nsec *= 10;
+    since->tv_sec = sec;
+    since->tv_nsec = nsec;
+    return 0;
+}
+
+/*
+ * The manifest of a snapshot taken now, with since of a delta from then on
+ * when the log covers it: the removals since, read under the log's lock so
+ * a removal is either before the token or in the next delta. NULL when
+ * there is no memory; *delta says which it is.
+ */
+static char *manifest(const char *base, const struct timespec *since, int *delta) {
+    char *text = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&text, &len);
+    if(!out) return NULL;
+    *delta = 0;
+    int fd = log_open(base, LOCK_SH);
+    struct timespec token;
+    clock_gettime(CLOCK_REALTIME, &token);
+    fprintf(out, "token %lld.%09ld\n", (long long)token.tv_sec, token.tv_nsec);
+    if(since && fd >= 0) {
+        char *removed = NULL;
+        size_t rlen = 0;
+        FILE *rm = open_memstream(&removed, &rlen);
+        char path[320];
+        struct timespec from, ignored;
+        log_path(base, ".removed.old", path, sizeof(path));
+        FILE *old = fopen(path, "r");
+        FILE *cur = fdopen(dup(fd), "r");
+        int ok = rm && cur && (!old || log_read(old, since, &from, rm) == 0) &&
+                 log_read(cur, since, old ? &ignored : &from, rm) == 0;
+        if(old) fclose(old);
+        if(cur) fclose(cur);
+        if(rm) fclose(rm);
+        if(ok && !ts_before(since, &from)) {
+            fprintf(out, "delta %lld.%09ld\n", (long long)since->tv_sec, since->tv_nsec);
+            fwrite(removed, 1, rlen, out);
+            *delta = 1;
+        }
+        free(removed);
+    }
+    if(fd >= 0) close(fd);
+    if(!*delta)
+        fprintf(out, "full\n");
+    if(fclose(out) != 0) {
+        free(text);
+        return NULL;
+    }
+    return text;
+}
+
+int tarcache_open(const char *base, const char *name, const struct timespec *since,
+                  off_t *body, uint32_t *crc, char **mf) {
+    int delta;
+    // before the archive, so what changes while it is made is in the next delta too
+    if((*mf = manifest(base, since, &delta)) == NULL)
+        return -1;
+    struct slot *s = claim(base, name);
+    char tarname[64];
+    if(delta) {
+        // stored a little before the token too, in case it raced the snapshot
+        struct timespec from = *since;
+        from.tv_sec = from.tv_sec > TARCACHE_SLACK ? from.tv_sec - TARCACHE_SLACK : 0;
+        snprintf(tarname, sizeof(tarname), "%s.%d.delta.tar", name, (int)getpid());
+        int fd = build(base, &from, tarname, body, crc);
+        if(fd >= 0)
+            unlink(tarname);
+        if(fd >= 0 && s)
+            __atomic_add_fetch(&s->deltas, 1, __ATOMIC_RELAXED);
+        if(fd < 0) {
+            free(*mf);
+            *mf = NULL;
+        }
+        return fd;
+    }
+    uint64_t gen = 0;
+    if(s) {
+        lock(s);
+        if(current(s)) {
+            int fd = open(s->path, O_RDONLY);
+            if(fd >= 0) {
+                *body = s->body;
+                *crc = s->crc;
+                s->hits++;
+                pthread_mutex_unlock(&s->lock);
+                return fd;
+            }
+            s->built = 0;
+        }
+        gen = s->gen;
+        pthread_mutex_unlock(&s->lock);
+    }
+    // per-process name so several requests can build at once
+    snprintf(tarname, sizeof(tarname), "%s.%d.tar", name, (int)getpid());
+    int fd = build(base, NULL, tarname, body, crc);
+    if(fd < 0) {
+        free(*mf);
+        *mf = NULL;
+        return -1;
+    }
+    int kept = 0;
+    if(s) {
+        lock(s);
+        s->builds++;
+        // nothing changed during the walk, so it is the store as it is now
+        if(s->gen == gen && rename(tarname, s->path) == 0) {
+            s->built = gen;
+            s->body = *body;
+            s->grown = 0;
+            s->crc = *crc;
+            kept = 1;
+        }
+        pthread_mutex_unlock(&s->lock);
+    }
+    if(!kept)
+        unlink(tarname);    // the descriptor keeps it for this request
+    return fd;
+}
+
+static int send_all(int sock, const void *buf, size_t len) {
+    for(size_t w = 0; w < len; ) {
+        ssize_t n = send(sock, (const char *)buf + w, len - w, 0);
+        if(n <= 0) return -1;
+        w += n;
+    }
+    return 0;
+}
+
+int tarcache_send(int sock, int fd, off_t body, uint32_t crc, const char *manifest) {
+    // the manifest is made per request, so it goes after the cached body
+    size_t mlen = strlen(manifest), pad = (512 - mlen % 512) % 512;
+    char h[512];
+    tarcache_manifest_header(h, mlen);
+    // the end blocks come from here, an append may be writing the file's own
+    static const char end[TARCACHE_END];
+    crc = crc32c(crc32c(crc32c(crc, h, sizeof(h)), manifest, mlen), end, pad);
+    uint32_t net_size = htonl(body + sizeof(h) + mlen + pad + TARCACHE_END),
+             net_crc = htonl(crc32c(crc, end, sizeof(end)));
+    if(send_all(sock, &net_size, sizeof(net_size)) < 0 || fdpass_sendfile(sock, fd, body) < 0 ||
+       send_all(sock, h, sizeof(h)) < 0 || send_all(sock, manifest, mlen) < 0 || send_all(sock, end, pad) < 0 ||
+       send_all(sock, end, sizeof(end)) < 0 || send_all(sock, &net_crc, sizeof(net_crc)) < 0)
+        return -1;
+    return 0;
+}
+
+void tarcache_manifest_header(char *h, size_t len) {
+    tar_header(h, TARCACHE_MANIFEST, len, time(NULL), '0');
+}
+
+void tarcache_add(const char *base, const char *path, const void *data, size_t len, int replaced) {
+    struct slot *s = find(base);
+    if(!s) return;
+    lock(s);
+    // a file stored again has its old copy in the archive, which would win
+    // S1's merge; past twice its built size the archive is built anew too
+    int was = current(s) && !replaced && s->grown <= s->body - s->grown;
+    s->gen++;
+    if(was && append(s, path, data, len) == 0) {
+        s->built = s->gen;
+        s->appends++;
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+void tarcache_hold(int on) {
+    if(!shared) return;
+    if(on) {
+        __atomic_store_n(&shared->held, 1, __ATOMIC_RELEASE);
+        return;
+    }
+    // whatever was built meanwhile may lack what the other instance did
+    for(int i = 0; i < TARCACHE_SLOTS; i++) {
+        struct slot *s = &slots[i];
+        if(__atomic_load_n(&s->used, __ATOMIC_ACQUIRE) != 2) continue;
+        lock(s);
+        s->gen++;
+        pthread_mutex_unlock(&s->lock);
+    }
+    __atomic_store_n(&shared->held, 0, __ATOMIC_RELEASE);
+}
+
+void tarcache_removed(const char *base, const char *rel) {
+    struct slot *s = find(base);
+    if(s) {
+        lock(s);
+        s->gen++;
+        pthread_mutex_unlock(&s->lock);
+    }
+    // logged after the archive went stale: a snapshot that still had the
+    // file was taken before this time
+    int fd = log_open(base, LOCK_EX);
+    if(fd < 0) return;
+    struct stat st;
+    if(fstat(fd, &st) == 0 && st.st_size > TARCACHE_LOG_MAX) {
+        // tokens from before the older generation get full archives from now on
+        char path[320], old[320];
+        log_path(base, ".removed", path, sizeof(path));
+        log_path(base, ".removed.old", old, sizeof(old));
+        if(rename(path, old) == 0) {
+            close(fd);
+            if((fd = log_open(base, LOCK_EX)) < 0) return;
+        }
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    dprintf(fd, "%lld.%09ld %s\n", (long long)ts.tv_sec, ts.tv_nsec, rel);
+    close(fd);
+}
+
+void tarcache_export(FILE *out) {
+    if(!slots) return;
+    static const struct {
+        const char *name, *help;
+    } series[] = {
+        {"w25_tar_cache_hits_total", "downltar requests served from the cached archive."},
+        {"w25_tar_cache_builds_total", "downltar requests that walked the store to build the archive."},
+        {"w25_tar_cache_appends_total", "Stored files appended to the cached archive."},
+        {"w25_tar_deltas_total", "downltar requests answered with what changed since a token."},
+    };
+    for(size_t k = 0; k < sizeof(series) / sizeof(series[0]); k++) {
+        fprintf(out, "# HELP %s %s\n# TYPE %s counter\n", series[k].name, series[k].help, series[k].name);
+        for(int i = 0; i < TARCACHE_SLOTS; i++) {
+            struct slot *s = &slots[i];
+            if(__atomic_load_n(&s->used, __ATOMIC_ACQUIRE) != 2) continue;
+            unsigned long v = k == 0 ? s->hits : k == 1 ? s->builds : k == 2 ? s->appends : s->deltas;
+            fprintf(out, "%s{store=\"%s\"} %lu\n", series[k].name, s->base, v);
+        }
+    }
+}
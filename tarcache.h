@@ -0,0 +1,100 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : tarcache.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : The downltar archive of a store, kept between requests. Files
+ *               stored since are appended to it and a removal marks it stale,
+ *               so an archive of an unchanged store is one sendfile with no
+ *               directory walk. Asked for since a snapshot token, it holds
+ *               only what changed from then on.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef TARCACHE_H
+#define TARCACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
+#define TARCACHE_SLOTS       8              // stores with a cached archive
+#define TARCACHE_END         1024           // the end-of-archive blocks
+#define TARCACHE_APPEND_MAX  (64L << 20)    // larger files mark the archive stale instead
+#define TARCACHE_MANIFEST    ".w25-snapshot"    // the member naming the snapshot
+#define TARCACHE_SLACK       2              // seconds before a token a delta also covers
+#define TARCACHE_LOG_MAX     (4L << 20)     // removal log size before it is rotated
+
+/*
+ * The archive is "<name>.cache.<pid>.tar" in the working directory, one per
+ * running server, and removed when it exits. It is built with the server's
+ * builder, then kept a whole tar: a new file is appended as a member after
+ * the last one, with the CRC32C of everything up to the end-of-archive
+ * blocks kept alongside, so serving it reads nothing but what is sent. A
+ * file stored again or removed cannot be appended, as S1's merge of
+ * replicas keeps the first member of a name: the next downltar builds the
+ * archive anew. So does one once appends have grown it past twice its
+ * built size, which drops any name two racing stores both appended.
+ * Requests that find it stale each build their own, and one built while
+ * the store changed is used once and not kept.
+ *
+ * Every archive ends with a TARCACHE_MANIFEST member:
+ *
+ *     token <sec>.<nsec>       when the snapshot was taken
+ *     full                     or: delta <sec>.<nsec>, what it covers from
+ *     removed ~S1/a/b.pdf      one per file removed in that time
+ *
+ * A downltar given the token (or any time) gets a delta: the files stored
+ * from TARCACHE_SLACK seconds before it on, so one racing the snapshot is
+ * sent twice rather than never, and the removals since, from a log kept
+ * beside the store ("./S2.removed") that is started with the first token.
+ * Removals apply before the files: a file removed and stored again is in
+ * both. A time from before the log answers with a full archive.
+ */
+
+// map the slots before the first fork; build makes a tar of a store, or with
+// since of the files stored from then on, into a file (0 or -1). Archives
+// left by servers that are gone are removed
+int tarcache_init(int (*build)(const char *base, const struct timespec *since, const char *tarname));
+
+// the since of "downltar <type> <since>": a token, seconds since the epoch
+// or a UTC time as dispfnames -l shows it ("2025-04-01T10:00:00Z"); 0 or -1
+int tarcache_since(const char *arg, struct timespec *since);
+
+/*
+ * The archive of the store under base, named after name ("pdffiles"), of
+ * everything or with since of what changed from then on: returns a
+ * descriptor holding it from offset 0, its length before the end-of-archive
+ * blocks and the CRC32C of those bytes, and in *manifest (malloc'd) the text
+ * of its manifest; -1 when it cannot be built
+ */
+int tarcache_open(const char *base, const char *name, const struct timespec *since,
+                  off_t *body, uint32_t *crc, char **manifest);
+
+// send an archive from tarcache_open as <size><tar><crc>, the manifest
+// added as its last member; 0 or -1
+int tarcache_send(int sock, int fd, off_t body, uint32_t crc, const char *manifest);
+
+// the tar header of a manifest of len bytes, for archives put together
+// elsewhere (S1's merge of the backends')
+void tarcache_manifest_header(char *h, size_t len);
+
+// a file was stored at path under base; data is its contents, or NULL to
+// read them from path. replaced says there was a file at path before
+void tarcache_add(const char *base, const char *path, const void *data, size_t len, int replaced);
+
+// a file under base was removed, by its client path
+void tarcache_removed(const char *base, const char *rel);
+
+// while on, no archive is current: another instance's workers (an old one
+// draining after a handoff) change the stores without this one seeing it.
+// Turning it off makes every archive built until then stale
+void tarcache_hold(int on);
+
+// series for the metrics endpoint
+void tarcache_export(FILE *out);
+
+#endif
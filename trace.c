@@ -0,0 +1,117 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : trace.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Request IDs and per-stage timing spans. S1 tags every command it
+ *               forwards with the client request's ID so the spans written by
+ *               S1 and the backends can be joined into one timeline.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "trace.h"
+
+static int trace_fd = -1;
+static char server_name[16];
+static unsigned int seq;
+
+// the request each thread is working on
+static __thread char cur_id[TRACE_ID_LEN];
+static __thread char cur_cmd[16];
+static __thread long cur_start = -1;
+
+int trace_open(const char *path, const char *server) {
+    snprintf(server_name, sizeof(server_name), "%s", server);
+    if(!path || !*path) return 0;
+    trace_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    return trace_fd < 0 ? -1 : 0;
+}
+
+long trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+// unique enough across workers and S1 instances: wall clock and pid mixed
+// into the high half, a per-process sequence number in the low half
+static void new_id(char *id) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint32_t hi = (uint32_t)(ts.tv_nsec ^ ts.tv_sec * 2654435761u) ^ (uint32_t)getpid() * 40503u;
+    uint32_t lo = __atomic_add_fetch(&seq, 1, __ATOMIC_RELAXED);
+    snprintf(id, TRACE_ID_LEN, "%08x%08x", hi, lo);
+}
+
+void trace_begin(const char *cmd, const char *id) {
+    trace_end();
+    if(id && *id)
+        trace_set_id(id);
+    else
+        new_id(cur_id);
+    snprintf(cur_cmd, sizeof(cur_cmd), "%s", cmd);
+    cur_start = trace_now();
+}
+
+void trace_end(void) {
+    if(cur_start < 0) return;
+    trace_span(cur_cmd, cur_start, "request");
+    cur_start = -1;
+}
+
+void trace_set_id(const char *id) {
+    snprintf(cur_id, sizeof(cur_id), "%s", id);
+}
+
+const char *trace_id(void) {
+    return cur_id;
+}
+
+void trace_span(const char *stage, long start_us, const char *detail) {
+    if(trace_fd < 0) return;
+    long now = trace_now();
+    char line[768], safe[512] = "";
+    // paths come from clients, keep the line valid JSON
+    if(detail) {
+        size_t i;
+        for(i = 0; detail[i] && i < sizeof(safe) - 1; i++)
+            safe[i] = detail[i] == '"' || detail[i] == '\\' || (unsigned char)detail[i] < 0x20 ? '_' : detail[i];
+        safe[i] = '\0';
+    }
+    int len = snprintf(line, sizeof(line),
+                       "{\"id\":\"%s\",\"server\":\"%s\",\"pid\":%d,\"stage\":\"%s\",\"start_us\":%ld,\"dur_us\":%ld,\"detail\":\"%s\"}\n",
+                       cur_id, server_name, (int)getpid(), stage, start_us, now - start_us, safe);
+    if(len > 0 && len < (int)sizeof(line))
+        (void)!write(trace_fd, line, len);
+}
+
+void trace_tag(char *out, size_t size, const char *cmd) {
+    if(trace_fd >= 0 && cur_id[0])
+        snprintf(out, size, "@%s %s", cur_id, cmd);
+    else
+        snprintf(out, size, "%s", cmd);
+}
+
+void trace_accept(char *buffer, char *id) {
+    id[0] = '\0';
+    if(buffer[0] != '@') return;
+    size_t n = strcspn(buffer + 1, " ");
+    if(n < TRACE_ID_LEN) {
+        memcpy(id, buffer + 1, n);
+        id[n] = '\0';
+    }
+    char *rest = buffer + 1 + n;
+    while(*rest == ' ')
+        rest++;
+    memmove(buffer, rest, strlen(rest) + 1);
+}
@@ -0,0 +1,53 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : trace.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Request IDs and per-stage timing spans. S1 tags every command it
+ *               forwards with the client request's ID so the spans written by
+ *               S1 and the backends can be joined into one timeline.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+
+#define TRACE_ID_LEN 17     // 16 hex digits
+
+/*
+ * Spans are appended as JSON lines to the trace file, one write() each so
+ * concurrent workers never interleave:
+ *
+ *   {"id":"…","server":"S1","pid":…,"stage":"connect","start_us":…,"dur_us":…,"detail":"S2"}
+ *
+ * start_us is CLOCK_MONOTONIC, comparable between servers on the same host.
+ * A forwarded command carries the ID as a "@<id> " prefix, which backends
+ * strip before parsing; it is only added while S1 is tracing.
+ */
+
+// open the trace file before forking; a NULL or empty path leaves tracing off
+int trace_open(const char *path, const char *server);
+
+// start a request on this thread, with the ID it was given or a new one;
+// trace_end writes its whole-request span named after the command
+void trace_begin(const char *cmd, const char *id);
+void trace_end(void);
+
+// adopt a request ID without starting a request (replica writer threads)
+void trace_set_id(const char *id);
+const char *trace_id(void);
+
+long trace_now(void);
+void trace_span(const char *stage, long start_us, const char *detail);
+
+// cmd with the current ID in front when tracing, for sending to a backend
+void trace_tag(char *out, size_t size, const char *cmd);
+
+// backends: remove a leading "@<id> " from a received command into id ("" if none)
+void trace_accept(char *buffer, char *id);
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : transfer.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : S1's data path: the socket and file copy loops every transfer
+ *               goes through, and forwarding an upload to a backend. Kept apart
+ *               from S1.c so the benchmarks run the same code.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "transfer.h"
+#include "bstat.h"
+#include "trace.h"
+#include "fdpass.h"
+#include "shmring.h"
+#include "crc32c.h"
+#include "lanes.h"
+
+// send all bytes
+ssize_t send_all(int sockfd, const void *buf, size_t len) {
+    size_t total = 0;
+    const char *p = buf;
+    while(total < len) {
+        ssize_t n = send(sockfd, p + total, len - total, 0);
+        if(n <= 0) return n;
+        total += n;
+    }
+    return total;
+}
+
+// receive all bytes
+ssize_t recv_all(int sockfd, void *buf, size_t len) {
+    size_t total = 0;
+    char *p = buf;
+    while(total < len) {
+        ssize_t n = recv(sockfd, p + total, len - total, 0);
+        if(n <= 0) return n;
+        total += n;
+    }
+    return total;
+}
+
+long send_file(FILE *fp, int sock, uint32_t *crc) {
+    char filebuf[BUFSIZE];
+    long total = 0;
+    size_t n;
+    while((n = fread(filebuf, 1, BUFSIZE, fp)) > 0) {
+        if(crc) *crc = crc32c(*crc, filebuf, n);
+        send(sock, filebuf, n, 0);
+        total += n;
+    }
+    return total;
+}
+
+long relay(int from, int to, long size) {
+    char tempbuf[BUFSIZE];
+    long total_received = 0;
+    while(total_received < size) {
+        // no further than size, the checksum after it is the caller's
+        long want = size - total_received < BUFSIZE ? size - total_received : BUFSIZE;
+        int rec = recv(from, tempbuf, want, 0);
+        if(rec <= 0) break;
+        send(to, tempbuf, rec, 0);
+        total_received += rec;
+    }
+    return total_received;
+}
+
+/*
+ * Rings to shm backends, made on first use and kept for the life of the
+ * process so later uploads to the same backend skip the setup and find the
+ * pages already faulted in. A transfer that fails drops its ring, since the
+ * other side may have stopped halfway through it.
+ */
+static struct {
+    char name[32];
+    struct shmring ring;
+} rings[ROUTE_MAX_BACKENDS];
+
+static struct shmring *ring_for(const struct backend *b) {
+    int free_slot = -1;
+    for(int i = 0; i < ROUTE_MAX_BACKENDS; i++) {
+        if(rings[i].ring.hdr && strcmp(rings[i].name, b->name) == 0)
+            return &rings[i].ring;
+        if(!rings[i].ring.hdr && free_slot < 0)
+            free_slot = i;
+    }
+    if(free_slot < 0 || shmring_create(&rings[free_slot].ring, SHMRING_SIZE) < 0)
+        return NULL;
+    snprintf(rings[free_slot].name, sizeof(rings[free_slot].name), "%s", b->name);
+    return &rings[free_slot].ring;
+}
+
+// forward file to remote server if not .c file
+int forward_file(const struct backend *b, const char *dest, const char *filename, char *filebuf, int filesize,
+                 uint32_t crc) {
+    int sockfd;
+    char buf[BUFSIZE], cmd[BUFSIZE];
+    
+    long t = trace_now();
+    sockfd = bstat_connect(b);
+    trace_span("connect", t, b->name);
+    if(sockfd < 0)
+        return -1;
+    // a shm backend gets the data through the ring, falling back to the
+    // socket when no ring can be made
+    struct shmring *ring = b->shm ? ring_for(b) : NULL;
+    // build command: "storef <destination> <filename> [-s]"
+    snprintf(cmd, sizeof(cmd), "storef %s %s%s", dest, filename, ring ? " -s" : "");
+    trace_tag(buf, sizeof(buf), cmd);
+    lane_tag(buf, sizeof(buf));
+    t = trace_now();
+    if(send(sockfd, buf, strlen(buf), 0) < 0) {
+        perror("Error sending store command");
+        bstat_close(sockfd);
+        return -1;
+    }
+    // Wait for respond with "READY"
+    memset(buf, 0, sizeof(buf));
+    if(recv(sockfd, buf, sizeof(buf)-1, 0) <= 0) {
+        perror("No READY response from forwarding server");
+        bstat_close(sockfd);
+        return -1;
+    }
+    trace_span("ready", t, b->name);
+    if(strncmp(buf, "READY", 5) != 0) {
+        fprintf(stderr, "Forwarding server not ready\n");
+        bstat_close(sockfd);
+        return -1;
+    }
+    t = trace_now();
+    // Send file size (4 bytes), with the ring's descriptors for a shm backend
+    uint32_t net_filesize = htonl(filesize), net_crc = htonl(crc);
+    int sent = 0;
+    if(ring) {
+        int fds[3];
+        shmring_fds(ring, fds);
+        ring->peer = sockfd;
+        if(fdpass_sendn(sockfd, &net_filesize, sizeof(net_filesize), fds, 3) == 0 &&
+           shmring_write(ring, filebuf, filesize) == 0 &&
+           (filesize == 0 || shmring_write(ring, &net_crc, sizeof(net_crc)) == 0))
+            sent = filesize;
+    } else {
+        if(send(sockfd, &net_filesize, sizeof(net_filesize), 0) < (ssize_t)sizeof(net_filesize)) {
+            perror("Error sending filesize to forwarding server");
+            bstat_close(sockfd);
+            return -1;
+        }
+        // Send file data
+        while(sent < filesize) {
+            int n = send(sockfd, filebuf + sent, filesize - sent, 0);
+            if(n <= 0)
+                break;
+            sent += n;
+        }
+        if(sent == filesize && filesize > 0 && send_all(sockfd, &net_crc, sizeof(net_crc)) != sizeof(net_crc))
+            sent = -1;
+    }
+    trace_span("send", t, b->name);
+    // read acknowledgment
+    t = trace_now();
+    memset(buf, 0, sizeof(buf));
+    int acked = sent == filesize && recv(sockfd, buf, sizeof(buf)-1, 0) > 0 &&
+                strncmp(buf, "File stored", 11) == 0;
+    trace_span("ack", t, b->name);
+    bstat_close(sockfd);
+    if(ring && !acked)
+        shmring_close(ring);
+    return acked ? 0 : -1;
+}
@@ -0,0 +1,43 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : transfer.h
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : S1's data path: the socket and file copy loops every transfer
+ *               goes through, and forwarding an upload to a backend. Kept apart
+ *               from S1.c so the benchmarks run the same code.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "route.h"
+
+// copy loop buffer; "make bench" builds the benchmarks with other sizes
+#ifndef BUFSIZE
+#define BUFSIZE 1024
+#endif
+
+ssize_t send_all(int sockfd, const void *buf, size_t len);
+ssize_t recv_all(int sockfd, void *buf, size_t len);
+
+// copy the rest of fp to sock in BUFSIZE chunks, adding it to the CRC32C in
+// *crc unless that is NULL; returns the bytes read
+long send_file(FILE *fp, int sock, uint32_t *crc);
+
+// copy size bytes from one socket to another in BUFSIZE chunks; returns the
+// bytes received, short when the sender went away
+long relay(int from, int to, long size);
+
+// storef <dest> <filename> on backend b, with the data's CRC32C after it;
+// 0 once it acked the file
+int forward_file(const struct backend *b, const char *dest, const char *filename, char *filebuf, int filesize,
+                 uint32_t crc);
+
+#endif
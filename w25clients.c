@@ -9,8 +9,16 @@
 #include <arpa/inet.h>
 #include <stdint.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
-#define BUFSIZE 1024
+#include "client.h"
+#include "aclient.h"
+
+#define BUFSIZE CLIENT_BUFSIZE
 
 /* Utility routines */
 void error(const char *msg) {
@@ -30,13 +38,16 @@ int is_valid_file(const char *filename) {
 
 
 int sanitize_command(char *command) {
-    // Accept cmd: uploadf, downlf, removef, downltar, dispfnames
+    // Accept cmd: uploadf, downlf, removef, removem, downltar, dispfnames, uploaddir, downldir
     char *token = strtok(command, " ");
     if (!token)
         return -1;
     if (strcasecmp(token, "uploadf") == 0 ||
+        strcasecmp(token, "uploaddir") == 0 ||
+        strcasecmp(token, "downldir") == 0 ||
         strcasecmp(token, "downlf") == 0 ||
         strcasecmp(token, "removef") == 0 ||
+        strcasecmp(token, "removem") == 0 ||
         strcasecmp(token, "downltar") == 0 ||
         strcasecmp(token, "dispfnames") == 0) {
         return 0;
@@ -44,38 +55,252 @@ int sanitize_command(char *command) {
     return -1;
 }
 
-/* send_all ensures that all N bytes are sent */
-ssize_t send_all(int sockfd, const void *buf, size_t len) {
-    size_t total = 0;
-    const char *p = buf;
-    while(total < len) {
-        ssize_t n = send(sockfd, p+total, len-total, 0);
-        if(n <= 0) {
-            return n;
+/* save a downloaded file under name in the current directory */
+static void save_file(const char *name, const char *data, uint32_t size, const char *what) {
+    FILE *fp = fopen(name, "wb");
+    if(fp) {
+        fwrite(data, 1, size, fp);
+        fclose(fp);
+        printf("Downloaded %s saved as %s\n", what, name);
+    } else {
+        fprintf(stderr, "Error writing downloaded %s\n", what);
+    }
+}
+
+/* print what the manifest member of a downloaded tar says: the token to
+   give the next downltar for only what changed, and what this one holds */
+static void show_snapshot(const char *data, uint32_t size) {
+    for(uint32_t pos = 0; pos + 512 <= size && data[pos]; ) {
+        const char *h = data + pos;
+        unsigned long long len = strtoull(h + 124, NULL, 8);
+        if(strncmp(h, ".w25-snapshot", 100) == 0 && pos + 512 + len <= size) {
+            char token[64] = "", kind[16] = "", since[64] = "";
+            int removed = 0;
+            const char *p = h + 512, *end = p + len;
+            sscanf(p, "token %63s", token);
+            while(p < end) {
+                const char *nl = memchr(p, '\n', end - p);
+                if(strncmp(p, "removed ", 8) == 0) removed++;
+                else if(strncmp(p, "delta ", 6) == 0 || strncmp(p, "full", 4) == 0)
+                    sscanf(p, "%15s %63s", kind, since);
+                p = nl ? nl + 1 : end;
+            }
+            if(strcmp(kind, "delta") == 0)
+                printf("Changes since %s, %d removed (listed in .w25-snapshot)\n", since, removed);
+            printf("Snapshot token: %s\n", token);
+            return;
         }
-        total += n;
+        pos += 512 + (uint32_t)((len + 511) / 512 * 512);
     }
-    return total;
 }
 
-/* recv_all ensures that all N bytes are received */
-ssize_t recv_all(int sockfd, void *buf, size_t len) {
-    size_t total = 0;
-    char *p = buf;
-    while(total < len) {
-        ssize_t n = recv(sockfd, p+total, len-total, 0);
-        if(n <= 0) {
-            return n;
+/* the shell runs one command at a time: submit it, wait, look at the result */
+struct result {
+    int status;
+    char reply[BUFSIZE];
+    char *data;
+    uint32_t size;
+};
+
+static void on_done(void *arg, const struct aclient_result *res) {
+    struct result *r = arg;
+    r->status = res->status;
+    snprintf(r->reply, sizeof(r->reply), "%s", res->text);
+    r->data = res->data;
+    r->size = res->size;
+}
+
+/*
+ * uploaddir/downldir: every file of a tree, several at a time over a pool of
+ * connections of their own. Files are streamed, not read into memory, and at
+ * most DIR_WINDOW per connection are open at once. S1 routes each one by its
+ * type as usual.
+ */
+
+#define DIR_CONNS  8                // default pool size
+#define DIR_WINDOW 2                // files in flight per connection
+
+struct job {
+    char *local;
+    char *remote;                   // upload: destination directory; download: file
+};
+
+struct batch {
+    struct aclient *ac;
+    struct job *jobs;
+    int njobs, cap;
+    int upload;
+    int next, inflight, window;
+    int ok, failed;
+    long long bytes;
+    double start, shown;
+};
+
+struct transfer {
+    struct batch *b;
+    int job;
+    int fd;
+};
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int add_job(struct batch *b, const char *local, const char *remote) {
+    if (b->njobs == b->cap) {
+        int cap = b->cap ? b->cap * 2 : 256;
+        struct job *j = realloc(b->jobs, cap * sizeof(*j));
+        if (!j) return -1;
+        b->jobs = j;
+        b->cap = cap;
+    }
+    b->jobs[b->njobs].local = strdup(local);
+    b->jobs[b->njobs].remote = strdup(remote);
+    b->njobs++;
+    return 0;
+}
+
+// mkdir -p of the directory part of path
+static void make_parents(const char *path) {
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s", path);
+    for (char *p = tmp + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(tmp, 0755);
+        *p = '/';
+    }
+}
+
+// every regular file below dir, uploaded to the same place below dest
+static void walk(struct batch *b, const char *dir, const char *dest) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        perror(dir);
+        return;
+    }
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0)
+            continue;
+        char local[1024], remote[1024];
+        struct stat st;
+        snprintf(local, sizeof(local), "%s/%s", dir, e->d_name);
+        if (lstat(local, &st) < 0)
+            continue;
+        if (S_ISDIR(st.st_mode)) {
+            snprintf(remote, sizeof(remote), "%s/%s", dest, e->d_name);
+            walk(b, local, remote);
+        } else if (S_ISREG(st.st_mode)) {
+            add_job(b, local, dest);
+        }
+    }
+    closedir(d);
+}
+
+static void show_progress(struct batch *b, int last) {
+    double t = now_s();
+    if (!last && t - b->shown < 0.5)
+        return;
+    b->shown = t;
+    double secs = t - b->start > 0 ? t - b->start : 1e-9;
+    printf("\r%d/%d files, %d failed, %.1f MB, %.1f MB/s%s", b->ok + b->failed, b->njobs, b->failed,
+           b->bytes / 1048576.0, b->bytes / 1048576.0 / secs, last ? "\n" : "");
+    fflush(stdout);
+}
+
+static void start_jobs(struct batch *b);
+
+static void job_done(void *arg, const struct aclient_result *res) {
+    struct transfer *tr = arg;
+    struct batch *b = tr->b;
+    struct job *j = &b->jobs[tr->job];
+    close(tr->fd);
+    // S1 acks an upload it turned down (an unsupported type) like any other
+    int ok = res->status == 0 && (b->upload ? strstr(res->text, "successfully") != NULL : res->size > 0);
+    if (ok) {
+        b->ok++;
+        b->bytes += res->size;
+    } else {
+        b->failed++;
+        if (!b->upload)
+            unlink(j->local);
+        fprintf(stderr, "\n%s: %s", j->local, res->status < 0 ? "connection failed\n" :
+                res->status == 2 ? "checksum mismatch\n" : res->text[0] ? res->text : "not found\n");
+    }
+    free(tr);
+    b->inflight--;
+    show_progress(b, 0);
+    start_jobs(b);
+}
+
+static void start_jobs(struct batch *b) {
+    while (b->inflight < b->window && b->next < b->njobs) {
+        struct job *j = &b->jobs[b->next];
+        struct transfer *tr = malloc(sizeof(*tr));
+        int r = -1;
+        if (tr) {
+            tr->b = b;
+            tr->job = b->next;
+            if (b->upload) {
+                struct stat st;
+                const char *name = strrchr(j->local, '/');
+                tr->fd = open(j->local, O_RDONLY);
+                // the protocol's size is 32 bits
+                if (tr->fd >= 0 && fstat(tr->fd, &st) == 0 && st.st_size <= 0xffffffffLL)
+                    r = aclient_upload_fd(b->ac, name ? name + 1 : j->local, j->remote, tr->fd, st.st_size, job_done, tr);
+            } else {
+                char cmdline[BUFSIZE];
+                make_parents(j->local);
+                tr->fd = open(j->local, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                snprintf(cmdline, sizeof(cmdline), "downlf %s", j->remote);
+                if (tr->fd >= 0)
+                    r = aclient_fetch_fd(b->ac, cmdline, tr->fd, job_done, tr);
+            }
         }
-        total += n;
+        b->next++;
+        if (r == 0) {
+            b->inflight++;
+            continue;
+        }
+        fprintf(stderr, "\n%s: cannot transfer\n", j->local);
+        if (tr && tr->fd >= 0) close(tr->fd);
+        free(tr);
+        b->failed++;
+    }
+}
+
+static void run_batch(struct batch *b, const char *host, int port, int conns) {
+    if (b->njobs == 0) {
+        printf("No files found\n");
+        return;
+    }
+    b->ac = aclient_new(host, port, conns);
+    if (!b->ac) {
+        fprintf(stderr, "Cannot connect to S1\n");
+        return;
+    }
+    b->window = conns * DIR_WINDOW;
+    b->start = b->shown = now_s();
+    start_jobs(b);
+    aclient_wait(b->ac);
+    show_progress(b, 1);
+    aclient_free(b->ac);
+}
+
+static void free_batch(struct batch *b) {
+    for (int i = 0; i < b->njobs; i++) {
+        free(b->jobs[i].local);
+        free(b->jobs[i].remote);
     }
-    return total;
+    free(b->jobs);
 }
 
+// keep a whole text reply, which may be longer than result.reply
 int main(int argc, char *argv[]) {
-    int sockfd, portno, n;
-    struct sockaddr_in serv_addr;
-    struct hostent *server;
+    struct aclient *ac;
     char buffer[BUFSIZE];
 
     if (argc < 3) {
@@ -83,24 +308,10 @@ int main(int argc, char *argv[]) {
        exit(0);
     }
     
-    portno = atoi(argv[2]);
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) 
-        error("ERROR opening socket");
-    
-    server = gethostbyname(argv[1]);
-    if (server == NULL) {
-        fprintf(stderr,"ERROR, no such host\n");
-        exit(0);
-    }
-    
-    memset((char *)&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    memcpy(&serv_addr.sin_addr.s_addr, server->h_addr, server->h_length);
-    serv_addr.sin_port = htons(portno);
-    
-    if (connect(sockfd,(struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0) 
-        error("ERROR connecting");
+    signal(SIGPIPE, SIG_IGN);
+    ac = aclient_new(argv[1], atoi(argv[2]), 1);
+    if (ac == NULL)
+        exit(1);
     
     printf("\n------ Connected to S1 ------\n");
 
@@ -120,18 +331,16 @@ int main(int argc, char *argv[]) {
             continue;
         }
         
-        // Send the command string to S1.
-        if(send_all(sockfd, buffer, strlen(buffer)) < (ssize_t)strlen(buffer)) {
-            error("ERROR sending command");
-        }
-        
-        // Determine command type.
+        // Determine command type. Everything is checked before the command
+        // goes out, so a local mistake never leaves S1 waiting for data.
         char cmd[32];
-        sscanf(buffer, "%s", cmd);
+        struct result res;
+        memset(&res, 0, sizeof(res));
+        sscanf(buffer, "%31s", cmd);
         if (strcasecmp(cmd, "uploadf") == 0) {
             // Expected syntax: uploadf <filename> <destination_path>
             char filename[256], dest[256];
-            if (sscanf(buffer, "%*s %s %s", filename, dest) != 2) {
+            if (sscanf(buffer, "%*s %255s %255s", filename, dest) != 2) {
                 fprintf(stderr, "Invalid uploadf syntax\n");
                 continue;
             }
@@ -139,157 +348,193 @@ int main(int argc, char *argv[]) {
                 fprintf(stderr, "File does not exist.\n");
                 continue;
             }
-            // Open the file.
-            FILE *fp = fopen(filename, "rb");
-            if (!fp) {
+            // The file is read as the connection takes it, never whole.
+            int fd = open(filename, O_RDONLY);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) < 0) {
                 perror("Error opening file");
+                if (fd >= 0) close(fd);
                 continue;
             }
-            fseek(fp, 0, SEEK_END);
-            long filesize = ftell(fp);
-            rewind(fp);
-            char *filebuf = malloc(filesize);
-            if (!filebuf) {
-                fprintf(stderr, "Memory allocation error\n");
-                fclose(fp);
-                continue;
-            }
-            fread(filebuf, 1, filesize, fp);
-            fclose(fp);
-            
-            // Wait for S1 to reply with "READY"
-            memset(buffer, 0, BUFSIZE);
-            n = recv(sockfd, buffer, BUFSIZE-1, 0);
-            if(n <= 0 || strncmp(buffer, "READY", 5) != 0) {
-                fprintf(stderr, "Server not ready for file data\n");
-                free(filebuf);
+            if (aclient_upload_fd(ac, filename, dest, fd, st.st_size, on_done, &res) < 0) {
+                fprintf(stderr, "Invalid uploadf syntax\n");
+                close(fd);
                 continue;
             }
-            // Send file size as a 4-byte integer.
-            uint32_t net_filesize = htonl(filesize);
-            if(send_all(sockfd, &net_filesize, sizeof(net_filesize)) < sizeof(net_filesize)) {
-                error("Error sending filesize");
-            }
-            // Send the file data.
-            if(send_all(sockfd, filebuf, filesize) < filesize) {
-                error("Error sending file data");
-            }
-            free(filebuf);
-            // Get server acknowledgment.
-            memset(buffer, 0, BUFSIZE);
-            n = recv(sockfd, buffer, BUFSIZE-1, 0);
-            if(n > 0)
-                printf("Server: %s\n", buffer);
+            aclient_wait(ac);
+            close(fd);
+            if (res.status < 0)
+                fprintf(stderr, "Error sending file\n");
+            else if (res.status > 0)
+                fprintf(stderr, "Server not ready for file data: %s", res.reply);
+            else
+                printf("Server: %s\n", res.reply);
         }
-        else if (strcasecmp(cmd, "downlf") == 0) {
-            // Expected syntax: downlf <filepath>
-            // S1 will send first a 4-byte filesize, then the raw file data.
-            uint32_t net_filesize;
-            n = recv_all(sockfd, &net_filesize, sizeof(net_filesize));
-            if(n != sizeof(net_filesize)) {
-                fprintf(stderr, "Error receiving filesize\n");
-                continue;
-            }
-            int filesize = ntohl(net_filesize);
-            if(filesize <= 0) {
-                fprintf(stderr, "Server returned error or empty file\n");
-                continue;
+        else if (strcasecmp(cmd, "downlf") == 0 || strcasecmp(cmd, "downltar") == 0) {
+            int tar = strcasecmp(cmd, "downltar") == 0;
+            char arg[256] = "", outname[256];
+            sscanf(buffer, "%*s %255s", arg);
+            if (tar) {
+                // Expected syntax: downltar <filetype> [token or time]
+                // Determine output filename based on filetype
+                if (strcasecmp(arg, ".c") == 0)
+                    strcpy(outname, "cfiles.tar");
+                else if (strcasecmp(arg, ".pdf") == 0)
+                    strcpy(outname, "pdffiles.tar");
+                else if (strcasecmp(arg, ".txt") == 0)
+                    strcpy(outname, "txtfiles.tar");
+                else if (strcasecmp(arg, ".zip") == 0)
+                    strcpy(outname, "zipfiles.tar");
+                else {
+                    fprintf(stderr, "Invalid filetype for tar\n");
+                    continue;
+                }
+            } else {
+                // Expected syntax: downlf <filepath>
+                // The file is saved under the last component of its path.
+                char *fname = strrchr(arg, '/');
+                snprintf(outname, sizeof(outname), "%s", fname ? fname + 1 : arg);
             }
-            char *filebuf = malloc(filesize);
-            if(!filebuf) {
-                fprintf(stderr, "Memory allocation error\n");
+            
+            aclient_fetch(ac, buffer, on_done, &res);
+            aclient_wait(ac);
+            if (res.status < 0) {
+                fprintf(stderr, "Error receiving %s\n", tar ? "tar file" : "file");
                 continue;
             }
-            if(recv_all(sockfd, filebuf, filesize) != filesize) {
-                fprintf(stderr, "Error receiving file data\n");
-                free(filebuf);
+            if (res.status == 2) {
+                // damaged on the way or on disk: nothing is saved
+                fprintf(stderr, "Checksum mismatch, %s discarded\n", tar ? "tar file" : "file");
+                free(res.data);
                 continue;
             }
-            // Save the downloaded file locally.
-            // For simplicity, we extract the filename from the path.
-            char filepath[256];
-            sscanf(buffer, "%*s %s", filepath);
-            char *fname = strrchr(filepath, '/');
-            if(fname)
-                fname++; 
-            else
-                fname = filepath;
-            FILE *fp = fopen(fname, "wb");
-            if(fp) {
-                fwrite(filebuf, 1, filesize, fp);
-                fclose(fp);
-                printf("Downloaded file saved as %s\n", fname);
-            } else {
-                fprintf(stderr, "Error writing downloaded file\n");
-            }
-            free(filebuf);
-        }else if (strcasecmp(cmd, "downltar") == 0) {
-            // Expected syntax: downltar <filetype>
-            char filetype[10];
-            sscanf(buffer, "%*s %s", filetype);
-            
-            // Determine output filename based on filetype
-            char tarname[20];
-            if (strcasecmp(filetype, ".c") == 0)
-                strcpy(tarname, "cfiles.tar");
-            else if (strcasecmp(filetype, ".pdf") == 0)
-                strcpy(tarname, "pdffiles.tar");
-            else if (strcasecmp(filetype, ".txt") == 0)
-                strcpy(tarname, "txtfiles.tar");
-            else if (strcasecmp(filetype, ".zip") == 0)
-                strcpy(tarname, "zipfiles.tar");
-            else {
-                fprintf(stderr, "Invalid filetype for tar\n");
+            if (res.status > 0) {
+                fprintf(stderr, "Server returned error or empty %s\n", tar ? "tar file" : "file");
                 continue;
             }
-            
-            // Receive filesize header
-            uint32_t net_filesize;
-            n = recv_all(sockfd, &net_filesize, sizeof(net_filesize));
-            if(n != sizeof(net_filesize)) {
-                fprintf(stderr, "Error receiving tar filesize\n");
+            save_file(outname, res.data, res.size, tar ? "tar file" : "file");
+            if (tar)
+                show_snapshot(res.data, res.size);
+            free(res.data);
+        }
+        else if (strcasecmp(cmd, "uploaddir") == 0) {
+            // Expected syntax: uploaddir <local_dir> <destination_path> [connections]
+            char dir[512], dest[256];
+            int conns = DIR_CONNS;
+            if (sscanf(buffer, "%*s %511s %255s %d", dir, dest, &conns) < 2 || strncmp(dest, "~S1", 3) != 0) {
+                fprintf(stderr, "Invalid uploaddir syntax\n");
                 continue;
             }
-            
-            int filesize = ntohl(net_filesize);
-            if(filesize <= 0) {
-                fprintf(stderr, "Server returned error or empty tar file\n");
+            if (strlen(dir) > 1 && dir[strlen(dir) - 1] == '/') dir[strlen(dir) - 1] = '\0';
+            if (strlen(dest) > 3 && dest[strlen(dest) - 1] == '/') dest[strlen(dest) - 1] = '\0';
+            struct batch b;
+            memset(&b, 0, sizeof(b));
+            b.upload = 1;
+            walk(&b, dir, dest);
+            run_batch(&b, argv[1], atoi(argv[2]), conns);
+            free_batch(&b);
+        }
+        else if (strcasecmp(cmd, "downldir") == 0) {
+            // Expected syntax: downldir <remote_path> <local_dir> [connections]
+            char src[256], dir[512], cmdline[BUFSIZE];
+            int conns = DIR_CONNS;
+            if (sscanf(buffer, "%*s %255s %511s %d", src, dir, &conns) < 2 || strncmp(src, "~S1", 3) != 0) {
+                fprintf(stderr, "Invalid downldir syntax\n");
                 continue;
             }
-            
-            // Allocate buffer and receive tar data
-            char *filebuf = malloc(filesize);
-            if(!filebuf) {
-                fprintf(stderr, "Memory allocation error\n");
+            if (strlen(src) > 3 && src[strlen(src) - 1] == '/') src[strlen(src) - 1] = '\0';
+            // the subtree listing names files as ~S1 paths
+            snprintf(cmdline, sizeof(cmdline), "dispfnames %s -r", src);
+            aclient_list(ac, cmdline, -1, on_done, &res);
+            aclient_wait(ac);
+            if (res.status != 0) {
+                fprintf(stderr, "Could not list %s: %s\n", src, res.status < 0 ? "no reply" : res.reply);
+                free(res.data);
                 continue;
             }
-            
-            if(recv_all(sockfd, filebuf, filesize) != filesize) {
-                fprintf(stderr, "Error receiving tar file data\n");
-                free(filebuf);
-                continue;
+            char *text = res.data;
+            struct batch b;
+            memset(&b, 0, sizeof(b));
+            size_t plen = strlen(src);
+            for (char *line = text ? strtok(text, "\n") : NULL; line; line = strtok(NULL, "\n")) {
+                if (strncmp(line, src, plen) != 0 || (line[plen] != '/' && strcmp(src, "~S1") != 0))
+                    continue;
+                char local[1024];
+                snprintf(local, sizeof(local), "%s%s", dir, line + plen);
+                add_job(&b, local, line);
             }
-            
-            // Save the tar file
-            FILE *fp = fopen(tarname, "wb");
-            if(fp) {
-                fwrite(filebuf, 1, filesize, fp);
-                fclose(fp);
-                printf("Downloaded tar file saved as %s\n", tarname);
+            free(text);
+            run_batch(&b, argv[1], atoi(argv[2]), conns);
+            free_batch(&b);
+        }
+        else if (strcasecmp(cmd, "removem") == 0) {
+            // Expected syntax: removem <pattern> | removem <path>... | removem @<listfile>
+            // A pattern is a directory ending in '/' (everything below it) or a
+            // glob; paths are sent as one list, read from listfile one per line.
+            char *args = buffer + strcspn(buffer, " ");
+            args += strspn(args, " ");
+            if (strncmp(args, "~S1/", 4) == 0 && !strchr(args, ' ') &&
+                (args[strcspn(args, "*?[")] || args[strlen(args) - 1] == '/')) {
+                aclient_text(ac, buffer, on_done, &res);
+                aclient_wait(ac);
             } else {
-                fprintf(stderr, "Error writing tar file\n");
+                char *list = NULL;
+                size_t len = 0;
+                FILE *lf = args[0] == '@' ? fopen(args + 1, "r") : args[0] ? fmemopen(args, strlen(args), "r") : NULL;
+                FILE *out = lf ? open_memstream(&list, &len) : NULL;
+                char path[1024];
+                int bad = 0, count = 0;
+                while (out && !bad && fscanf(lf, "%1023s", path) == 1) {
+                    bad = strncmp(path, "~S1/", 4) != 0 || path[strcspn(path, "*?[")];
+                    fprintf(out, "%s\n", path);
+                    count++;
+                }
+                if (lf) fclose(lf);
+                if (out) fclose(out);
+                if (!lf && args[0] == '@')
+                    perror(args + 1);
+                else if (!lf || bad || count == 0)
+                    fprintf(stderr, "Invalid removem syntax\n");
+                if (!lf || bad || count == 0) {
+                    free(list);
+                    continue;
+                }
+                aclient_send(ac, "removem", list, len, on_done, &res);
+                aclient_wait(ac);
+                free(list);
             }
-            free(filebuf);
+            if (res.status < 0)
+                fprintf(stderr, "ERROR receiving reply\n");
+            else
+                printf("Server: %s\n", res.reply);
+        }
+        else if (strcasecmp(cmd, "dispfnames") == 0) {
+            // Expected syntax: dispfnames <path> [-r] [-l] [-g glob] [-n limit] [-c cursor]
+            // entries are printed as they arrive; a listing cut short by -n
+            // ends with the -c that continues it
+            fflush(stdout);
+            aclient_list(ac, buffer, STDOUT_FILENO, on_done, &res);
+            aclient_wait(ac);
+            if (res.status < 0)
+                fprintf(stderr, "ERROR receiving reply\n");
+            else if (res.status > 0)
+                printf("Server: %s\n", res.reply);
+            else if (res.size == 0 && !strstr(res.reply, "next "))
+                printf("No files found\n");
+            else
+                printf("%s", res.reply);
         }
         else {
-            // For removef, dispfnames, simply print the response
-            memset(buffer, 0, BUFSIZE);
-            n = recv(sockfd, buffer, BUFSIZE-1, 0);
-            if(n > 0)
-                printf("Server: %s\n", buffer);
+            // For removef, simply print the response
+            aclient_text(ac, buffer, on_done, &res);
+            aclient_wait(ac);
+            if (res.status < 0)
+                fprintf(stderr, "ERROR receiving reply\n");
+            else
+                printf("Server: %s\n", res.reply);
         }
     }
     
-    close(sockfd);
+    aclient_free(ac);
     return 0;
 }
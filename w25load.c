@@ -0,0 +1,474 @@
+/*
+ * Project     : W25_Project - Distributed File System
+ * File        : w25load.c
+ * Author      : lord_rajkumar
+ * GitHub      : https://github.com/rajpatel8/Snap-Sync-v2.0
+ * Description : Load generator for S1. Worker threads drive a mix of uploadf,
+ *               downlf, removef, dispfnames and downltar over a pool of
+ *               connections, closed-loop or at a fixed open-loop rate, and
+ *               report throughput and latency percentiles per command.
+ * License     : MIT License
+ *
+ * (c) 2025 lord_rajkumar. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "client.h"
+
+#define MAX_THREADS 256
+#define MAX_EXTS    4
+#define FILES       64          // distinct names per thread
+#define SUB_BITS    7           // histogram: 128 buckets per power of two, <1% error
+#define BUCKETS     ((64 - SUB_BITS + 1) << SUB_BITS)
+
+enum { OP_UPLOAD, OP_DOWNLOAD, OP_REMOVE, OP_LIST, OP_TAR, NOPS };
+static const char *op_names[NOPS] = { "uploadf", "downlf", "removef", "dispfnames", "downltar" };
+static const char *op_keys[NOPS] = { "upload", "download", "remove", "list", "tar" };
+
+enum { SIZE_FIXED, SIZE_UNIFORM, SIZE_LOGNORMAL };
+
+/* options, shared read-only by the workers */
+static const char *host;
+static int port;
+static int threads = 4;
+static int conns = 0;               // default: one per thread
+static double duration = 10;
+static double rate = 0;             // ops/s over all threads, 0 = closed loop
+static long expected_us = 0;        // closed loop: intended gap between ops
+static int weights[NOPS] = { 40, 40, 5, 10, 5 };
+static int weight_total;
+static int size_kind = SIZE_FIXED;
+static double size_a = 4096, size_b = 0;
+static const char *exts[MAX_EXTS] = { ".txt" };
+static int nexts = 1;
+static int preload = 8;
+
+static volatile sig_atomic_t stop;
+
+struct hist {
+    unsigned long count[BUCKETS];
+    unsigned long total, max;
+};
+
+struct worker {
+    pthread_t tid;
+    int id;
+    int nconn, next;
+    int *socks;
+    uint64_t rng;
+    char *data;                     // upload payload, large enough for any size
+    unsigned char exists[FILES];    // files this thread knows it uploaded
+    unsigned long ops[NOPS], errors[NOPS], misses[NOPS];
+    unsigned long bytes_out, bytes_in;
+    unsigned long unsent;           // open loop: ops that fell off the end
+    long start, end;                // measurement window
+    struct hist h[NOPS];
+};
+
+static long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+static void sleep_until(long t) {
+    long d = t - now_us();
+    if(d <= 0) return;
+    struct timespec ts = { d / 1000000, (d % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static uint64_t rnd(struct worker *w) {
+    // xorshift64*
+    w->rng ^= w->rng >> 12;
+    w->rng ^= w->rng << 25;
+    w->rng ^= w->rng >> 27;
+    return w->rng * 2685821657736338717ULL;
+}
+
+static double rnd01(struct worker *w) {
+    return (rnd(w) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* histogram: same log-linear layout as metrics.c, finer */
+
+static int bucket_of(unsigned long us) {
+    const unsigned long sub = 1UL << SUB_BITS;
+    if(us < sub) return (int)us;
+    int p = 63 - __builtin_clzl(us);
+    return (p - SUB_BITS + 1) * sub + ((us >> (p - SUB_BITS)) & (sub - 1));
+}
+
+// lowest value that falls in bucket b
+static unsigned long bucket_floor(int b) {
+    const unsigned long sub = 1UL << SUB_BITS;
+    if(b < (int)sub) return b;
+    int p = b / sub + SUB_BITS - 1;
+    return (sub + b % sub) << (p - SUB_BITS);
+}
+
+static void hist_add(struct hist *h, unsigned long us) {
+    h->count[bucket_of(us)]++;
+    h->total++;
+    if(us > h->max) h->max = us;
+}
+
+// coordinated omission: an op that took longer than the expected gap hid the
+// ops that would have been issued meanwhile, count them as they'd have waited
+static void hist_record(struct hist *h, unsigned long us) {
+    hist_add(h, us);
+    if(expected_us <= 0) return;
+    for(long missed = (long)us - expected_us; missed >= expected_us; missed -= expected_us)
+        hist_add(h, missed);
+}
+
+static void hist_merge(struct hist *to, const struct hist *from) {
+    for(int b = 0; b < BUCKETS; b++)
+        to->count[b] += from->count[b];
+    to->total += from->total;
+    if(from->max > to->max) to->max = from->max;
+}
+
+static unsigned long hist_pct(const struct hist *h, double pct) {
+    if(!h->total) return 0;
+    unsigned long want = (unsigned long)ceil(h->total * pct / 100.0), seen = 0;
+    if(want == 0) want = 1;
+    for(int b = 0; b < BUCKETS; b++) {
+        seen += h->count[b];
+        if(seen >= want)
+            return bucket_floor(b) < h->max ? bucket_floor(b) : h->max;
+    }
+    return h->max;
+}
+
+/* option parsing */
+
+static long parse_size(const char *s) {
+    char *end;
+    double v = strtod(s, &end);
+    if(*end == 'k' || *end == 'K') v *= 1024;
+    else if(*end == 'm' || *end == 'M') v *= 1024 * 1024;
+    return (long)v;
+}
+
+// "upload=40,download=40,remove=5,list=10,tar=5"; missing ops get 0
+static int parse_mix(char *s) {
+    memset(weights, 0, sizeof(weights));
+    for(char *tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+        char *eq = strchr(tok, '=');
+        if(!eq) return -1;
+        *eq = '\0';
+        int i;
+        for(i = 0; i < NOPS; i++)
+            if(strcasecmp(tok, op_keys[i]) == 0 || strcasecmp(tok, op_names[i]) == 0)
+                break;
+        if(i == NOPS) return -1;
+        weights[i] = atoi(eq + 1);
+    }
+    return 0;
+}
+
+// "fixed:N", "uniform:MIN:MAX" or "lognormal:MEDIAN:SIGMA"
+static int parse_sizes(char *s) {
+    char *kind = strtok(s, ":"), *a = strtok(NULL, ":"), *b = strtok(NULL, ":");
+    if(!kind || !a) return -1;
+    if(strcasecmp(kind, "fixed") == 0) {
+        size_kind = SIZE_FIXED;
+        size_a = parse_size(a);
+    } else if(strcasecmp(kind, "uniform") == 0 && b) {
+        size_kind = SIZE_UNIFORM;
+        size_a = parse_size(a);
+        size_b = parse_size(b);
+    } else if(strcasecmp(kind, "lognormal") == 0 && b) {
+        size_kind = SIZE_LOGNORMAL;
+        size_a = parse_size(a);
+        size_b = atof(b);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static long max_size(void) {
+    switch(size_kind) {
+    case SIZE_UNIFORM:   return (long)size_b;
+    case SIZE_LOGNORMAL: return (long)(size_a * exp(4 * size_b));  // cap at 4 sigma
+    default:             return (long)size_a;
+    }
+}
+
+static uint32_t pick_size(struct worker *w) {
+    double v;
+    switch(size_kind) {
+    case SIZE_UNIFORM:
+        v = size_a + rnd01(w) * (size_b - size_a + 1);
+        break;
+    case SIZE_LOGNORMAL: {
+        // Box-Muller
+        double u1 = rnd01(w), u2 = rnd01(w);
+        double z = sqrt(-2 * log(u1 > 0 ? u1 : 1e-12)) * cos(2 * M_PI * u2);
+        if(z > 4) z = 4;
+        v = size_a * exp(size_b * z);
+        break;
+    }
+    default:
+        v = size_a;
+    }
+    return v < 0 ? 0 : (uint32_t)v;
+}
+
+/* workers */
+
+static int worker_conn(struct worker *w) {
+    int i = w->next;
+    w->next = (w->next + 1) % w->nconn;
+    if(w->socks[i] < 0)
+        w->socks[i] = client_connect(host, port);
+    return i;
+}
+
+static void file_path(struct worker *w, int k, char *out, size_t size) {
+    snprintf(out, size, "~S1/loadgen/lg_%d_%d%s", w->id, k, exts[k % nexts]);
+}
+
+// run one op; 0 ok, 1 miss, -1 failed (the connection is dropped)
+static int run_op(struct worker *w, int op, int sock) {
+    char cmd[CLIENT_BUFSIZE], reply[CLIENT_BUFSIZE], path[256];
+    int k = rnd(w) % FILES;
+    char *data;
+    uint32_t size;
+    int r;
+    switch(op) {
+    case OP_UPLOAD: {
+        char name[64];
+        snprintf(name, sizeof(name), "lg_%d_%d%s", w->id, k, exts[k % nexts]);
+        size = pick_size(w);
+        r = client_upload(sock, name, "~S1/loadgen", w->data, size, reply, sizeof(reply));
+        if(r < 0) return -1;
+        w->bytes_out += size;
+        w->exists[k] = 1;
+        return 0;
+    }
+    case OP_DOWNLOAD:
+        // prefer a file this thread uploaded; else any name, likely a miss
+        for(int tries = 0; tries < FILES && !w->exists[k]; tries++)
+            k = (k + 1) % FILES;
+        file_path(w, k, path, sizeof(path));
+        snprintf(cmd, sizeof(cmd), "downlf %s", path);
+        r = client_fetch(sock, cmd, &data, &size);
+        if(r == 0) {
+            w->bytes_in += size;
+            free(data);
+        }
+        return r;
+    case OP_REMOVE:
+        file_path(w, k, path, sizeof(path));
+        snprintf(cmd, sizeof(cmd), "removef %s", path);
+        if(client_text(sock, cmd, reply, sizeof(reply)) < 0) return -1;
+        w->exists[k] = 0;
+        return 0;
+    case OP_LIST:
+        if(client_list(sock, "dispfnames ~S1/loadgen", -1, reply, sizeof(reply)) < 0) return -1;
+        return 0;
+    case OP_TAR:
+        snprintf(cmd, sizeof(cmd), "downltar %s", exts[rnd(w) % nexts]);
+        r = client_fetch(sock, cmd, &data, &size);
+        if(r == 0) {
+            w->bytes_in += size;
+            free(data);
+        }
+        return r;
+    }
+    return -1;
+}
+
+static int pick_op(struct worker *w) {
+    int x = rnd(w) % weight_total;
+    for(int op = 0; op < NOPS; op++) {
+        if(x < weights[op]) return op;
+        x -= weights[op];
+    }
+    return 0;
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    for(int k = 0; k < preload && k < FILES && !stop; k++) {
+        int c = worker_conn(w);
+        if(w->socks[c] < 0) continue;
+        char name[64], reply[CLIENT_BUFSIZE];
+        snprintf(name, sizeof(name), "lg_%d_%d%s", w->id, k, exts[k % nexts]);
+        if(client_upload(w->socks[c], name, "~S1/loadgen", w->data, pick_size(w), reply, sizeof(reply)) == 0)
+            w->exists[k] = 1;
+    }
+
+    // open loop: ops are due on a fixed schedule, latency counts from when an
+    // op was due, not from when a backed-up worker got round to sending it
+    double gap = rate > 0 ? threads * 1e6 / rate : 0;
+    long start = now_us(), end = start + (long)(duration * 1e6);
+    w->start = start;
+    for(long n = 0; !stop; n++) {
+        long due = gap > 0 ? start + (long)(n * gap) : now_us();
+        if(due >= end) break;
+        if(now_us() >= end) {
+            w->unsent = (long)((end - start) / gap) - n;
+            break;
+        }
+        sleep_until(due);
+        int op = pick_op(w);
+        int c = worker_conn(w);
+        int r = w->socks[c] < 0 ? -1 : run_op(w, op, w->socks[c]);
+        long lat = now_us() - due;
+        if(r < 0) {
+            w->errors[op]++;
+            if(w->socks[c] >= 0) close(w->socks[c]);
+            w->socks[c] = -1;
+            if(gap <= 0) usleep(10000);
+            continue;
+        }
+        if(r > 0) w->misses[op]++;
+        w->ops[op]++;
+        hist_record(&w->h[op], lat);
+    }
+    w->end = now_us();
+    for(int i = 0; i < w->nconn; i++)
+        if(w->socks[i] >= 0) close(w->socks[i]);
+    return NULL;
+}
+
+/* report */
+
+static void print_row(const char *name, const struct hist *h, unsigned long ops,
+                      unsigned long errors, unsigned long misses, double secs) {
+    printf("%-10s %9lu %7lu %7lu %10.1f %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+           name, ops, errors, misses, ops / secs,
+           hist_pct(h, 50) / 1000.0, hist_pct(h, 90) / 1000.0, hist_pct(h, 99) / 1000.0,
+           hist_pct(h, 99.9) / 1000.0, h->max / 1000.0);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage %s [options] hostname port\n"
+            "  -c threads     worker threads (default 4)\n"
+            "  -C conns       connections in total, shared out over the threads (default: threads)\n"
+            "  -d seconds     run time (default 10)\n"
+            "  -r rate        open loop at rate ops/s in total (default: closed loop)\n"
+            "  -i usec        closed loop: expected gap between ops, for coordinated omission correction\n"
+            "  -m mix         op weights (default upload=40,download=40,remove=5,list=10,tar=5)\n"
+            "  -s sizes       fixed:N, uniform:MIN:MAX or lognormal:MEDIAN:SIGMA, k/m suffixes (default fixed:4k)\n"
+            "  -e exts        comma separated file types (default .txt)\n"
+            "  -P n           files each thread uploads before the clock starts (default 8)\n",
+            prog);
+    exit(1);
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    while((opt = getopt(argc, argv, "c:C:d:r:i:m:s:e:P:")) != -1) {
+        switch(opt) {
+        case 'c': threads = atoi(optarg); break;
+        case 'C': conns = atoi(optarg); break;
+        case 'd': duration = atof(optarg); break;
+        case 'r': rate = atof(optarg); break;
+        case 'i': expected_us = atol(optarg); break;
+        case 'm': if(parse_mix(optarg) < 0) usage(argv[0]); break;
+        case 's': if(parse_sizes(optarg) < 0) usage(argv[0]); break;
+        case 'e':
+            nexts = 0;
+            for(char *t = strtok(optarg, ","); t && nexts < MAX_EXTS; t = strtok(NULL, ","))
+                exts[nexts++] = t;
+            break;
+        case 'P': preload = atoi(optarg); break;
+        default: usage(argv[0]);
+        }
+    }
+    if(argc - optind < 2) usage(argv[0]);
+    host = argv[optind];
+    port = atoi(argv[optind + 1]);
+    if(threads < 1 || threads > MAX_THREADS || nexts < 1 || duration <= 0) usage(argv[0]);
+    if(conns < threads) conns = threads;
+    for(int op = 0; op < NOPS; op++)
+        weight_total += weights[op];
+    if(weight_total <= 0) usage(argv[0]);
+    if(rate > 0) {
+        // the schedule already charges late ops, no synthetic samples needed
+        expected_us = 0;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+
+    static struct worker workers[MAX_THREADS];
+    long payload = max_size();
+    for(int t = 0; t < threads; t++) {
+        struct worker *w = &workers[t];
+        w->id = t;
+        w->nconn = conns / threads + (t < conns % threads);
+        w->socks = malloc(w->nconn * sizeof(int));
+        for(int i = 0; i < w->nconn; i++)
+            w->socks[i] = client_connect(host, port);
+        w->rng = 0x9E3779B97F4A7C15ULL * (t + 1) ^ (uint64_t)now_us();
+        w->data = malloc(payload > 0 ? payload : 1);
+        for(long i = 0; i < payload; i++)
+            w->data[i] = 'a' + i % 26;
+    }
+
+    printf("%d threads, %d connections, %s, %.0fs\n", threads, conns,
+           rate > 0 ? "open loop" : "closed loop", duration);
+    for(int t = 0; t < threads; t++)
+        pthread_create(&workers[t].tid, NULL, worker_main, &workers[t]);
+    for(int t = 0; t < threads; t++)
+        pthread_join(workers[t].tid, NULL);
+
+    static struct hist per_op[NOPS], all;
+    unsigned long ops[NOPS] = {0}, errors[NOPS] = {0}, misses[NOPS] = {0};
+    unsigned long tops = 0, terr = 0, tmiss = 0, bin = 0, bout = 0, unsent = 0;
+    // the preload phase is not in the measurement window
+    long first = workers[0].start, last = workers[0].end;
+    for(int t = 0; t < threads; t++) {
+        if(workers[t].start < first) first = workers[t].start;
+        if(workers[t].end > last) last = workers[t].end;
+        unsent += workers[t].unsent;
+        for(int op = 0; op < NOPS; op++) {
+            hist_merge(&per_op[op], &workers[t].h[op]);
+            ops[op] += workers[t].ops[op];
+            errors[op] += workers[t].errors[op];
+            misses[op] += workers[t].misses[op];
+        }
+        bin += workers[t].bytes_in;
+        bout += workers[t].bytes_out;
+    }
+
+    double secs = last > first ? (last - first) / 1e6 : duration;
+    printf("\n%-10s %9s %7s %7s %10s %9s %9s %9s %9s %9s\n",
+           "command", "ops", "errors", "misses", "ops/s", "p50 ms", "p90 ms", "p99 ms", "p999 ms", "max ms");
+    for(int op = 0; op < NOPS; op++) {
+        if(!weights[op]) continue;
+        print_row(op_names[op], &per_op[op], ops[op], errors[op], misses[op], secs);
+        hist_merge(&all, &per_op[op]);
+        tops += ops[op];
+        terr += errors[op];
+        tmiss += misses[op];
+    }
+    print_row("total", &all, tops, terr, tmiss, secs);
+    printf("\nsent %.2f MB/s, received %.2f MB/s\n", bout / secs / 1048576, bin / secs / 1048576);
+    if(unsent)
+        printf("%lu ops were never sent, the servers could not keep up with %.0f ops/s\n", unsent, rate);
+    if(expected_us > 0)
+        printf("latencies corrected for a %ld us expected interval\n", expected_us);
+    return terr ? 2 : 0;
+}